@@ -1,13 +1,52 @@
 #!/bin/sh -e
 cd src
 
+# The webassembly workers without threads can hand over to a slim build for
+# the variant they are started with, see preamble.js
+wasm_worker() {
+  cat ../preamble.js
+  echo 'if (!stockfishLoadVariantBuild()) (function () {'
+  cat
+  echo '})();'
+}
+
+# Bitboards and the KPK bitbase are included rather than computed at startup
+# in the webassembly builds, see baked in the Makefile
+make tables
+
 make clean
 make COMP=emscripten ARCH=js build -B -j2
 cat ../preamble.js stockfish.js > ../stockfish.js
 
 make clean
-make COMP=emscripten ARCH=wasm build -B -j2
-uglifyjs --compress --mangle -- stockfish.js | sed "s/SF_VERSION/$(sha256sum stockfish.wasm | cut -c1-8)/" | cat ../preamble.js - > ../stockfish.wasm.js
+make COMP=emscripten ARCH=wasm-simd asyncify=yes baked=yes build -B -j2
+cp stockfish.wasm ../stockfish.simd.wasm
+
+make clean
+make COMP=emscripten ARCH=wasm asyncify=yes baked=yes build -B -j2
+uglifyjs --compress --mangle -- stockfish.js | sed "s/SF_SIMD_VERSION/$(sha256sum ../stockfish.simd.wasm | cut -c1-8)/;s/SF_VERSION/$(sha256sum stockfish.wasm | cut -c1-8)/" | wasm_worker > ../stockfish.wasm.js
 cp stockfish.wasm ../stockfish.wasm
 
+# Low-memory worker for constrained devices, see lowmem in the Makefile
+make clean
+make COMP=emscripten ARCH=wasm asyncify=yes baked=yes lowmem=yes build -B -j2
+uglifyjs --compress --mangle -- stockfish.js | sed "s/stockfish\(.simd\)\?.wasm?v=SF\(_SIMD\)\?_VERSION/stockfish.lowmem.wasm?v=$(sha256sum stockfish.wasm | cut -c1-8)/g" | cat ../preamble.js - > ../stockfish.lowmem.wasm.js
+cp stockfish.wasm ../stockfish.lowmem.wasm
+
+make clean
+make COMP=emscripten ARCH=wasm-threads baked=yes build -B -j2
+uglifyjs --compress --mangle -- stockfish.js | sed "s/stockfish\(.simd\)\?.wasm?v=SF\(_SIMD\)\?_VERSION/stockfish.threads.wasm?v=$(sha256sum stockfish.wasm | cut -c1-8)/g" | cat ../preamble.js - > ../stockfish.wasm.threads.js
+cp stockfish.wasm ../stockfish.threads.wasm
+cp pthread-main.js ../pthread-main.js
+
+make clean
+# The slim builds are about download size, so they compute the magics, 845 KB
+# of the tables, at startup
+make COMP=emscripten asyncify=yes baked=small wasm-variants -j2
+for name in $(sed -n 's/.*"stockfish\.\(.*\)\.wasm\.js".*/\1/p' stockfish.manifest.json); do
+  uglifyjs --compress --mangle -- stockfish.$name.js | sed "s/stockfish\(.simd\)\?.wasm?v=SF\(_SIMD\)\?_VERSION/stockfish.$name.wasm?v=$(sha256sum stockfish.$name.wasm | cut -c1-8)/g" | wasm_worker > ../stockfish.$name.wasm.js
+  cp stockfish.$name.wasm ../stockfish.$name.wasm
+done
+cp stockfish.manifest.json ../stockfish.manifest.json
+
 cd ..
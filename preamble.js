@@ -13,3 +13,27 @@
  * https://github.com/niklasf/stockfish.js
  */
 
+
+// A worker started with a variant in the URL fragment, like
+// new Worker('stockfish.wasm.js#crazyhouse'), looks up the smallest build
+// which supports it in stockfish.manifest.json (see build.sh). That build is
+// imported instead of the one following, which is then skipped.
+function stockfishLoadVariantBuild() {
+  var variant = self.location.hash.slice(1);
+  if (!variant || self.stockfishVariantBuild) return false;
+
+  var xhr = new XMLHttpRequest(), best = null;
+  xhr.open('GET', 'stockfish.manifest.json', false);
+  xhr.send(null);
+  if (xhr.status !== 200) return false;
+
+  JSON.parse(xhr.responseText).forEach(function (build) {
+    if (build.variants.indexOf(decodeURIComponent(variant)) !== -1 && (!best || build.size < best.size))
+      best = build;
+  });
+  if (!best) return false;
+
+  self.stockfishVariantBuild = best.script;
+  importScripts(best.script);
+  return true;
+}
@@ -19,12 +19,22 @@
 */
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <istream>
+#include <sstream>
 #include <vector>
 
+#include "engine.h"
+#include "evaluate.h"
+#include "movegen.h"
 #include "position.h"
+#include "thread.h"
+#include "tt.h"
 #include "uci.h"
 
 using namespace std;
@@ -366,3 +376,179 @@ vector<string> setup_bench(const Position& current, istream& is) {
 
   return list;
 }
+
+
+namespace {
+
+  uint64_t Sink; // Results of the timed calls, so that they are not optimized away
+
+  // time_ns() calls f() for at least 'ms' milliseconds after a warmup call and
+  // returns the time per operation in ns, f() returning its number of them.
+
+  template<typename F>
+  double time_ns(F f, int ms) {
+
+    typedef std::chrono::steady_clock Clock;
+
+    f();
+
+    uint64_t ops = 0;
+    Clock::time_point start = Clock::now(), end;
+
+    do ops += f();
+    while ((end = Clock::now()) - start < std::chrono::milliseconds(ms));
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / std::max(ops, uint64_t(1));
+  }
+
+} // namespace
+
+
+/// microbench() times the primitives of the engine in isolation over the bench
+/// positions of variant v, whose PSQT and endgames must be set up. Each
+/// primitive is timed 'runs' times for 'ms' milliseconds, and the result is a
+/// JSON object with the mean, standard deviation and minimum of the ns per
+/// operation:
+///
+/// generate  -> generate<LEGAL>() of a position
+/// do_undo   -> do_move() and undo_move() of a legal move
+/// evaluate  -> Eval::evaluate() of a position not in check, without the eval hash
+/// see_ge    -> see_ge() of a legal move
+/// tt_probe  -> TT.probe() of the key of a position after a legal move
+/// attacks   -> attacks_bb<BISHOP>() or attacks_bb<ROOK>() of a square
+
+string microbench(Variant v, int runs, int ms) {
+
+  Thread* th = Threads.main();
+  bool chess960 = false;
+  std::deque<StateInfo> states;
+  std::deque<Position> positions;
+
+  for (const string& line : Defaults[main_variant(v)])
+  {
+      if (line.find("setoption") != string::npos)
+      {
+          if (line.find("UCI_Chess960") != string::npos)
+              chess960 = line.find("true") != string::npos;
+          continue;
+      }
+
+      istringstream is(line);
+      string fen, token;
+
+      while (is >> token && token != "moves")
+          fen += token + " ";
+
+      states.emplace_back();
+      positions.emplace_back();
+      Position& pos = positions.back();
+      pos.set(fen, chess960, v, &states.back(), th);
+
+      while (is >> token)
+      {
+          Move m = UCI::to_move(pos, token);
+          if (m == MOVE_NONE)
+              break;
+          states.emplace_back();
+          pos.do_move(m, states.back());
+      }
+  }
+
+  vector<vector<Move>> moves;
+  vector<Key> keys;
+  size_t moveCount = 0;
+
+  for (Position& pos : positions)
+  {
+      moves.emplace_back();
+      for (const auto& m : MoveList<LEGAL>(pos))
+      {
+          StateInfo st;
+          moves.back().push_back(m);
+          pos.do_move(m, st);
+          keys.push_back(pos.key());
+          pos.undo_move(m);
+      }
+      moveCount += moves.back().size();
+  }
+
+  // Evaluate without the eval hash
+  size_t evalTableSize = th->evalTable.size();
+  th->evalTable.resize(0);
+
+  const vector<string> names = { "generate", "do_undo", "evaluate", "see_ge", "tt_probe", "attacks" };
+  vector<vector<double>> ns(names.size());
+
+  for (int r = 0; r < runs; ++r)
+  {
+      ns[0].push_back(time_ns([&]() {
+          for (Position& pos : positions)
+              Sink += MoveList<LEGAL>(pos).size();
+          return positions.size();
+      }, ms));
+
+      ns[1].push_back(time_ns([&]() {
+          StateInfo st;
+          for (size_t i = 0; i < positions.size(); ++i)
+              for (Move m : moves[i])
+              {
+                  positions[i].do_move(m, st);
+                  positions[i].undo_move(m);
+              }
+          return moveCount;
+      }, ms));
+
+      ns[2].push_back(time_ns([&]() {
+          size_t n = 0;
+          for (Position& pos : positions)
+              if (!pos.checkers())
+                  Sink += Eval::evaluate(pos), ++n;
+          return n;
+      }, ms));
+
+      ns[3].push_back(time_ns([&]() {
+          for (size_t i = 0; i < positions.size(); ++i)
+              for (Move m : moves[i])
+                  Sink += positions[i].see_ge(m);
+          return moveCount;
+      }, ms));
+
+      ns[4].push_back(time_ns([&]() {
+          bool found;
+          for (Key key : keys)
+              Sink += uintptr_t(TT.probe(key, found)) + found;
+          return keys.size();
+      }, ms));
+
+      ns[5].push_back(time_ns([&]() {
+          for (Position& pos : positions)
+              for (Square s = SQ_A1; s <= SQ_H8; ++s)
+                  Sink += attacks_bb<BISHOP>(s, pos.pieces()) ^ attacks_bb<ROOK>(s, pos.pieces());
+          return 2 * size_t(SQUARE_NB) * positions.size();
+      }, ms));
+  }
+
+  th->evalTable.resize(evalTableSize);
+  STATS(th->evalTable.hits = th->evalTable.misses = 0);
+
+  stringstream ss;
+  ss << std::fixed << std::setprecision(1) << "{\"variant\":\"" << variants[v]
+     << "\",\"positions\":" << positions.size() << ",\"moves\":" << moveCount;
+
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+      double mean = 0, var = 0;
+
+      for (double x : ns[i])
+          mean += x / ns[i].size();
+
+      for (double x : ns[i])
+          var += (x - mean) * (x - mean) / std::max(ns[i].size() - 1, size_t(1));
+
+      ss << ",\"" << names[i] << "\":{\"mean\":" << mean << ",\"stddev\":" << std::sqrt(var)
+         << ",\"min\":" << *std::min_element(ns[i].begin(), ns[i].end()) << "}";
+  }
+
+  ss << "}";
+  return ss.str();
+}
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cassert>
 #include <numeric>
+#include <ostream>
 #include <vector>
 
 #include "bitboard.h"
@@ -32,7 +33,11 @@ namespace {
   const unsigned MAX_INDEX = 2*24*64*64; // stm * psq * wksq * bksq = 196608
 
   // Each uint32_t stores results of 32 positions, one per bit
+#ifdef BAKED_TABLES
+#include "bitbase_tables.h" // Written by Bitbases::print_tables()
+#else
   uint32_t KPKBitbase[MAX_INDEX / 32];
+#endif
 
   // A KPK bitbase index is an integer in [0, IndexMax] range
   //
@@ -84,6 +89,10 @@ bool Bitbases::probe(Square wksq, Square wpsq, Square bksq, Color us) {
 
 void Bitbases::init() {
 
+#ifdef BAKED_TABLES
+  return; // Included from bitbase_tables.h
+#endif
+
   std::vector<KPKPosition> db(MAX_INDEX);
   unsigned idx, repeat = 1;
 
@@ -104,6 +113,26 @@ void Bitbases::init() {
 }
 
 
+/// Bitbases::bytes() returns the size of the bitbase, for the "memory" command
+
+size_t Bitbases::bytes() { return sizeof(KPKBitbase); }
+
+
+/// Bitbases::print_tables() writes the bitbase computed by init() as a C++
+/// definition, like Bitboards::print_tables().
+
+void Bitbases::print_tables(std::ostream& os) {
+
+  os << "// Generated by the \"tables\" command of Stockfish, do not edit\n\n"
+     << "uint32_t KPKBitbase[MAX_INDEX / 32] = {";
+
+  for (unsigned i = 0; i < MAX_INDEX / 32; ++i)
+      os << (i % 8 ? " " : "\n  ") << KPKBitbase[i] << (i + 1 < MAX_INDEX / 32 ? "," : "\n");
+
+  os << "};\n";
+}
+
+
 namespace {
 
   KPKPosition::KPKPosition(unsigned idx) {
@@ -19,10 +19,21 @@
 */
 
 #include <algorithm>
+#include <iomanip>
+#include <ostream>
 
 #include "bitboard.h"
 #include "misc.h"
 
+// The magics are computed at startup unless included with the other baked
+// tables. LOW_MEMORY builds have none.
+#if !defined(LOW_MEMORY) && (!defined(BAKED_TABLES) || defined(NO_BAKED_MAGICS))
+#define INIT_MAGICS
+#endif
+
+#ifdef BAKED_TABLES
+#include "bitboard_tables.h" // Written by Bitboards::print_tables()
+#else
 uint8_t PopCnt16[1 << 16];
 int SquareDistance[SQUARE_NB][SQUARE_NB];
 
@@ -39,9 +50,18 @@ Bitboard PassedPawnMask[COLOR_NB][SQUARE_NB];
 Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB];
 Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
 Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
+#endif
 
+#ifdef INIT_MAGICS
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
+#endif
+
+#ifdef LOW_MEMORY
+Bitboard LineMasks[3][SQUARE_NB];
+Bitboard FillUpAttacks[FILE_NB][64];
+Bitboard AFileAttacks[RANK_NB][64];
+#endif
 
 namespace {
 
@@ -49,13 +69,23 @@ namespace {
   const uint64_t DeBruijn64 = 0x3F79D71B4CB0A89ULL;
   const uint32_t DeBruijn32 = 0x783A9B23;
 
+#ifndef BAKED_TABLES
   int MSBTable[256];            // To implement software msb()
   Square BSFTable[SQUARE_NB];   // To implement software bitscan
+#endif
+
+#ifdef INIT_MAGICS
   Bitboard RookTable[0x19000];  // To store rook attacks
   Bitboard BishopTable[0x1480]; // To store bishop attacks
+#endif
 
+#ifdef LOW_MEMORY
+  void init_kindergarten();
+#elif defined(INIT_MAGICS)
   void init_magics(Bitboard table[], Magic magics[], Square deltas[]);
+#endif
 
+#if !defined(BAKED_TABLES) || defined(NO_BSF)
   // bsf_index() returns the index into BSFTable[] to look up the bitscan. Uses
   // Matt Taylor's folding for 32 bit case, extended to 64 bit by Kim Walisch.
 
@@ -64,8 +94,9 @@ namespace {
     return Is64Bit ? (b * DeBruijn64) >> 58
                    : ((unsigned(b) ^ unsigned(b >> 32)) * DeBruijn32) >> 26;
   }
+#endif
 
-
+#ifndef BAKED_TABLES
   // popcount16() counts the non-zero bits using SWAR-Popcount algorithm
 
   unsigned popcount16(unsigned u) {
@@ -74,6 +105,62 @@ namespace {
     u = ((u >> 4) + u) & 0x0F0FU;
     return (u * 0x0101U) >> 8;
   }
+#endif
+
+#ifndef LOW_MEMORY
+  // print() writes an entry of a table for Bitboards::print_tables()
+
+  void print(std::ostream& os, Bitboard b) { os << "0x" << std::hex << b << std::dec << "ULL"; }
+  void print(std::ostream& os, int v) { os << v; }
+  void print(std::ostream& os, uint8_t v) { os << int(v); }
+  void print(std::ostream& os, Square s) { os << "Square(" << int(s) << ")"; }
+
+  void print(std::ostream& os, const Magic& m) {
+
+    Bitboard* table = m.attacks >= RookTable && m.attacks < RookTable + 0x19000 ? RookTable : BishopTable;
+
+    os << "{ ";
+    print(os, m.mask);
+    os << ", ";
+    print(os, m.magic);
+    os << ", " << (table == RookTable ? "RookTable + " : "BishopTable + ")
+       << m.attacks - table << ", " << m.shift << " }";
+  }
+
+  // print_table() writes the definition of a table with one or two dimensions,
+  // eight entries per line.
+
+  template<typename T, size_t N>
+  void print_table(std::ostream& os, const char* decl, const T (&table)[N]) {
+
+    os << decl << " = {";
+    for (size_t i = 0; i < N; ++i)
+    {
+        os << (i % 8 ? " " : "\n  ");
+        print(os, table[i]);
+        os << (i + 1 < N ? "," : "\n");
+    }
+    os << "};\n";
+  }
+
+  template<typename T, size_t N, size_t M>
+  void print_table(std::ostream& os, const char* decl, const T (&table)[N][M]) {
+
+    os << decl << " = {";
+    for (size_t i = 0; i < N; ++i)
+    {
+        os << "\n  {";
+        for (size_t j = 0; j < M; ++j)
+        {
+            os << (j % 8 ? " " : "\n    ");
+            print(os, table[i][j]);
+            os << (j + 1 < M ? "," : "");
+        }
+        os << "\n  }" << (i + 1 < N ? "," : "\n");
+    }
+    os << "};\n";
+  }
+#endif
 }
 
 #ifdef NO_BSF
@@ -136,11 +223,78 @@ const std::string Bitboards::pretty(Bitboard b) {
 }
 
 
+/// Bitboards::slider_bytes() returns the size of the tables attacks_bb() looks
+/// up the rook, bishop and queen attacks in, for the "memory" command.
+
+size_t Bitboards::slider_bytes() {
+
+#ifdef LOW_MEMORY
+  return sizeof(LineMasks) + sizeof(FillUpAttacks) + sizeof(AFileAttacks);
+#else
+  return sizeof(RookTable) + sizeof(BishopTable) + sizeof(RookMagics) + sizeof(BishopMagics);
+#endif
+}
+
+
+/// Bitboards::print_tables() writes the tables computed by init() as C++
+/// definitions. A build with -DBAKED_TABLES includes them as bitboard_tables.h
+/// and skips init(), so that it starts without computing the magics. The
+/// magics depend on the word size and pext, the build must match in these.
+/// LOW_MEMORY builds skip the magics, and cannot write the tables. With
+/// -DNO_BAKED_MAGICS the magics and their attacks, most of the size of the
+/// tables, are still computed at startup.
+
+void Bitboards::print_tables(std::ostream& os) {
+
+#ifdef LOW_MEMORY
+  os << "#error \"Tables made by a LOW_MEMORY build\"\n";
+#else
+  os << "// Generated by the \"tables\" command of Stockfish, do not edit\n\n"
+     << "static_assert(Is64Bit == " << (Is64Bit ? "true" : "false")
+     << " && HasPext == " << (HasPext ? "true" : "false")
+     << ", \"Tables made for a different architecture\");\n\n"
+     << "namespace {\n\n";
+
+  os << "#if !defined(LOW_MEMORY) || defined(NO_BSF)\n"; // Else unused
+  print_table(os, "int MSBTable[256]", MSBTable);
+  print_table(os, "Square BSFTable[SQUARE_NB]", BSFTable);
+  os << "#endif\n";
+  os << "#if !defined(LOW_MEMORY) && !defined(NO_BAKED_MAGICS)\n";
+  print_table(os, "Bitboard RookTable[0x19000]", RookTable);
+  print_table(os, "Bitboard BishopTable[0x1480]", BishopTable);
+  os << "#endif\n";
+
+  os << "\n} // namespace\n\n";
+
+  print_table(os, "uint8_t PopCnt16[1 << 16]", PopCnt16);
+  print_table(os, "int SquareDistance[SQUARE_NB][SQUARE_NB]", SquareDistance);
+  print_table(os, "Bitboard SquareBB[SQUARE_NB]", SquareBB);
+  print_table(os, "Bitboard FileBB[FILE_NB]", FileBB);
+  print_table(os, "Bitboard RankBB[RANK_NB]", RankBB);
+  print_table(os, "Bitboard AdjacentFilesBB[FILE_NB]", AdjacentFilesBB);
+  print_table(os, "Bitboard ForwardRanksBB[COLOR_NB][RANK_NB]", ForwardRanksBB);
+  print_table(os, "Bitboard BetweenBB[SQUARE_NB][SQUARE_NB]", BetweenBB);
+  print_table(os, "Bitboard LineBB[SQUARE_NB][SQUARE_NB]", LineBB);
+  print_table(os, "Bitboard DistanceRingBB[SQUARE_NB][8]", DistanceRingBB);
+  print_table(os, "Bitboard ForwardFileBB[COLOR_NB][SQUARE_NB]", ForwardFileBB);
+  print_table(os, "Bitboard PassedPawnMask[COLOR_NB][SQUARE_NB]", PassedPawnMask);
+  print_table(os, "Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB]", PawnAttackSpan);
+  print_table(os, "Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB]", PseudoAttacks);
+  print_table(os, "Bitboard PawnAttacks[COLOR_NB][SQUARE_NB]", PawnAttacks);
+  os << "#if !defined(LOW_MEMORY) && !defined(NO_BAKED_MAGICS)\n";
+  print_table(os, "Magic RookMagics[SQUARE_NB]", RookMagics);
+  print_table(os, "Magic BishopMagics[SQUARE_NB]", BishopMagics);
+  os << "#endif\n";
+#endif
+}
+
+
 /// Bitboards::init() initializes various bitboard tables. It is called at
 /// startup and relies on global objects to be already zero-initialized.
 
 void Bitboards::init() {
 
+#ifndef BAKED_TABLES
   for (unsigned i = 0; i < (1 << 16); ++i)
       PopCnt16[i] = (uint8_t) popcount16(i);
 
@@ -199,11 +353,21 @@ void Bitboards::init() {
                   }
               }
 
+#endif
+
+#ifdef LOW_MEMORY
+  init_kindergarten(); // Not baked, computed in no time
+#elif defined(INIT_MAGICS)
   Square RookDeltas[] = { NORTH,  EAST,  SOUTH,  WEST };
   Square BishopDeltas[] = { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST };
 
   init_magics(RookTable, RookMagics, RookDeltas);
   init_magics(BishopTable, BishopMagics, BishopDeltas);
+#endif
+
+#ifdef BAKED_TABLES
+  return; // The others are included from bitboard_tables.h
+#endif
 
   for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
   {
@@ -225,6 +389,7 @@ void Bitboards::init() {
 
 namespace {
 
+#if defined(LOW_MEMORY) || defined(INIT_MAGICS)
   Bitboard sliding_attack(Square deltas[], Square sq, Bitboard occupied) {
 
     Bitboard attack = 0;
@@ -242,8 +407,42 @@ namespace {
 
     return attack;
   }
+#endif
+
+
+#ifdef LOW_MEMORY
+  // init_kindergarten() computes the masks and tables of the kindergarten
+  // bitboards, for every subset of the inner squares of the first rank and of
+  // the a-file, which are all the indices the multiplications can give.
+
+  void init_kindergarten() {
 
+    Square lines[][4] = { { EAST, WEST, EAST, WEST },
+                          { NORTH_EAST, SOUTH_WEST, NORTH_EAST, SOUTH_WEST },
+                          { NORTH_WEST, SOUTH_EAST, NORTH_WEST, SOUTH_EAST },
+                          { NORTH, SOUTH, NORTH, SOUTH } };
+
+    for (int i = 0; i < 3; ++i)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            LineMasks[i][s] = sliding_attack(lines[i], s, 0);
+
+    Bitboard innerRank = Rank1BB & ~(FileABB | FileHBB), innerFile = FileABB & ~(Rank1BB | Rank8BB);
+    Bitboard b = 0;
+
+    do {
+        for (File f = FILE_A; f <= FILE_H; ++f)
+            FillUpAttacks[f][(b * FileBBB) >> 58] = sliding_attack(lines[0], make_square(f, RANK_1), b) * FileABB;
+        b = (b - innerRank) & innerRank;
+    } while (b);
+
+    do {
+        for (Rank r = RANK_1; r <= RANK_8; ++r)
+            AFileAttacks[r][(b * 0x0004081020408000ULL) >> 58] = sliding_attack(lines[3], make_square(FILE_A, r), b);
+        b = (b - innerFile) & innerFile;
+    } while (b);
+  }
 
+#elif defined(INIT_MAGICS)
   // init_magics() computes all rook and bishop attacks at startup. Magic
   // bitboards are used to look up attacks of sliding pieces. As a reference see
   // chessprogramming.wikispaces.com/Magic+Bitboards. In particular, here we
@@ -323,4 +522,5 @@ namespace {
         }
     }
   }
+#endif
 }
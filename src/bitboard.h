@@ -21,6 +21,7 @@
 #ifndef BITBOARD_H_INCLUDED
 #define BITBOARD_H_INCLUDED
 
+#include <iosfwd>
 #include <string>
 
 #include "types.h"
@@ -29,6 +30,8 @@ namespace Bitbases {
 
 void init();
 bool probe(Square wksq, Square wpsq, Square bksq, Color us);
+void print_tables(std::ostream& os);
+size_t bytes();
 
 }
 
@@ -36,6 +39,8 @@ namespace Bitboards {
 
 void init();
 const std::string pretty(Bitboard b);
+void print_tables(std::ostream& os);
+size_t slider_bytes();
 
 }
 
@@ -99,8 +104,20 @@ struct Magic {
   }
 };
 
+#ifdef LOW_MEMORY
+/// With LOW_MEMORY, the attacks of sliders are looked up with kindergarten
+/// bitboards instead of magics, in 10 KB of tables instead of 845 KB. The
+/// occupancy of a line through the square, with one square per file, is
+/// gathered into 6 bits by a multiplication, which index the attacks of a
+/// slider on that file for every rank. See
+/// chessprogramming.wikispaces.com/Kindergarten+Bitboards
+extern Bitboard LineMasks[3][SQUARE_NB]; // Rank, diagonal and anti-diagonal, without the square
+extern Bitboard FillUpAttacks[FILE_NB][64];
+extern Bitboard AFileAttacks[RANK_NB][64];
+#else
 extern Magic RookMagics[SQUARE_NB];
 extern Magic BishopMagics[SQUARE_NB];
+#endif
 
 
 /// Overloads of bitwise operators between a Bitboard and a Square for testing
@@ -247,12 +264,30 @@ template<> inline int distance<Rank>(Square x, Square y) { return distance(rank_
 /// attacks_bb() returns a bitboard representing all the squares attacked by a
 /// piece of type Pt (bishop or rook) placed on 's'.
 
+#ifdef LOW_MEMORY
+inline Bitboard line_attacks(Bitboard mask, Square s, Bitboard occupied) {
+  return mask & FillUpAttacks[file_of(s)][((mask & occupied) * FileBBB) >> 58];
+}
+
+inline Bitboard file_attacks(Square s, Bitboard occupied) {
+  Bitboard b = FileABB & (occupied >> file_of(s));
+  return AFileAttacks[rank_of(s)][(b * 0x0004081020408000ULL) >> 58] << file_of(s);
+}
+
+template<PieceType Pt>
+inline Bitboard attacks_bb(Square s, Bitboard occupied) {
+
+  return Pt == ROOK ? line_attacks(LineMasks[0][s], s, occupied) | file_attacks(s, occupied)
+                    : line_attacks(LineMasks[1][s], s, occupied) | line_attacks(LineMasks[2][s], s, occupied);
+}
+#else
 template<PieceType Pt>
 inline Bitboard attacks_bb(Square s, Bitboard occupied) {
 
   const Magic& m = Pt == ROOK ? RookMagics[s] : BishopMagics[s];
   return m.attacks[m.index(occupied)];
 }
+#endif
 
 inline Bitboard attacks_bb(PieceType pt, Square s, Bitboard occupied) {
 
@@ -0,0 +1,227 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define USE_MMAP
+#endif
+
+#include "book.h"
+#include "misc.h"
+#include "movegen.h"
+
+namespace {
+
+  const size_t EntrySize = 16;
+
+  uint64_t read_be(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    while (bytes--)
+        v = (v << 8) | *p++;
+    return v;
+  }
+
+  void write_be(std::string& s, uint64_t v, int bytes) {
+    while (bytes--)
+        s += char(v >> (8 * bytes));
+  }
+
+} // namespace
+
+
+/// Book::open() maps the given file, or where that is not available reads it,
+/// and returns false if it cannot be opened. An empty name closes the book.
+
+bool Book::open(const std::string& fileName) {
+
+  close();
+
+  if (fileName.empty() || fileName == "<empty>")
+      return true;
+
+#ifdef USE_MMAP
+  struct stat statbuf;
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+
+  if (fd == -1)
+      return false;
+
+  fstat(fd, &statbuf);
+  mappedSize = statbuf.st_size;
+  mapping = mappedSize ? mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+      return mapping = nullptr, false;
+
+  data = (const unsigned char*)mapping;
+  count = mappedSize / EntrySize;
+  return true;
+#else
+  std::ifstream in(fileName, std::ios::binary);
+  std::string s((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if (!in)
+      return false;
+
+  assign(s.data(), s.size());
+  return true;
+#endif
+}
+
+
+/// Book::assign() sets a copy of the given data as the book, e.g. the content
+/// of a book file passed to the web worker.
+
+void Book::assign(const char* bytes, size_t size) {
+
+  close();
+  copy.assign(bytes, size);
+  data = (const unsigned char*)copy.data();
+  count = size / EntrySize;
+}
+
+
+/// Book::close() unmaps or frees the book
+
+void Book::close() {
+
+#ifdef USE_MMAP
+  if (mapping)
+      munmap(mapping, mappedSize);
+#endif
+
+  mapping = nullptr;
+  mappedSize = 0;
+  copy.clear();
+  data = nullptr;
+  count = 0;
+}
+
+
+/// Book::bytes() returns the size of the book data, mapped or copied
+
+size_t Book::bytes() const { return count * EntrySize; }
+
+
+/// Book::entry() reads the entry at the given index
+
+Book::Entry Book::entry(size_t i) const {
+
+  const unsigned char* p = data + i * EntrySize;
+  return { read_be(p, 8), uint16_t(read_be(p + 8, 2)), uint16_t(read_be(p + 10, 2)) };
+}
+
+
+/// Book::encode() returns a move in the format of Polyglot: the to square in
+/// bits 0-5, the from square in bits 6-11 and the promotion piece in bits 12-14,
+/// from 1 for a knight to 4 for a queen (5 for a king in giveaway). Castling is
+/// king takes rook, as for Move. Drops cannot be encoded and give 0.
+
+uint16_t Book::encode(Move m) {
+
+#ifdef CRAZYHOUSE
+  if (type_of(m) == DROP)
+      return 0;
+#endif
+
+  return uint16_t(  to_sq(m) | from_sq(m) << 6
+                  | (type_of(m) == PROMOTION ? (promotion_type(m) - KNIGHT + 1) << 12 : 0));
+}
+
+
+/// Book::probe() binary searches the entries of the position and returns the
+/// one of highest weight or picks one at random in proportion to the weights.
+/// Only legal moves of non-zero weight are played, and if the search is limited
+/// to some moves, only those. Otherwise MOVE_NONE is returned.
+
+Move Book::probe(const Position& pos, Selection selection, const std::vector<Move>& searchMoves) const {
+
+  if (!count || selection == NONE)
+      return MOVE_NONE;
+
+  Key key = pos.key();
+  size_t lo = 0, hi = count;
+
+  while (lo < hi) // Find the first entry of the key
+  {
+      size_t mid = (lo + hi) / 2;
+      if (entry(mid).key < key)
+          lo = mid + 1;
+      else
+          hi = mid;
+  }
+
+  static thread_local PRNG rng(now()); // PRNG sequence should be non-deterministic
+  Move best = MOVE_NONE;
+  unsigned bestWeight = 0, sum = 0;
+
+  for (Entry e; lo < count && (e = entry(lo)).key == key; ++lo)
+  {
+      Move move = MOVE_NONE;
+
+      for (const auto& m : MoveList<LEGAL>(pos))
+          if (encode(m) == e.move)
+              move = m;
+
+      if (   !move
+          || !e.weight
+          || (!searchMoves.empty() && !std::count(searchMoves.begin(), searchMoves.end(), move)))
+          continue;
+
+      // Reservoir sampling picks each move with a probability of weight / sum
+      sum += e.weight;
+
+      if (selection == BEST ? e.weight > bestWeight : rng.rand<unsigned>() % sum < e.weight)
+          best = move, bestWeight = e.weight;
+  }
+
+  return best;
+}
+
+
+/// Book::serialize() sorts the entries by key and, for the same key, by
+/// decreasing weight, and returns them in the file format.
+
+std::string Book::serialize(std::vector<Entry>& entries) {
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+      return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+  });
+
+  std::string s;
+
+  for (const Entry& e : entries)
+  {
+      write_be(s, e.key, 8);
+      write_be(s, e.move, 2);
+      write_be(s, e.weight, 2);
+      write_be(s, 0, 4); // Learn
+  }
+
+  return s;
+}
@@ -0,0 +1,68 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "position.h"
+#include "types.h"
+
+/// Book is an opening book in the file format of Polyglot: entries of 16 bytes
+/// holding a 64-bit key, a 16-bit move, weight and learn value and sorted by
+/// key, all big endian. The key is Position::key() though, not the Polyglot
+/// hash, so that books cover the variants as well and are written by the
+/// "makebook" command. Chess keys are the same in all builds, those of the
+/// other variants only in builds with the same variants.
+
+class Book {
+
+public:
+  enum Selection { NONE, BEST, WEIGHTED };
+
+  struct Entry {
+    Key key;
+    uint16_t move, weight;
+  };
+
+ ~Book() { close(); }
+  bool open(const std::string& fileName);
+  void assign(const char* data, size_t size);
+  void close();
+  size_t size() const { return count; }
+  size_t bytes() const;
+  Move probe(const Position& pos, Selection selection, const std::vector<Move>& searchMoves) const;
+
+  static uint16_t encode(Move m);
+  static std::string serialize(std::vector<Entry>& entries);
+
+private:
+  Entry entry(size_t i) const;
+
+  const unsigned char* data = nullptr;
+  size_t count = 0;
+  std::string copy;         // The data when it is not mapped
+  void* mapping = nullptr;  // The mapped file
+  size_t mappedSize = 0;
+};
+
+#endif // #ifndef BOOK_H_INCLUDED
@@ -88,39 +88,55 @@ namespace {
 
 /// Endgames members definitions
 
-Endgames::Endgames() {
-
-  add<CHESS_VARIANT, KPK>("KPvK");
-  add<CHESS_VARIANT, KNNK>("KNNvK");
-  add<CHESS_VARIANT, KBNK>("KBNvK");
-  add<CHESS_VARIANT, KRKP>("KRvKP");
-  add<CHESS_VARIANT, KRKB>("KRvKB");
-  add<CHESS_VARIANT, KRKN>("KRvKN");
-  add<CHESS_VARIANT, KQKP>("KQvKP");
-  add<CHESS_VARIANT, KQKR>("KQvKR");
-
-  add<CHESS_VARIANT, KNPK>("KNPvK");
-  add<CHESS_VARIANT, KNPKB>("KNPvKB");
-  add<CHESS_VARIANT, KRPKR>("KRPvKR");
-  add<CHESS_VARIANT, KRPKB>("KRPvKB");
-  add<CHESS_VARIANT, KBPKB>("KBPvKB");
-  add<CHESS_VARIANT, KBPKN>("KBPvKN");
-  add<CHESS_VARIANT, KBPPKB>("KBPPvKB");
-  add<CHESS_VARIANT, KRPPKRP>("KRPPvKRP");
+/// Endgames::init() adds the specialized endgames of a variant, unless they are
+/// already there.
 
+void Endgames::init(Variant v) {
+
+  if (!empty(v))
+      return;
+
+  switch (v)
+  {
+  case CHESS_VARIANT:
+      add<CHESS_VARIANT, KPK>("KPvK");
+      add<CHESS_VARIANT, KNNK>("KNNvK");
+      add<CHESS_VARIANT, KBNK>("KBNvK");
+      add<CHESS_VARIANT, KRKP>("KRvKP");
+      add<CHESS_VARIANT, KRKB>("KRvKB");
+      add<CHESS_VARIANT, KRKN>("KRvKN");
+      add<CHESS_VARIANT, KQKP>("KQvKP");
+      add<CHESS_VARIANT, KQKR>("KQvKR");
+
+      add<CHESS_VARIANT, KNPK>("KNPvK");
+      add<CHESS_VARIANT, KNPKB>("KNPvKB");
+      add<CHESS_VARIANT, KRPKR>("KRPvKR");
+      add<CHESS_VARIANT, KRPKB>("KRPvKB");
+      add<CHESS_VARIANT, KBPKB>("KBPvKB");
+      add<CHESS_VARIANT, KBPKN>("KBPvKN");
+      add<CHESS_VARIANT, KBPPKB>("KBPPvKB");
+      add<CHESS_VARIANT, KRPPKRP>("KRPPvKRP");
+      break;
 #ifdef ANTI
-  add<ANTI_VARIANT, RK>("RvK");
-  add<ANTI_VARIANT, KN>("KvN");
-  add<ANTI_VARIANT, NN>("NvN");
+  case ANTI_VARIANT:
+      add<ANTI_VARIANT, RK>("RvK");
+      add<ANTI_VARIANT, KN>("KvN");
+      add<ANTI_VARIANT, NN>("NvN");
+      break;
 #endif
 #ifdef ATOMIC
-  add<ATOMIC_VARIANT, KPK>("KPvK");
-  add<ATOMIC_VARIANT, KNK>("KNvK");
-  add<ATOMIC_VARIANT, KBK>("KBvK");
-  add<ATOMIC_VARIANT, KRK>("KRvK");
-  add<ATOMIC_VARIANT, KQK>("KQvK");
-  add<ATOMIC_VARIANT, KNNK>("KNNvK");
+  case ATOMIC_VARIANT:
+      add<ATOMIC_VARIANT, KPK>("KPvK");
+      add<ATOMIC_VARIANT, KNK>("KNvK");
+      add<ATOMIC_VARIANT, KBK>("KBvK");
+      add<ATOMIC_VARIANT, KRK>("KRvK");
+      add<ATOMIC_VARIANT, KQK>("KQvK");
+      add<ATOMIC_VARIANT, KNNK>("KNNvK");
+      break;
 #endif
+  default:
+      break;
+  }
 }
 
 
@@ -101,8 +101,9 @@ struct Endgame : public EndgameBase<T> {
 
 
 /// The Endgames class stores the pointers to endgame evaluation and scaling
-/// base objects in two std::map. We use polymorphism to invoke the actual
-/// endgame function by calling its virtual operator().
+/// base objects in two std::map for each variant. We use polymorphism to invoke
+/// the actual endgame function by calling its virtual operator(). The maps of
+/// a variant are only filled by init(), when it is played for the first time.
 
 class Endgames {
 
@@ -110,26 +111,43 @@ class Endgames {
   template<typename T> using Map = std::map<Key, Ptr<T>>;
 
   template<typename T>
-  Map<T>& map() {
-    return std::get<std::is_same<T, ScaleFactor>::value>(maps);
+  Map<T>& map(Variant v) {
+    return std::get<std::is_same<T, ScaleFactor>::value>(maps[v]);
   }
 
   template<Variant V, EndgameCode E, typename T = eg_type<V, E>, typename P = Ptr<T>>
   void add(const std::string& code) {
 
     StateInfo st;
-    map<T>()[Position().set(code, WHITE, V, &st).material_key()] = P(new Endgame<V, E>(WHITE));
-    map<T>()[Position().set(code, BLACK, V, &st).material_key()] = P(new Endgame<V, E>(BLACK));
+    map<T>(V)[Position().set(code, WHITE, V, &st).material_key()] = P(new Endgame<V, E>(WHITE));
+    map<T>(V)[Position().set(code, BLACK, V, &st).material_key()] = P(new Endgame<V, E>(BLACK));
   }
 
-  std::pair<Map<Value>, Map<ScaleFactor>> maps;
+  std::pair<Map<Value>, Map<ScaleFactor>> maps[VARIANT_NB];
 
 public:
-  Endgames();
+  void init(Variant v);
+
+  void clear(Variant v) {
+    map<Value>(v).clear();
+    map<ScaleFactor>(v).clear();
+  }
+
+  bool empty(Variant v) {
+    return map<Value>(v).empty() && map<ScaleFactor>(v).empty();
+  }
+
+  // Approximate, counting a map node as four pointers besides its value
+  size_t bytes() const {
+    size_t n = 0;
+    for (const auto& m : maps)
+        n += m.first.size() + m.second.size();
+    return n * (4 * sizeof(void*) + sizeof(Key) + sizeof(Ptr<Value>) + sizeof(EndgameBase<Value>));
+  }
 
   template<typename T>
-  EndgameBase<T>* probe(Key key) {
-    return map<T>().count(key) ? map<T>()[key].get() : nullptr;
+  EndgameBase<T>* probe(Variant v, Key key) {
+    return map<T>(v).count(key) ? map<T>(v)[key].get() : nullptr;
   }
 };
 
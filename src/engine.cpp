@@ -0,0 +1,131 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "engine.h"
+
+thread_local Engine* CurrentEngine; // Engine of the calling thread
+
+
+/// engine_out() is the stream behind sync_cout
+
+std::ostream& engine_out() {
+  return CurrentEngine ? CurrentEngine->out() : std::cout;
+}
+
+
+int LineOutput::overflow(int c) {
+
+  if (c == '\n')
+  {
+      callback(data, line.c_str());
+      line.clear();
+  }
+  else if (c != traits_type::eof())
+      line += char(c);
+
+  return traits_type::not_eof(c);
+}
+
+
+/// Engine constructor sets up the options, the hash and the threads of a new
+/// instance. The shared tables must be already initialized, see main().
+
+Engine::Engine(LineOutput::Callback cb, void* data)
+  : tt(ownTT), search(Search::new_state()), session(nullptr),
+    hasOutput(cb != nullptr), lineOutput(cb, data), lineStream(&lineOutput) {
+
+  Engine* caller = CurrentEngine;
+  CurrentEngine = this;
+
+  UCI::init(options);
+  setup(options["Threads"]);
+
+  CurrentEngine = caller;
+}
+
+
+/// This constructor creates a single threaded engine with the options and the
+/// tablebases of the parent, for the workers of the "batch" command. It has a
+/// hash of its own of 'hashMB', or shares the one of the parent if 0. Its
+/// output goes to std::cout.
+
+Engine::Engine(const Engine& parent, size_t hashMB)
+  : options(parent.options), tt(hashMB ? ownTT : parent.tt),
+#ifndef NO_SYZYGY
+    tablebases(parent.tablebases),
+#endif
+    search(Search::new_state()), session(nullptr),
+    hasOutput(false), lineOutput(nullptr, nullptr), lineStream(&lineOutput) {
+
+  Engine* caller = CurrentEngine;
+  CurrentEngine = this;
+
+  if (hashMB)
+      options["Hash"] = std::to_string(hashMB);
+
+  setup(1);
+
+  CurrentEngine = caller;
+}
+
+
+void Engine::setup(size_t threadCount) {
+
+  if (&tt == &ownTT)
+      tt.resize(options["Hash"]);
+
+  threads.init(threadCount);
+  Search::clear(); // After threads are up
+}
+
+
+/// Engine destructor stops any running search and terminates the threads
+
+Engine::~Engine() {
+
+  Engine* caller = CurrentEngine;
+  CurrentEngine = this;
+
+  threads.stop = true;
+  threads.exit();
+  UCI::delete_session(session);
+  Search::delete_state(search);
+
+  CurrentEngine = caller != this ? caller : nullptr;
+}
+
+
+extern "C" Engine* engine_create(LineOutput::Callback output, void* data) {
+
+  return new Engine(output, data);
+}
+
+extern "C" void engine_command(Engine* engine, const char* cmd) {
+
+  Engine* caller = CurrentEngine;
+  CurrentEngine = engine;
+  UCI::command(cmd);
+  CurrentEngine = caller;
+}
+
+extern "C" void engine_destroy(Engine* engine) {
+
+  delete engine;
+}
@@ -0,0 +1,113 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+#include "book.h"
+#include "search.h"
+#include "store.h"
+#include "syzygy/tbprobe.h"
+#include "thread.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+
+/// LineOutput is a stream buffer handing the output of an engine over to a
+/// callback, one line at a time and without the trailing newline.
+
+class LineOutput : public std::streambuf {
+public:
+  typedef void (*Callback)(void* data, const char* line);
+
+  LineOutput(Callback cb, void* d) : callback(cb), data(d) {}
+
+private:
+  int overflow(int c) override;
+
+  Callback callback;
+  void* data;
+  std::string line;
+};
+
+
+/// Engine holds everything an engine instance needs apart from the read-only
+/// tables shared by all of them: bitboards, bitbases and PSQT. The Syzygy
+/// tables are held through a reference, shared with the engines having the
+/// same path and variant, see Tablebases::init(). Code
+/// running for an instance finds it through CurrentEngine, which is set for
+/// the threads of its pool and by the callers of the C API below, and the old
+/// global names are macros over its members.
+
+struct Engine {
+
+  explicit Engine(LineOutput::Callback cb = nullptr, void* data = nullptr);
+  Engine(const Engine& parent, size_t hashMB);
+  ~Engine();
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  std::ostream& out() { return hasOutput ? lineStream : std::cout; }
+
+  UCI::OptionsMap options;
+  TranspositionTable ownTT;
+  TranspositionTable& tt; // The one of another engine when shared with it
+  ThreadPool threads;
+  TimeManagement time;
+  Search::LimitsType limits;
+  Book book;
+  ResultStore store;
+#ifndef NO_SYZYGY
+  Tablebases::TablesPtr tablebases; // None without a path
+#endif
+  Search::State* search;  // Defined in search.cpp
+  UCI::Session* session;  // Defined in uci.cpp, created on first use
+
+private:
+  void setup(size_t threadCount);
+
+  bool hasOutput;
+  LineOutput lineOutput;
+  std::ostream lineStream;
+};
+
+extern thread_local Engine* CurrentEngine;
+
+#define Options (CurrentEngine->options)
+#define TT      (CurrentEngine->tt)
+#define Threads (CurrentEngine->threads)
+#define Time    (CurrentEngine->time)
+#define Limits  (CurrentEngine->limits)
+
+
+/// C API to host several engines in one process. Commands are the same as on
+/// stdin and the output lines go to the callback given to engine_create().
+
+extern "C" {
+Engine* engine_create(LineOutput::Callback output, void* data);
+void engine_command(Engine* engine, const char* cmd);
+void engine_destroy(Engine* engine);
+}
+
+#endif // #ifndef ENGINE_H_INCLUDED
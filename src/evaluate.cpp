@@ -24,10 +24,15 @@
 #include <iomanip>
 #include <sstream>
 
+#ifdef USE_WASM_SIMD
+#include <wasm_simd128.h>
+#endif
+
 #include "bitboard.h"
 #include "evaluate.h"
 #include "material.h"
 #include "pawns.h"
+#include "thread.h"
 
 namespace {
 
@@ -82,8 +87,8 @@ namespace {
   using namespace Trace;
 
   // Evaluation class contains various information computed and collected
-  // by the evaluation functions.
-  template<Tracing T = NO_TRACE>
+  // by the evaluation functions, for a position of the variant V.
+  template<Variant V, Tracing T = NO_TRACE>
   class Evaluation {
 
   public:
@@ -96,6 +101,9 @@ namespace {
   private:
     // Evaluation helpers (used when calling value())
     template<Color Us> void initialize();
+#ifdef USE_WASM_SIMD
+    void initialize_pair();
+#endif
     template<Color Us> Score evaluate_king();
     template<Color Us> Score evaluate_threats();
     template<Color Us> Score evaluate_passed_pawns();
@@ -103,6 +111,7 @@ namespace {
     template<Color Us, PieceType Pt> Score evaluate_pieces();
     ScaleFactor evaluate_scale_factor(Value eg);
     Score evaluate_initiative(Value eg);
+    bool kingless(Color c) const;
 
     // Data members
     const Position& pos;
@@ -646,8 +655,8 @@ namespace {
   // initialize() computes king and pawn attacks, and the king ring bitboard
   // for a given color. This is done at the beginning of the evaluation.
 
-  template<Tracing T> template<Color Us>
-  void Evaluation<T>::initialize() {
+  template<Variant V, Tracing T> template<Color Us>
+  void Evaluation<V, T>::initialize() {
 
     const Color  Them = (Us == WHITE ? BLACK : WHITE);
     const Square Up   = (Us == WHITE ? NORTH : SOUTH);
@@ -660,25 +669,29 @@ namespace {
     // Squares occupied by those pawns, by our king, or controlled by enemy pawns
     // are excluded from the mobility area.
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT)
         mobilityArea[Us] = ~0;
     else
 #endif
-    mobilityArea[Us] = ~(b | pos.square<KING>(Us) | pe->pawn_attacks(Them));
+    mobilityArea[Us] = ~(b | pos.pieces(Us, KING) | pe->pawn_attacks(Them));
 
     // Initialise the attack bitboards with the king and pawn information
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT)
     {
+#ifdef INCREMENTAL_ATTACKS
+        b = attackedBy[Us][KING] = pos.attacks_by(Us, KING);
+#else
         attackedBy[Us][KING] = 0;
         Bitboard kings = pos.pieces(Us, KING);
         while (kings)
             attackedBy[Us][KING] |= pos.attacks_from<KING>(pop_lsb(&kings));
         b = attackedBy[Us][KING];
+#endif
     }
     else
 #endif
-    b = attackedBy[Us][KING] = pos.attacks_from<KING>(pos.square<KING>(Us));
+    b = attackedBy[Us][KING] = kingless(Us) ? 0 : pos.attacks_from<KING>(pos.square<KING>(Us));
     attackedBy[Us][PAWN] = pe->pawn_attacks(Us);
 
     attackedBy2[Us]            = b & attackedBy[Us][PAWN];
@@ -687,11 +700,11 @@ namespace {
     // Init our king safety tables only if we are going to use them
     if ((
 #ifdef ANTI
-        !pos.is_anti() &&
+        V != ANTI_VARIANT &&
 #endif
         (pos.non_pawn_material(Them) >= RookValueMg + KnightValueMg))
 #ifdef CRAZYHOUSE
-        || pos.is_house()
+        || V == CRAZYHOUSE_VARIANT
 #endif
     )
     {
@@ -707,11 +720,86 @@ namespace {
   }
 
 
+#ifdef USE_WASM_SIMD
+  // initialize_pair() does the same as initialize<WHITE>() followed by
+  // initialize<BLACK>(), but computes the bitboards of both colors at once in
+  // the two lanes of a wasm SIMD vector, white in lane 0 and black in lane 1.
+  // Antichess with its multiple kings is left to the scalar version.
+
+  template<Variant V, Tracing T>
+  void Evaluation<V, T>::initialize_pair() {
+
+    const v128_t WhiteLane = wasm_i64x2_make(-1, 0);
+    const v128_t LowRanks  = wasm_i64x2_make(Rank2BB | Rank3BB, Rank7BB | Rank6BB);
+
+    const Square ksq[COLOR_NB] = { pos.square<KING>(WHITE), pos.square<KING>(BLACK) };
+    const Bitboard kingAttacksBB[COLOR_NB] = { kingless(WHITE) ? 0 : pos.attacks_from<KING>(ksq[WHITE]),
+                                               kingless(BLACK) ? 0 : pos.attacks_from<KING>(ksq[BLACK]) };
+
+    v128_t pawns = wasm_i64x2_make(pos.pieces(WHITE, PAWN), pos.pieces(BLACK, PAWN));
+    v128_t occupied = wasm_i64x2_splat(pos.pieces());
+    v128_t kings = wasm_i64x2_make(pos.pieces(WHITE, KING), pos.pieces(BLACK, KING));
+    v128_t pawnAttacks = wasm_i64x2_make(pe->pawn_attacks(WHITE), pe->pawn_attacks(BLACK));
+    v128_t kingAttacks = wasm_i64x2_make(kingAttacksBB[WHITE], kingAttacksBB[BLACK]);
+
+    // Shift down for white and up for black, and the opposite for shift_up()
+    auto shift_down = [&](v128_t b) {
+        return wasm_v128_bitselect(wasm_u64x2_shr(b, 8), wasm_i64x2_shl(b, 8), WhiteLane);
+    };
+    auto shift_up = [&](v128_t b) {
+        return wasm_v128_bitselect(wasm_i64x2_shl(b, 8), wasm_u64x2_shr(b, 8), WhiteLane);
+    };
+
+    // Find our pawns on the first two ranks, and those which are blocked
+    v128_t b = wasm_v128_and(pawns, wasm_v128_or(shift_down(occupied), LowRanks));
+
+    // Squares occupied by those pawns, by our king, or controlled by enemy pawns
+    // are excluded from the mobility area.
+    v128_t theirPawnAttacks = wasm_i64x2_shuffle(pawnAttacks, pawnAttacks, 1, 0);
+    v128_t area = wasm_v128_not(wasm_v128_or(wasm_v128_or(b, kings), theirPawnAttacks));
+
+    v128_t attacked2 = wasm_v128_and(kingAttacks, pawnAttacks);
+    v128_t attackedAll = wasm_v128_or(kingAttacks, pawnAttacks);
+    v128_t ring = wasm_v128_or(kingAttacks, shift_up(kingAttacks));
+    const Bitboard rings[COLOR_NB] = { Bitboard(wasm_i64x2_extract_lane(ring, 0)),
+                                       Bitboard(wasm_i64x2_extract_lane(ring, 1)) };
+
+    mobilityArea[WHITE] = wasm_i64x2_extract_lane(area, 0);
+    mobilityArea[BLACK] = wasm_i64x2_extract_lane(area, 1);
+    attackedBy2[WHITE]  = wasm_i64x2_extract_lane(attacked2, 0);
+    attackedBy2[BLACK]  = wasm_i64x2_extract_lane(attacked2, 1);
+    attackedBy[WHITE][ALL_PIECES] = wasm_i64x2_extract_lane(attackedAll, 0);
+    attackedBy[BLACK][ALL_PIECES] = wasm_i64x2_extract_lane(attackedAll, 1);
+
+    for (Color c = WHITE; c <= BLACK; ++c)
+    {
+        attackedBy[c][KING] = kingAttacksBB[c];
+        attackedBy[c][PAWN] = pe->pawn_attacks(c);
+
+        // Init our king safety tables only if we are going to use them
+        if (   pos.non_pawn_material(~c) >= RookValueMg + KnightValueMg
+#ifdef CRAZYHOUSE
+            || V == CRAZYHOUSE_VARIANT
+#endif
+        )
+        {
+            kingRing[c] = relative_rank(c, ksq[c]) == RANK_1 ? rings[c] : attackedBy[c][KING];
+
+            kingAttackersCount[~c] = popcount(attackedBy[c][KING] & pe->pawn_attacks(~c));
+            kingAdjacentZoneAttacksCount[~c] = kingAttackersWeight[~c] = 0;
+        }
+        else
+            kingRing[c] = kingAttackersCount[~c] = 0;
+    }
+  }
+#endif
+
+
   // evaluate_pieces() assigns bonuses and penalties to the pieces of a given
   // color and type.
 
-  template<Tracing T>  template<Color Us, PieceType Pt>
-  Score Evaluation<T>::evaluate_pieces() {
+  template<Variant V, Tracing T>  template<Color Us, PieceType Pt>
+  Score Evaluation<V, T>::evaluate_pieces() {
 
     const Color Them = (Us == WHITE ? BLACK : WHITE);
     const Bitboard OutpostRanks = (Us == WHITE ? Rank4BB | Rank5BB | Rank6BB
@@ -740,20 +828,20 @@ namespace {
         if (b & kingRing[Them])
         {
             kingAttackersCount[Us]++;
-            kingAttackersWeight[Us] += KingAttackWeights[pos.variant()][Pt];
+            kingAttackersWeight[Us] += KingAttackWeights[V][Pt];
             kingAdjacentZoneAttacksCount[Us] += popcount(b & attackedBy[Them][KING]);
         }
 
         int mob = popcount(b & mobilityArea[Us]);
 
-        mobility[Us] += MobilityBonus[pos.variant()][Pt - 2][mob];
+        mobility[Us] += MobilityBonus[V][Pt - 2][mob];
 
 #ifdef ANTI
-        if (pos.is_anti())
+        if (V == ANTI_VARIANT)
             continue;
 #endif
 #ifdef HORDE
-        if (pos.is_horde() && pos.is_horde_color(Us)) {} else
+        if (V == HORDE_VARIANT && pos.is_horde_color(Us)) {} else
 #endif
         // Bonus for this piece as a king protector
         score += KingProtector[Pt - 2] * distance(s, pos.square<KING>(Us));
@@ -814,7 +902,7 @@ namespace {
                 score += RookOnFile[!!pe->semiopen_file(Them, file_of(s))];
 
             // Penalty when trapped by the king, even more if the king cannot castle
-            else if (mob <= 3)
+            else if (mob <= 3 && !kingless(Us))
             {
                 Square ksq = pos.square<KING>(Us);
 
@@ -842,14 +930,17 @@ namespace {
 
   // evaluate_king() assigns bonuses and penalties to a king of a given color
 
-  template<Tracing T>  template<Color Us>
-  Score Evaluation<T>::evaluate_king() {
+  template<Variant V, Tracing T>  template<Color Us>
+  Score Evaluation<V, T>::evaluate_king() {
 
     const Color Them    = (Us == WHITE ? BLACK : WHITE);
     const Square Up     = (Us == WHITE ? NORTH : SOUTH);
     const Bitboard Camp = (Us == WHITE ? AllSquares ^ Rank6BB ^ Rank7BB ^ Rank8BB
                                        : AllSquares ^ Rank1BB ^ Rank2BB ^ Rank3BB);
 
+    if (kingless(Us))
+        return SCORE_ZERO;
+
     const Square ksq = pos.square<KING>(Us);
     Bitboard kingOnlyDefended, undefended, b, b1, b2, safe, other;
     int kingDanger;
@@ -858,16 +949,11 @@ namespace {
     Score score = pe->king_safety<Us>(pos, ksq);
 
     // Main king safety evaluation
-    if (kingAttackersCount[Them] > (1 - pos.count<QUEEN>(Them))
-#ifdef HORDE
-        // Hack to prevent segmentation fault for multi-queen positions
-        && !(pos.is_horde() && ksq == SQ_NONE)
-#endif
-    )
+    if (kingAttackersCount[Them] > (1 - pos.count<QUEEN>(Them)))
     {
         // Find the attacked squares which are defended only by our king...
 #ifdef ATOMIC
-        if (pos.is_atomic())
+        if (V == ATOMIC_VARIANT)
             kingOnlyDefended =  (attackedBy[Them][ALL_PIECES]
                                  | (pos.pieces(Them) ^ pos.pieces(Them, KING)))
                               & attackedBy[Us][KING];
@@ -888,7 +974,7 @@ namespace {
         // number and types of the enemy's attacking pieces, the number of
         // attacked and weak squares around our king, the absence of queen and
         // the quality of the pawn shelter (current 'score' value).
-        const auto KDP = KingDangerParams[pos.variant()];
+        const auto KDP = KingDangerParams[V];
         kingDanger =           kingAttackersCount[Them] * kingAttackersWeight[Them]
                     + KDP[0] * kingAdjacentZoneAttacksCount[Them]
                     + KDP[1] * popcount(kingOnlyDefended | undefended)
@@ -899,7 +985,7 @@ namespace {
         Bitboard h = 0;
 
 #ifdef CRAZYHOUSE
-        if (pos.is_house())
+        if (V == CRAZYHOUSE_VARIANT)
         {
             kingDanger += KingDangerInHand[ALL_PIECES] * pos.count_in_hand<ALL_PIECES>(Them);
             kingDanger += KingDangerInHand[PAWN] * pos.count_in_hand<PAWN>(Them);
@@ -915,7 +1001,7 @@ namespace {
         safe  = ~pos.pieces(Them);
         safe &= ~attackedBy[Us][ALL_PIECES] | (kingOnlyDefended & attackedBy2[Them]);
 #ifdef ATOMIC
-        if (pos.is_atomic())
+        if (V == ATOMIC_VARIANT)
             safe |= attackedBy[Us][KING];
 #endif
 
@@ -941,13 +1027,13 @@ namespace {
         other = ~(   attackedBy[Us][PAWN]
                   | (pos.pieces(Them, PAWN) & shift<Up>(pos.pieces(PAWN))));
 #ifdef THREECHECK
-        if (pos.is_three_check() && pos.checks_given(Them))
+        if (V == THREECHECK_VARIANT && pos.checks_given(Them))
             other = safe = ~pos.pieces(Them);
 #endif
 
         // Enemy rooks safe and other checks
 #ifdef CRAZYHOUSE
-        h = pos.is_house() && pos.count_in_hand<ROOK>(Them) ? ~pos.pieces() : 0;
+        h = V == CRAZYHOUSE_VARIANT && pos.count_in_hand<ROOK>(Them) ? ~pos.pieces() : 0;
 #endif
         if (b1 & ((attackedBy[Them][ROOK] & safe) | (h & dropSafe)))
             kingDanger += RookCheck;
@@ -957,7 +1043,7 @@ namespace {
 
         // Enemy bishops safe and other checks
 #ifdef CRAZYHOUSE
-        h = pos.is_house() && pos.count_in_hand<BISHOP>(Them) ? ~pos.pieces() : 0;
+        h = V == CRAZYHOUSE_VARIANT && pos.count_in_hand<BISHOP>(Them) ? ~pos.pieces() : 0;
 #endif
         if (b2 & ((attackedBy[Them][BISHOP] & safe) | (h & dropSafe)))
             kingDanger += BishopCheck;
@@ -967,7 +1053,7 @@ namespace {
 
         // Enemy knights safe and other checks
 #ifdef CRAZYHOUSE
-        h = pos.is_house() && pos.count_in_hand<KNIGHT>(Them) ? ~pos.pieces() : 0;
+        h = V == CRAZYHOUSE_VARIANT && pos.count_in_hand<KNIGHT>(Them) ? ~pos.pieces() : 0;
 #endif
         Bitboard k = pos.attacks_from<KNIGHT>(ksq);
         b = k & attackedBy[Them][KNIGHT];
@@ -978,7 +1064,7 @@ namespace {
             score -= OtherCheck;
 
 #ifdef ATOMIC
-        if (pos.is_atomic())
+        if (V == ATOMIC_VARIANT)
         {
             kingDanger += IndirectKingAttack * popcount(pos.attacks_from<KING>(pos.square<KING>(Us)) & pos.pieces(Us) & attackedBy[Them][ALL_PIECES]);
             score -= make_score(100, 100) * popcount(attackedBy[Us][KING] & pos.pieces());
@@ -988,16 +1074,16 @@ namespace {
         if (kingDanger > 0)
         {
 #ifdef THREECHECK
-            if (pos.is_three_check())
+            if (V == THREECHECK_VARIANT)
                 kingDanger = ThreeCheckKSFactors[pos.checks_given(Them)] * kingDanger / 256;
 #endif
             int v = kingDanger * kingDanger / 4096;
 #ifdef CRAZYHOUSE
-            if (pos.is_house() && v > QueenValueMg)
+            if (V == CRAZYHOUSE_VARIANT && v > QueenValueMg)
                 v = QueenValueMg;
 #endif
 #ifdef THREECHECK
-            if (pos.is_three_check() && v > QueenValueMg)
+            if (V == THREECHECK_VARIANT && v > QueenValueMg)
                 v = QueenValueMg;
 #endif
             score -= make_score(v, kingDanger / 16 + KDP[6] * v / 256);
@@ -1016,7 +1102,7 @@ namespace {
     b =  (Us == WHITE ? b << 4 : b >> 4)
        | (b & attackedBy2[Them] & ~attackedBy[Us][PAWN]);
 
-    score -= CloseEnemies[pos.variant()] * popcount(b);
+    score -= CloseEnemies[V] * popcount(b);
 
     // Penalty when our king is on a pawnless flank
     if (!(pos.pieces(PAWN) & KingFlank[kf]))
@@ -1032,8 +1118,8 @@ namespace {
   // evaluate_threats() assigns bonuses according to the types of the attacking
   // and the attacked pieces.
 
-  template<Tracing T>  template<Color Us>
-  Score Evaluation<T>::evaluate_threats() {
+  template<Variant V, Tracing T>  template<Color Us>
+  Score Evaluation<V, T>::evaluate_threats() {
 
     const Color Them        = (Us == WHITE ? BLACK      : WHITE);
     const Square Up         = (Us == WHITE ? NORTH      : SOUTH);
@@ -1044,7 +1130,7 @@ namespace {
     Bitboard b, weak, defended, stronglyProtected, safeThreats;
     Score score = SCORE_ZERO;
 #ifdef ANTI
-    if (pos.is_anti())
+    if (V == ANTI_VARIANT)
     {
         const Bitboard TRank2BB = (Us == WHITE ? Rank2BB    : Rank7BB);
         bool weCapture = attackedBy[Us][ALL_PIECES] & pos.pieces(Them);
@@ -1085,13 +1171,13 @@ namespace {
     else
 #endif
 #ifdef ATOMIC
-    if (pos.is_atomic())
+    if (V == ATOMIC_VARIANT)
     {
     }
     else
 #endif
 #ifdef LOSERS
-    if (pos.is_losers())
+    if (V == LOSERS_VARIANT)
     {
         const Bitboard TRank2BB = (Us == WHITE ? Rank2BB    : Rank7BB);
         bool weCapture = attackedBy[Us][ALL_PIECES] & pos.pieces(Them);
@@ -1208,11 +1294,11 @@ namespace {
     score += ThreatByPawnPush * popcount(b);
 
 #ifdef THREECHECK
-    if (pos.is_three_check())
+    if (V == THREECHECK_VARIANT)
         score += ChecksGivenBonus[pos.checks_given(Us)];
 #endif
 #ifdef HORDE
-    if (pos.is_horde() && pos.is_horde_color(Them))
+    if (V == HORDE_VARIANT && pos.is_horde_color(Them))
     {
         // Add a bonus according to how close we are to breaking through the pawn wall
         if (pos.pieces(Us, ROOK) | pos.pieces(Us, QUEEN))
@@ -1245,8 +1331,8 @@ namespace {
   // evaluate_passed_pawns() evaluates the passed pawns and candidate passed
   // pawns of the given color.
 
-  template<Tracing T>  template<Color Us>
-  Score Evaluation<T>::evaluate_passed_pawns() {
+  template<Variant V, Tracing T>  template<Color Us>
+  Score Evaluation<V, T>::evaluate_passed_pawns() {
 
     const Color Them = (Us == WHITE ? BLACK : WHITE);
     const Square Up  = (Us == WHITE ? NORTH : SOUTH);
@@ -1255,7 +1341,7 @@ namespace {
     Score score = SCORE_ZERO;
 
 #ifdef RACE
-    if (pos.is_race())
+    if (V == RACE_VARIANT)
     {
         Square ksq = pos.square<KING>(Us);
         int s = relative_rank(BLACK, ksq);
@@ -1270,7 +1356,7 @@ namespace {
     b = pe->passed_pawns(Us);
 
 #ifdef KOTH
-    if (pos.is_koth())
+    if (V == KOTH_VARIANT)
     {
         Square ksq = pos.square<KING>(Us);
         Square center[4] = {SQ_E4, SQ_D4, SQ_D5, SQ_E5};
@@ -1294,15 +1380,19 @@ namespace {
         score -= HinderPassedPawn * popcount(bb);
 
         int r = relative_rank(Us, s) - RANK_2;
+#ifdef HORDE
+        if (V == HORDE_VARIANT)
+            r = std::max(r, 0); // Horde pawns on the first rank
+#endif
         int rr = r * (r - 1);
 
-        Value mbonus = Passed[pos.variant()][MG][r], ebonus = Passed[pos.variant()][EG][r];
+        Value mbonus = Passed[V][MG][r], ebonus = Passed[V][EG][r];
 
         if (rr)
         {
             Square blockSq = s + Up;
 #ifdef HORDE
-            if (pos.is_horde())
+            if (V == HORDE_VARIANT)
             {
                 // Assume a horde king distance of approximately 5
                 if (pos.is_horde_color(Us))
@@ -1313,10 +1403,10 @@ namespace {
             else
 #endif
 #ifdef ANTI
-            if (pos.is_anti()) {} else
+            if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef ATOMIC
-            if (pos.is_atomic())
+            if (V == ATOMIC_VARIANT)
                 ebonus +=  distance(pos.square<KING>(Them), blockSq) * 5 * rr;
             else
 #endif
@@ -1388,8 +1478,8 @@ namespace {
   // twice. Finally, the space bonus is multiplied by a weight. The aim is to
   // improve play on game opening.
 
-  template<Tracing T>  template<Color Us>
-  Score Evaluation<T>::evaluate_space() {
+  template<Variant V, Tracing T>  template<Color Us>
+  Score Evaluation<V, T>::evaluate_space() {
 
     const Color Them = (Us == WHITE ? BLACK : WHITE);
     const Bitboard SpaceMask =
@@ -1417,7 +1507,7 @@ namespace {
     bonus = popcount((Us == WHITE ? safe << 32 : safe >> 32) | (behind & safe));
     int weight = pos.count<ALL_PIECES>(Us) - 2 * pe->open_files();
 #ifdef KOTH
-    if (pos.is_koth())
+    if (V == KOTH_VARIANT)
         return make_score(bonus * weight * weight / 22, 0)
               + KothSafeCenter * popcount(safe & behind & (Rank4BB | Rank5BB) & (FileDBB | FileEBB));
 #endif
@@ -1430,8 +1520,8 @@ namespace {
   // position, i.e., second order bonus/malus based on the known attacking/defending
   // status of the players.
 
-  template<Tracing T>
-  Score Evaluation<T>::evaluate_initiative(Value eg) {
+  template<Variant V, Tracing T>
+  Score Evaluation<V, T>::evaluate_initiative(Value eg) {
 
     int kingDistance =  distance<File>(pos.square<KING>(WHITE), pos.square<KING>(BLACK))
                       - distance<Rank>(pos.square<KING>(WHITE), pos.square<KING>(BLACK));
@@ -1451,8 +1541,8 @@ namespace {
 
   // evaluate_scale_factor() computes the scale factor for the winning side
 
-  template<Tracing T>
-  ScaleFactor Evaluation<T>::evaluate_scale_factor(Value eg) {
+  template<Variant V, Tracing T>
+  ScaleFactor Evaluation<V, T>::evaluate_scale_factor(Value eg) {
 
     Color strongSide = eg > VALUE_DRAW ? WHITE : BLACK;
     ScaleFactor sf = me->scale_factor(pos, strongSide);
@@ -1460,7 +1550,7 @@ namespace {
     // If we don't already have an unusual scale factor, check for certain
     // types of endgames, and use a lower scale for those.
 #ifdef ATOMIC
-    if (pos.is_atomic()) {} else
+    if (V == ATOMIC_VARIANT) {} else
 #endif
     if (sf == SCALE_FACTOR_NORMAL || sf == SCALE_FACTOR_ONEPAWN)
     {
@@ -1480,11 +1570,12 @@ namespace {
         // pawns are drawish.
         else if (    abs(eg) <= BishopValueEg
                  &&  pos.count<PAWN>(strongSide) <= 2
+                 && !kingless(~strongSide)
                  && !pos.pawn_passed(~strongSide, pos.square<KING>(~strongSide)))
             return ScaleFactor(37 + 7 * pos.count<PAWN>(strongSide));
     }
 #ifdef HORDE
-    if (   pos.is_horde()
+    if (   V == HORDE_VARIANT
         && pos.non_pawn_material(pos.is_horde_color(WHITE) ? WHITE : BLACK) >= QueenValueMg
         && !pos.is_horde_color(strongSide))
         sf = ScaleFactor(10);
@@ -1494,12 +1585,31 @@ namespace {
   }
 
 
+  // kingless() tells whether a color has no king to evaluate: the horde, or a
+  // side which has lost all its kings in antichess. Its king square is SQ_NONE
+  // then, which must not index the tables.
+
+  template<Variant V, Tracing T>
+  bool Evaluation<V, T>::kingless(Color c) const {
+
+#ifdef ANTI
+    if (V == ANTI_VARIANT)
+        return !pos.pieces(c, KING);
+#endif
+#ifdef HORDE
+    if (V == HORDE_VARIANT)
+        return pos.is_horde_color(c);
+#endif
+    return false;
+  }
+
+
   // value() is the main function of the class. It computes the various parts of
   // the evaluation and returns the value of the position from the point of view
   // of the side to move.
 
-  template<Tracing T>
-  Value Evaluation<T>::value() {
+  template<Variant V, Tracing T>
+  Value Evaluation<V, T>::value() {
 
     assert(!pos.checkers());
 
@@ -1525,7 +1635,7 @@ namespace {
 
     // Early exit if score is high
     Value v = (mg_value(score) + eg_value(score)) / 2;
-    if (pos.variant() == CHESS_VARIANT)
+    if (V == CHESS_VARIANT)
     {
     if (abs(v) > LazyThreshold)
        return pos.side_to_move() == WHITE ? v : -v;
@@ -1533,8 +1643,20 @@ namespace {
 
     // Main evaluation begins here
 
+#ifdef USE_WASM_SIMD
+#ifdef ANTI
+    if (V == ANTI_VARIANT)
+    {
+        initialize<WHITE>();
+        initialize<BLACK>();
+    }
+    else
+#endif
+    initialize_pair();
+#else
     initialize<WHITE>();
     initialize<BLACK>();
+#endif
 
     score += evaluate_pieces<WHITE, KNIGHT>() - evaluate_pieces<BLACK, KNIGHT>();
     score += evaluate_pieces<WHITE, BISHOP>() - evaluate_pieces<BLACK, BISHOP>();
@@ -1544,10 +1666,10 @@ namespace {
     score += mobility[WHITE] - mobility[BLACK];
 
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef RACE
-    if (pos.is_race()) {} else
+    if (V == RACE_VARIANT) {} else
 #endif
     score +=  evaluate_king<WHITE>()
             - evaluate_king<BLACK>();
@@ -1559,17 +1681,17 @@ namespace {
             - evaluate_passed_pawns<BLACK>();
 
 #ifdef HORDE
-    if (pos.is_horde()) {} else
+    if (V == HORDE_VARIANT) {} else
 #endif
-    if (pos.non_pawn_material() >= SpaceThreshold[pos.variant()])
+    if (pos.non_pawn_material() >= SpaceThreshold[V])
         score +=  evaluate_space<WHITE>()
                 - evaluate_space<BLACK>();
 
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef HORDE
-    if (pos.is_horde()) {} else
+    if (V == HORDE_VARIANT) {} else
 #endif
     score += evaluate_initiative(eg_value(score));
 
@@ -1587,13 +1709,54 @@ namespace {
         Trace::add(IMBALANCE, me->imbalance());
         Trace::add(PAWN, pe->pawns_score());
         Trace::add(MOBILITY, mobility[WHITE], mobility[BLACK]);
-        if (pos.non_pawn_material() >= SpaceThreshold[pos.variant()])
+        if (pos.non_pawn_material() >= SpaceThreshold[V])
             Trace::add(SPACE, evaluate_space<WHITE>()
                             , evaluate_space<BLACK>());
         Trace::add(TOTAL, score);
     }
 
-    return (pos.side_to_move() == WHITE ? v : -v) + Eval::Tempo[pos.variant()]; // Side to move point of view
+    return (pos.side_to_move() == WHITE ? v : -v) + Eval::Tempo[V]; // Side to move point of view
+  }
+
+  // evaluate_position() runs the evaluation instantiated for the variant of the
+  // position.
+
+  template<Tracing T>
+  struct Evaluator {
+    template<Variant V> struct For {
+      static Value call(const Position& pos) { return Evaluation<V, T>(pos).value(); }
+    };
+  };
+
+  template<Tracing T>
+  Value evaluate_position(const Position& pos) {
+    return dispatch<Evaluator<T>::template For>(pos.variant(), pos);
+  }
+
+  // probe() looks up the evaluation of the position in the eval hash table of
+  // the thread, if it has one. On a miss it is computed by 'eval' and stored.
+  template<typename F>
+  Value probe(const Position& pos, F eval) {
+
+    Thread* th = pos.this_thread();
+
+    if (!th->evalTable.size())
+        return eval(pos);
+
+    Eval::Entry* e = th->evalTable[pos.key()];
+
+    if (e->key32 == uint32_t(pos.key() >> 32))
+    {
+        STATS(th->evalTable.hits++);
+        STATS(th->stats.evalHits[pos.variant()]++);
+        return Value(e->value);
+    }
+
+    STATS(th->evalTable.misses++);
+    STATS(th->stats.evalMisses[pos.variant()]++);
+    e->key32 = uint32_t(pos.key() >> 32);
+    e->value = eval(pos);
+    return Value(e->value);
   }
 
 } // namespace
@@ -1604,9 +1767,48 @@ namespace {
 
 Value Eval::evaluate(const Position& pos)
 {
-   return Evaluation<>(pos).value();
+   return probe(pos, evaluate_position<NO_TRACE>);
 }
 
+/// evaluate<Variant>() evaluates a position of the given variant, for a caller
+/// which already knows the variant at compile time, like the search.
+
+template<Variant V>
+Value Eval::evaluate(const Position& pos)
+{
+   return probe(pos, [](const Position& p) { return Evaluation<V>(p).value(); });
+}
+
+// Explicit template instantiations
+template Value Eval::evaluate<CHESS_VARIANT>(const Position&);
+#ifdef ANTI
+template Value Eval::evaluate<ANTI_VARIANT>(const Position&);
+#endif
+#ifdef ATOMIC
+template Value Eval::evaluate<ATOMIC_VARIANT>(const Position&);
+#endif
+#ifdef CRAZYHOUSE
+template Value Eval::evaluate<CRAZYHOUSE_VARIANT>(const Position&);
+#endif
+#ifdef HORDE
+template Value Eval::evaluate<HORDE_VARIANT>(const Position&);
+#endif
+#ifdef KOTH
+template Value Eval::evaluate<KOTH_VARIANT>(const Position&);
+#endif
+#ifdef LOSERS
+template Value Eval::evaluate<LOSERS_VARIANT>(const Position&);
+#endif
+#ifdef RACE
+template Value Eval::evaluate<RACE_VARIANT>(const Position&);
+#endif
+#ifdef RELAY
+template Value Eval::evaluate<RELAY_VARIANT>(const Position&);
+#endif
+#ifdef THREECHECK
+template Value Eval::evaluate<THREECHECK_VARIANT>(const Position&);
+#endif
+
 /// trace() is like evaluate(), but instead of returning a value, it returns
 /// a string (suitable for outputting to stdout) that contains the detailed
 /// descriptions and values of each evaluation term. Useful for debugging.
@@ -1615,7 +1817,7 @@ std::string Eval::trace(const Position& pos) {
 
   std::memset(scores, 0, sizeof(scores));
 
-  Value v = Evaluation<TRACE>(pos).value();
+  Value v = evaluate_position<TRACE>(pos);
   v = pos.side_to_move() == WHITE ? v : -v; // White's point of view
 
   std::stringstream ss;
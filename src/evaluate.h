@@ -23,6 +23,7 @@
 
 #include <string>
 
+#include "misc.h"
 #include "types.h"
 
 class Position;
@@ -60,9 +61,20 @@ const Value Tempo[VARIANT_NB] = { // Must be visible to search
 #endif
 };
 
+/// Eval::Entry holds the evaluation of a position, verified by the high 32 bits
+/// of its key. Each thread may have a table of them, probed before evaluating.
+
+struct Entry {
+  uint32_t key32;
+  int32_t value;
+};
+
+typedef HashTable<Entry> Table;
+
 std::string trace(const Position& pos);
 
 Value evaluate(const Position& pos);
+template<Variant V> Value evaluate(const Position& pos);
 }
 
 #endif // #ifndef EVALUATE_H_INCLUDED
@@ -21,41 +21,45 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "engine.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
 #include "syzygy/tbprobe.h"
 #endif
 
 namespace PSQT {
-  void init();
+  void init(Variant var);
 }
 
 int main(int argc, char* argv[]) {
 
   std::cout << engine_info() << std::endl;
 
-  UCI::init(Options);
-  PSQT::init();
+  PSQT::init(CHESS_VARIANT); // Other variants when selected
   Bitboards::init();
   Position::init();
   Bitbases::init();
   Search::init();
   Pawns::init();
-#ifndef __EMSCRIPTEN__
+
+  // Tables above are shared, the default engine is the one of UCI::loop()
+  CurrentEngine = new Engine();
+
+#ifndef NO_SYZYGY
   Tablebases::init(Options["SyzygyPath"], CHESS_VARIANT);
+#ifdef __EMSCRIPTEN__
+  Tablebases::resize_cache(Options["SyzygyCache"]);
+#endif
 #endif
-  TT.resize(Options["Hash"]);
-  Threads.init(Options["Threads"]);
-  Search::clear(); // After threads are up
 
 #ifndef __EMSCRIPTEN__
   UCI::loop(argc, argv);
 
-  Threads.exit();
+  delete CurrentEngine;
 #endif
   return 0;
 }
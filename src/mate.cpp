@@ -0,0 +1,243 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <climits>
+
+#include "engine.h"
+#include "mate.h"
+#include "movegen.h"
+#include "thread.h"
+
+using namespace Mate;
+
+namespace {
+
+  const uint32_t Infinite = 1 << 30; // Proof and disproof numbers are capped to it
+
+  // Node holds the proof and disproof numbers of a position, and once it is
+  // proven the number of plies the win takes. A disproof may rest on a
+  // repetition of a position earlier in the path, then it holds only for that
+  // path and is not stored (the graph history interaction problem).
+  struct Node {
+    uint32_t pn, dn;
+    int length;
+    bool onPath;
+  };
+
+  const Node Unknown    = { 1, 1, 0, false };
+  const Node Proven     = { 0, Infinite, 0, false };
+  const Node Disproven  = { Infinite, 0, 0, false };
+  const Node Repetition = { Infinite, 0, 0, true };
+
+  uint32_t add(uint32_t a, uint32_t b) { return std::min(a + b, Infinite); }
+
+  // lookup() returns the node of a position with 'depth' plies left, unknown
+  // unless the table has an entry for it which holds at that depth.
+  Node lookup(Table& table, Key key, int depth) {
+
+    const Entry* e = table[key];
+
+    if (e->key32 != uint32_t(key >> 32) || !(e->pn | e->dn)) // Or never stored
+        return Unknown;
+
+    if (!e->pn)
+        return e->depth <= depth ? Node{ 0, Infinite, e->depth, false } : Unknown;
+
+    if (!e->dn)
+        return e->depth >= depth ? Disproven : Unknown;
+
+    return e->depth == depth ? Node{ e->pn, e->dn, 0, false } : Unknown;
+  }
+
+  void store(Table& table, Key key, int depth, const Node& n) {
+
+    Entry* e = table[key];
+    e->key32 = uint32_t(key >> 32);
+    e->pn = n.pn;
+    e->dn = n.dn;
+    e->depth = uint16_t(n.pn ? depth : n.length);
+  }
+
+  // mid() is the depth-first proof-number search (df-pn, Nagai 2002) of a node
+  // with 'depth' plies left to win in. The attacker is to move at even plies,
+  // and needs one child proven, the defender all of them. The most proving
+  // child is searched until its numbers pass the thresholds given by its
+  // siblings, until the node's own numbers reach 'thPn' or 'thDn'.
+
+  Node mid(Table& table, Position& pos, int depth, int ply, uint32_t thPn, uint32_t thDn) {
+
+    bool attacker = !(ply & 1);
+    Value v = VALUE_NONE;
+    std::vector<Move> moves;
+
+    Threads.main()->check_time();
+
+    if (pos.is_variant_end())
+        v = pos.variant_result();
+
+    else if (ply && pos.is_draw(ply))
+        return Repetition; // Not stored, as it depends on the path
+
+    else
+        for (const auto& m : MoveList<LEGAL>(pos))
+            moves.push_back(m);
+
+    if (v == VALUE_NONE && moves.empty())
+        v = pos.checkers() ? pos.checkmate_value() : pos.stalemate_value();
+
+    if (v != VALUE_NONE || !depth)
+    {
+        Node n = v != VALUE_NONE && (attacker ? v > VALUE_DRAW : v < VALUE_DRAW) ? Proven : Disproven;
+        store(table, pos.key(), depth, n);
+        return n;
+    }
+
+    // The numbers of the children are kept here rather than looked up again, so
+    // that the search goes on when their entries are replaced.
+    StateInfo st;
+    std::vector<Node> children;
+
+    for (Move m : moves)
+    {
+        pos.do_move(m, st);
+        children.push_back(lookup(table, pos.key(), depth - 1));
+        pos.undo_move(m);
+    }
+
+    Node n;
+
+    while (true)
+    {
+        size_t best = 0;
+        uint32_t bestPhi = Infinite + 1, secondPhi = Infinite;
+        int length = attacker ? INT_MAX : 0;
+        bool onPath = false, offPath = false; // Disproven children of each kind
+
+        n = attacker ? Node{ Infinite, 0, 0, false } : Node{ 0, Infinite, 0, false };
+
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            const Node& c = children[i];
+            uint32_t phi = attacker ? c.pn : c.dn; // Which the side to move lowers
+
+            if (attacker)
+                n.pn = std::min(n.pn, c.pn), n.dn = add(n.dn, c.dn);
+            else
+                n.dn = std::min(n.dn, c.dn), n.pn = add(n.pn, c.pn);
+
+            if (!c.pn)
+                length = attacker ? std::min(length, c.length) : std::max(length, c.length);
+
+            onPath  |= !c.dn &&  c.onPath;
+            offPath |= !c.dn && !c.onPath;
+
+            if (phi < bestPhi)
+                secondPhi = bestPhi, bestPhi = phi, best = i;
+            else if (phi < secondPhi)
+                secondPhi = phi;
+        }
+
+        if (!n.pn)
+            n.length = length + 1;
+
+        // The attacker fails only by all the moves, the defender escapes by any
+        if (!n.dn)
+            n.onPath = attacker ? onPath : !offPath;
+
+        if (n.pn >= thPn || n.dn >= thDn || Threads.stop)
+            break;
+
+        const Node& c = children[best];
+        uint32_t pnLimit = attacker ? std::min(thPn, secondPhi + 1)
+                                    : uint32_t(std::min(uint64_t(thPn) - n.pn + c.pn, uint64_t(Infinite)));
+        uint32_t dnLimit = attacker ? uint32_t(std::min(uint64_t(thDn) - n.dn + c.dn, uint64_t(Infinite)))
+                                    : std::min(thDn, secondPhi + 1);
+
+        pos.do_move(moves[best], st);
+        children[best] = mid(table, pos, depth - 1, ply + 1, pnLimit, dnLimit);
+        pos.undo_move(moves[best]);
+    }
+
+    if (!n.onPath)
+        store(table, pos.key(), depth, n);
+
+    return n;
+  }
+
+  // extract_pv() follows a proven node down to the end of the win: the attacker
+  // plays the quickest win, the defender the longest resistance.
+
+  void extract_pv(Table& table, Position& pos, int depth, int ply, std::vector<Move>& pv) {
+
+    if (!depth || pos.is_variant_end())
+        return;
+
+    bool attacker = !(ply & 1);
+    Move best = MOVE_NONE;
+    int bestLength = attacker ? INT_MAX : -1;
+    StateInfo st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        Node c = lookup(table, pos.key(), depth - 1);
+        pos.undo_move(m);
+
+        if (!c.pn && (attacker ? c.length < bestLength : c.length > bestLength))
+            best = m, bestLength = c.length;
+    }
+
+    if (!best) // The position is the end of the win, or its entries were replaced
+        return;
+
+    pv.push_back(best);
+    pos.do_move(best, st);
+    extract_pv(table, pos, bestLength, ply + 1, pv);
+    pos.undo_move(best);
+  }
+
+} // namespace
+
+
+/// Mate::solve() looks for a forced win of the side to move in at most 'plies'
+/// plies, which in the variants may be other than a checkmate, e.g. an
+/// explosion of the king in atomic or losing all pieces in antichess. Draws,
+/// repetitions included, count as failures, so a disproof only means there is
+/// no win avoiding the positions of the game and of the line searched. The
+/// search runs in the calling thread, which must be the main thread, until it
+/// is decided or stopped.
+
+Result Mate::solve(Position& pos, int plies, Table& table) {
+
+  Result r = {};
+  Node n = Unknown;
+
+  while (n.pn && n.dn && !Threads.stop)
+      n = mid(table, pos, plies, 0, Infinite, Infinite);
+
+  r.proven = !n.pn;
+  r.disproven = !n.dn;
+
+  if (r.proven)
+      extract_pv(table, pos, n.length, 0, r.pv);
+
+  return r;
+}
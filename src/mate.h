@@ -0,0 +1,55 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATE_H_INCLUDED
+#define MATE_H_INCLUDED
+
+#include <vector>
+
+#include "misc.h"
+#include "position.h"
+#include "types.h"
+
+namespace Mate {
+
+/// Entry is a node of the depth-first proof-number search, in 16 bytes. The
+/// proof and disproof numbers hold for 'depth' plies left to win in. Once the
+/// node is proven, 'depth' is the number of plies the win takes instead, as it
+/// is proven for any depth at least as big.
+struct Entry {
+  uint32_t key32;
+  uint32_t pn, dn;
+  uint16_t depth;
+};
+
+typedef HashTable<Entry> Table;
+
+/// Result of solve(): either proven, with the moves of the win in 'pv', or
+/// disproven if there is no win in the given plies. Neither if it was stopped.
+struct Result {
+  bool proven, disproven;
+  std::vector<Move> pv;
+};
+
+Result solve(Position& pos, int plies, Table& table);
+
+} // namespace Mate
+
+#endif // #ifndef MATE_H_INCLUDED
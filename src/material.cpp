@@ -424,11 +424,16 @@ namespace Material {
 Entry* probe(const Position& pos) {
 
   Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+  Table& table = pos.this_thread()->materialTable;
+  Entry* e = table[key];
 
   if (e->key == key)
+  {
+      STATS(table.hits++);
       return e;
+  }
 
+  STATS(table.misses++);
   std::memset(e, 0, sizeof(Entry));
   e->key = key;
   e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
@@ -451,7 +456,7 @@ Entry* probe(const Position& pos) {
   // Let's look if we have a specialized evaluation function for this particular
   // material configuration. Firstly we look for a fixed configuration one, then
   // for a generic one if the previous search failed.
-  if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(key)) != nullptr)
+  if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(pos.variant(), key)) != nullptr)
       return e;
 
   if (pos.variant() == CHESS_VARIANT)
@@ -479,7 +484,7 @@ Entry* probe(const Position& pos) {
   // configuration. Is there a suitable specialized scaling function?
   EndgameBase<ScaleFactor>* sf;
 
-  if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(key)) != nullptr)
+  if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(pos.variant(), key)) != nullptr)
   {
       e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
       return e;
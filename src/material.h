@@ -64,7 +64,8 @@ struct Entry {
   Phase gamePhase;
 };
 
-typedef HashTable<Entry, 8192> Table;
+typedef HashTable<Entry> Table;
+const size_t TableSize = 8192; // Default number of entries
 
 Entry* probe(const Position& pos);
 
@@ -36,12 +36,17 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
+#include "engine.h"
 #include "misc.h"
 #include "thread.h"
 
@@ -211,6 +216,40 @@ void prefetch2(void* addr) {
   prefetch((uint8_t*)addr + 64);
 }
 
+#ifdef NO_THREADS
+
+namespace {
+
+  typedef void (*Task)(void*);
+
+  double scheduledTime, waitTime;
+}
+
+/// schedule() hands the task over to Module.schedule() of the JavaScript glue.
+/// Unlike emscripten_async_call(), which is based on setTimeout() and clamped
+/// to several milliseconds by browsers, it posts a message on a MessageChannel.
+
+void schedule(Task func, void* arg) {
+
+  scheduledTime = emscripten_get_now();
+  EM_ASM_({ Module['schedule']($0, $1); }, (int)(intptr_t)func, (int)(intptr_t)arg);
+}
+
+extern "C" void run_scheduled(Task func, void* arg) {
+
+  waitTime += emscripten_get_now() - scheduledTime;
+  func(arg);
+}
+
+double scheduler_wait() {
+
+  double w = waitTime;
+  waitTime = 0;
+  return w;
+}
+
+#endif
+
 namespace WinProcGroup {
 
 #ifndef _WIN32
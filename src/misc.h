@@ -39,6 +39,14 @@ void dbg_hit_on(bool c, bool b);
 void dbg_mean_of(int v);
 void dbg_print();
 
+/// STATS() keeps a statement counting something in a hot path only in builds
+/// with stats=yes, see Search::Stats.
+#ifdef USE_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
 typedef std::chrono::milliseconds::rep TimePoint; // A value in milliseconds
 
 inline TimePoint now() {
@@ -50,19 +58,44 @@ inline TimePoint now() {
 #endif
 }
 
-template<class Entry, int Size>
+#ifdef NO_THREADS
+/// schedule() runs func(arg) from the event loop of the web worker, right
+/// after the messages that are already pending. scheduler_wait() returns the
+/// milliseconds spent between scheduling and running since its last call.
+void schedule(void (*func)(void*), void* arg);
+double scheduler_wait();
+#endif
+
+/// HashTable is a table of entries indexed by the low bits of the key, with a
+/// power of 2 number of entries set at runtime. With stats=yes the probes also
+/// count their hits and misses.
+
+template<class Entry>
 struct HashTable {
-  Entry* operator[](Key key) { return &table[(uint32_t)key & (Size - 1)]; }
+  Entry* operator[](Key key) { return &table[(uint32_t)key & mask]; }
+
+  void resize(size_t size) {
+    if (size != table.size())
+        table = std::vector<Entry>(size), mask = size - 1;
+  }
+  size_t size() const { return table.size(); }
+  size_t bytes() const { return table.size() * sizeof(Entry); }
+
+#ifdef USE_STATS
+  uint64_t hits = 0, misses = 0;
+#endif
 
 private:
-  std::vector<Entry> table = std::vector<Entry>(Size);
+  std::vector<Entry> table;
+  size_t mask = 0;
 };
 
 
 enum SyncCout { IO_LOCK, IO_UNLOCK };
 std::ostream& operator<<(std::ostream&, SyncCout);
+std::ostream& engine_out(); // Output of the engine of the calling thread
 
-#define sync_cout std::cout << IO_LOCK
+#define sync_cout engine_out() << IO_LOCK
 #define sync_endl std::endl << IO_UNLOCK
 
 
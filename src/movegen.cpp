@@ -63,7 +63,7 @@ namespace {
         }
         else
 #endif
-        if (pos.attackers_to(s) & enemies)
+        if (pos.attacked_by(~us, s))
             return moveList;
 
     // Because we generate only legal castling moves we need to verify that
@@ -369,7 +369,7 @@ namespace {
     moveList = generate_moves<V,   ROOK, Checks>(pos, moveList, Us, target);
     moveList = generate_moves<V,  QUEEN, Checks>(pos, moveList, Us, target);
 #ifdef CRAZYHOUSE
-    if (V == CRAZYHOUSE_VARIANT && Type != CAPTURES && pos.count_in_hand<ALL_PIECES>(Us))
+    if (V == CRAZYHOUSE_VARIANT && Type != CAPTURES && Type != QUIETS && pos.count_in_hand<ALL_PIECES>(Us))
     {
         Bitboard b = Type == EVASIONS ? target ^ pos.checkers() :
                      Type == NON_EVASIONS ? target ^ pos.pieces(~Us) : target;
@@ -396,6 +396,9 @@ namespace {
             return moveList;
     }
     else
+#endif
+#ifdef HORDE
+    if (V == HORDE_VARIANT && pos.is_horde_color(Us)) {} else // No king
 #endif
     if (Type != QUIET_CHECKS && Type != EVASIONS)
     {
@@ -447,6 +450,20 @@ namespace {
     return moveList;
   }
 
+
+  // GenerateAll<Type>::For<V> calls generate_all() for the side to move, as
+  // called by dispatch() for the variant of the position.
+
+  template<GenType Type>
+  struct GenerateAll {
+    template<Variant V> struct For {
+      static ExtMove* call(const Position& pos, ExtMove* moveList, Bitboard target) {
+        return pos.side_to_move() == WHITE ? generate_all<V, WHITE, Type>(pos, moveList, target)
+                                           : generate_all<V, BLACK, Type>(pos, moveList, target);
+      }
+    };
+  };
+
 } // namespace
 
 
@@ -454,7 +471,7 @@ namespace {
 /// promotions. Returns a pointer to the end of the move list.
 ///
 /// generate<QUIETS> generates all pseudo-legal non-captures and
-/// underpromotions. Returns a pointer to the end of the move list.
+/// underpromotions, but no drops. Returns a pointer to the end of the move list.
 ///
 /// generate<NON_EVASIONS> generates all pseudo-legal captures and
 /// non-captures. Returns a pointer to the end of the move list.
@@ -472,54 +489,19 @@ ExtMove* generate(const Position& pos, ExtMove* moveList) {
                    : Type == NON_EVASIONS ? ~pos.pieces(us) : 0;
 
 #ifdef ANTI
-  if (pos.is_anti())
-  {
-      if (pos.can_capture())
-          target &= pos.pieces(~us);
-      return us == WHITE ? generate_all<ANTI_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<ANTI_VARIANT, BLACK, Type>(pos, moveList, target);
-  }
+  if (pos.is_anti() && pos.can_capture())
+      target &= pos.pieces(~us);
 #endif
 #ifdef ATOMIC
-  if (pos.is_atomic())
-  {
-      if (Type == CAPTURES)
-          target &= ~pos.attacks_from<KING>(pos.square<KING>(us));
-      return us == WHITE ? generate_all<ATOMIC_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<ATOMIC_VARIANT, BLACK, Type>(pos, moveList, target);
-  }
-#endif
-#ifdef CRAZYHOUSE
-  if (pos.is_house())
-      return us == WHITE ? generate_all<CRAZYHOUSE_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<CRAZYHOUSE_VARIANT, BLACK, Type>(pos, moveList, target);
-#endif
-#ifdef HORDE
-  if (pos.is_horde())
-      return us == WHITE ? generate_all<HORDE_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<HORDE_VARIANT, BLACK, Type>(pos, moveList, target);
+  if (pos.is_atomic() && Type == CAPTURES)
+      target &= ~pos.attacks_from<KING>(pos.square<KING>(us));
 #endif
 #ifdef LOSERS
-  if (pos.is_losers())
-  {
-      if (pos.can_capture_losers())
-          target &= pos.pieces(~us);
-      return us == WHITE ? generate_all<LOSERS_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<LOSERS_VARIANT, BLACK, Type>(pos, moveList, target);
-  }
-#endif
-#ifdef RACE
-  if (pos.is_race())
-      return us == WHITE ? generate_all<RACE_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<RACE_VARIANT, BLACK, Type>(pos, moveList, target);
-#endif
-#ifdef RELAY
-  if (pos.is_relay())
-      return us == WHITE ? generate_all<RELAY_VARIANT, WHITE, Type>(pos, moveList, target)
-                         : generate_all<RELAY_VARIANT, BLACK, Type>(pos, moveList, target);
+  if (pos.is_losers() && pos.can_capture_losers())
+      target &= pos.pieces(~us);
 #endif
-  return us == WHITE ? generate_all<CHESS_VARIANT, WHITE, Type>(pos, moveList, target)
-                     : generate_all<CHESS_VARIANT, BLACK, Type>(pos, moveList, target);
+
+  return dispatch<GenerateAll<Type>::template For>(pos.variant(), pos, moveList, target);
 }
 
 // Explicit template instantiations
@@ -528,6 +510,33 @@ template ExtMove* generate<QUIETS>(const Position&, ExtMove*);
 template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 
 
+#ifdef CRAZYHOUSE
+/// generate_drops() generates the drops of a piece type from the hand of the
+/// side to move, when not in check. The MovePicker asks for them one piece type
+/// at a time, after the quiets. Returns a pointer to the end of the move list.
+
+ExtMove* generate_drops(const Position& pos, ExtMove* moveList, PieceType pt) {
+
+  assert(pos.is_house());
+  assert(!pos.checkers());
+
+  Color us = pos.side_to_move();
+
+  if (!pos.count_in_hand(us, pt))
+      return moveList;
+
+  Bitboard b = ~pos.pieces();
+  if (pt == PAWN)
+      b &= ~(Rank1BB | Rank8BB);
+
+  while (b)
+      *moveList++ = make_drop(pop_lsb(&b), make_piece(us, pt));
+
+  return moveList;
+}
+#endif
+
+
 /// generate<QUIET_CHECKS> generates all pseudo-legal non-captures and knight
 /// underpromotions that give check. Returns a pointer to the end of the move list.
 template<>
@@ -540,6 +549,10 @@ ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
   if (pos.is_race())
       return moveList;
 #endif
+#ifdef HORDE
+  if (pos.is_horde() && pos.is_horde_color(~pos.side_to_move())) // No king to check
+      return moveList;
+#endif
 
   assert(!pos.checkers());
 
@@ -563,33 +576,7 @@ ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
          *moveList++ = make_move(from, pop_lsb(&b));
   }
 
-#ifdef ATOMIC
-  if (pos.is_atomic())
-      return us == WHITE ? generate_all<ATOMIC_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                         : generate_all<ATOMIC_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
-#endif
-#ifdef CRAZYHOUSE
-  if (pos.is_house())
-      return us == WHITE ? generate_all<CRAZYHOUSE_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                         : generate_all<CRAZYHOUSE_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
-#endif
-#ifdef HORDE
-  if (pos.is_horde())
-      return us == WHITE ? generate_all<HORDE_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                         : generate_all<HORDE_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
-#endif
-#ifdef LOSERS
-  if (pos.is_losers())
-      return us == WHITE ? generate_all<LOSERS_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                         : generate_all<LOSERS_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
-#endif
-#ifdef RELAY
-  if (pos.is_relay())
-      return us == WHITE ? generate_all<RELAY_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                         : generate_all<RELAY_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
-#endif
-  return us == WHITE ? generate_all<CHESS_VARIANT, WHITE, QUIET_CHECKS>(pos, moveList, ~pos.pieces())
-                     : generate_all<CHESS_VARIANT, BLACK, QUIET_CHECKS>(pos, moveList, ~pos.pieces());
+  return dispatch<GenerateAll<QUIET_CHECKS>::For>(pos.variant(), pos, moveList, ~pos.pieces());
 }
 
 
@@ -671,37 +658,12 @@ ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 #endif
   target = between_bb(checksq, ksq) | checksq;
 
-#ifdef ATOMIC
-  if (pos.is_atomic())
-      return us == WHITE ? generate_all<ATOMIC_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                         : generate_all<ATOMIC_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
-#endif
-#ifdef CRAZYHOUSE
-  if (pos.is_house())
-      return us == WHITE ? generate_all<CRAZYHOUSE_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                         : generate_all<CRAZYHOUSE_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
-#endif
-#ifdef HORDE
-  if (pos.is_horde())
-      return us == WHITE ? generate_all<HORDE_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                         : generate_all<HORDE_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
-#endif
 #ifdef LOSERS
-  if (pos.is_losers())
-  {
-      if (pos.can_capture_losers())
-          target &= pos.pieces(~us);
-      return us == WHITE ? generate_all<LOSERS_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                         : generate_all<LOSERS_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
-  }
-#endif
-#ifdef RELAY
-  if (pos.is_relay())
-      return us == WHITE ? generate_all<RELAY_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                         : generate_all<RELAY_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
+  if (pos.is_losers() && pos.can_capture_losers())
+      target &= pos.pieces(~us);
 #endif
-  return us == WHITE ? generate_all<CHESS_VARIANT, WHITE, EVASIONS>(pos, moveList, target)
-                     : generate_all<CHESS_VARIANT, BLACK, EVASIONS>(pos, moveList, target);
+
+  return dispatch<GenerateAll<EVASIONS>::For>(pos.variant(), pos, moveList, target);
 }
 
 
@@ -54,6 +54,9 @@ inline bool operator<(const ExtMove& f, const ExtMove& s) {
 
 template<GenType>
 ExtMove* generate(const Position& pos, ExtMove* moveList);
+#ifdef CRAZYHOUSE
+ExtMove* generate_drops(const Position& pos, ExtMove* moveList, PieceType pt);
+#endif
 
 /// The MoveList struct is a simple wrapper around generate(). It sometimes comes
 /// in handy to use this class instead of the low level generate() function.
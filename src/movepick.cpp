@@ -25,7 +25,11 @@
 namespace {
 
   enum Stages {
-    MAIN_SEARCH, CAPTURES_INIT, GOOD_CAPTURES, KILLERS, COUNTERMOVE, QUIET_INIT, QUIET, BAD_CAPTURES,
+    MAIN_SEARCH, CAPTURES_INIT, GOOD_CAPTURES, KILLERS, COUNTERMOVE, QUIET_INIT, QUIET,
+#ifdef CRAZYHOUSE
+    DROPS,
+#endif
+    BAD_CAPTURES,
     EVASION, EVASIONS_INIT, ALL_EVASIONS,
     PROBCUT, PROBCUT_INIT, PROBCUT_CAPTURES,
     QSEARCH_WITH_CHECKS, QCAPTURES_1_INIT, QCAPTURES_1, QCHECKS,
@@ -33,6 +37,8 @@ namespace {
     QSEARCH_RECAPTURES, QRECAPTURES
   };
 
+  static_assert(int(QRECAPTURES) < int(MovePicker::StageNb), "Too many stages");
+
   // partial_insertion_sort() sorts moves in descending order up to and including
   // a given limit. The order of moves smaller than the limit is left unspecified.
   void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
@@ -163,7 +169,7 @@ void MovePicker::score() {
           if (pos.is_anti() && pos.attackers_to(to_sq(m), pos.pieces() ^ from_sq(m)) & pos.pieces(~pos.side_to_move()))
           {
               m.value += (1 << 28);
-              if (!(pos.attackers_to(from_sq(m)) & pos.pieces(~pos.side_to_move())))
+              if (!pos.attacked_by(~pos.side_to_move(), from_sq(m)))
                   m.value += (1 << 27);
           }
 #endif
@@ -179,6 +185,34 @@ void MovePicker::score() {
       }
 }
 
+/// stage_name() tells where a move came from, given the stage the MovePicker was
+/// in just after returning it, see stage_of_move(). Once the TT move, a killer or
+/// the countermove is returned, the MovePicker has moved on to the next stage.
+
+const char* MovePicker::stage_name(int s) {
+
+  switch (s) {
+  case CAPTURES_INIT: case EVASIONS_INIT: case PROBCUT_INIT:
+  case QCAPTURES_1_INIT: case QCAPTURES_2_INIT: return "tt move";
+  case GOOD_CAPTURES:    return "good captures";
+  case KILLERS:          return "killer 1";
+  case COUNTERMOVE:      return "killer 2";
+  case QUIET_INIT:       return "countermove";
+  case QUIET:            return "quiets";
+#ifdef CRAZYHOUSE
+  case DROPS:            return "drops";
+#endif
+  case BAD_CAPTURES:     return "bad captures";
+  case ALL_EVASIONS:     return "evasions";
+  case PROBCUT_CAPTURES: return "probcut captures";
+  case QCAPTURES_1: case QCAPTURES_2: return "qsearch captures";
+  case QCHECKS:          return "qsearch checks";
+  case QRECAPTURES:      return "qsearch recaptures";
+  default:               return nullptr;
+  }
+}
+
+
 /// next_move() is the most important method of the MovePicker class. It returns
 /// a new pseudo legal move every time it is called, until there are no more moves
 /// left. It picks the move with the biggest value from a list of generated moves
@@ -268,6 +302,38 @@ Move MovePicker::next_move(bool skipQuiets) {
               return move;
       }
       ++stage;
+#ifdef CRAZYHOUSE
+      dropType = PAWN;
+      endMoves = cur;
+      /* fallthrough */
+
+  case DROPS:
+      // The drops of the next piece type in hand replace those returned
+      while (true)
+      {
+          while (    cur < endMoves
+                 && (!skipQuiets || cur->value >= VALUE_ZERO))
+          {
+              move = *cur++;
+
+              if (   move != ttMove
+                  && move != killers[0]
+                  && move != killers[1]
+                  && move != countermove)
+                  return move;
+          }
+
+          if (!pos.is_house() || dropType > QUEEN)
+              break;
+
+          cur = endBadCaptures;
+          endMoves = generate_drops(pos, cur, dropType);
+          ++dropType;
+          score<QUIETS>();
+          partial_insertion_sort(cur, endMoves, -4000 * depth / ONE_PLY);
+      }
+      ++stage;
+#endif
       cur = moves; // Point to beginning of bad captures
       /* fallthrough */
 
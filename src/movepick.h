@@ -48,9 +48,10 @@ struct StatBoards : public std::array<std::array<T, Size2>, Size1> {
 };
 
 /// ButterflyBoards are 2 tables (one for each color) indexed by the move's from
-/// and to squares, see chessprogramming.wikispaces.com/Butterfly+Boards
+/// and to squares, see chessprogramming.wikispaces.com/Butterfly+Boards. Drops
+/// are indexed by the dropped piece type in place of the from square.
 #ifdef CRAZYHOUSE
-typedef StatBoards<COLOR_NB, int(SQUARE_NB + 1) * int(SQUARE_NB)> ButterflyBoards;
+typedef StatBoards<COLOR_NB, int(SQUARE_NB + PIECE_TYPE_NB) * int(SQUARE_NB)> ButterflyBoards;
 #else
 typedef StatBoards<COLOR_NB, int(SQUARE_NB) * int(SQUARE_NB)> ButterflyBoards;
 #endif
@@ -82,8 +83,32 @@ typedef StatBoards<PIECE_NB, SQUARE_NB, Move> CounterMoveHistory;
 
 /// ContinuationHistory is the history of a given pair of moves, usually the
 /// current one given a previous one. History table is based on PieceToBoards
-/// instead of ButterflyBoards.
-typedef StatBoards<PIECE_NB, SQUARE_NB, PieceToHistory> ContinuationHistory;
+/// instead of ButterflyBoards. At 2 MB it is by far the biggest table of a
+/// thread, so clear() only starts a new epoch, and each PieceToHistory is
+/// zeroed when at() first returns it in that epoch.
+class ContinuationHistory {
+
+  typedef StatBoards<PIECE_NB, SQUARE_NB, PieceToHistory> Boards;
+
+public:
+  ContinuationHistory() { epoch.fill(0); }
+
+  void clear() { if (++current == 0) epoch.fill(0), current = 1; }
+
+  PieceToHistory* at(Piece pc, Square to) {
+    if (epoch[pc][to] != current)
+    {
+        boards[pc][to].fill(0);
+        epoch[pc][to] = current;
+    }
+    return &boards[pc][to];
+  }
+
+private:
+  Boards boards;
+  StatBoards<PIECE_NB, SQUARE_NB, uint32_t> epoch;
+  uint32_t current = 0;
+};
 
 
 /// MovePicker class is used to pick one pseudo legal move at a time from the
@@ -102,6 +127,11 @@ public:
   MovePicker(const Position&, Move, Depth, const ButterflyHistory*, const PieceToHistory**, Move, Move*);
   Move next_move(bool skipQuiets = false);
 
+  // Stage of the last move returned, for the statistics of the search
+  enum { StageNb = 32 };
+  int stage_of_move() const { return stage; }
+  static const char* stage_name(int s);
+
 private:
   template<GenType> void score();
   ExtMove* begin() { return cur; }
@@ -116,7 +146,14 @@ private:
   Square recaptureSquare;
   Value threshold;
   Depth depth;
+#ifdef CRAZYHOUSE
+  // Drops are generated one piece type at a time in the space of the quiets,
+  // after those have been returned, so up to SQUARE_NB of them are stored.
+  PieceType dropType;
+  ExtMove moves[256 + SQUARE_NB];
+#else
   ExtMove moves[MAX_MOVES];
+#endif
 };
 
 #endif // #ifndef MOVEPICK_H_INCLUDED
@@ -479,15 +479,17 @@ namespace {
         stoppers   = theirPawns & passed_pawn_mask(Us, s);
         lever      = theirPawns & PawnAttacks[Us][s];
         leverPush  = theirPawns & PawnAttacks[Us][s + Up];
-        doubled    = ourPawns   & (s - Up);
         neighbours = ourPawns   & adjacent_files_bb(f);
         phalanx    = neighbours & rank_bb(s);
 #ifdef HORDE
         if (pos.is_horde() && relative_rank(Us, s) == RANK_1)
-            supported = 0;
+            doubled = supported = 0; // No square behind the pawn
         else
 #endif
-        supported  = neighbours & rank_bb(s - Up);
+        {
+            doubled    = ourPawns   & (s - Up);
+            supported  = neighbours & rank_bb(s - Up);
+        }
 
         // A pawn is backward when it is behind all pawns of the same color on the
         // adjacent files and cannot be safely advanced.
@@ -615,11 +617,16 @@ void init() {
 Entry* probe(const Position& pos) {
 
   Key key = pos.pawn_key();
-  Entry* e = pos.this_thread()->pawnsTable[key];
+  Table& table = pos.this_thread()->pawnsTable;
+  Entry* e = table[key];
 
   if (e->key == key)
+  {
+      STATS(table.hits++);
       return e;
+  }
 
+  STATS(table.misses++);
   e->key = key;
   e->score = evaluate<WHITE>(pos, e) - evaluate<BLACK>(pos, e);
   e->asymmetry = popcount(e->semiopenFiles[WHITE] ^ e->semiopenFiles[BLACK]);
@@ -80,7 +80,8 @@ struct Entry {
   int openFiles;
 };
 
-typedef HashTable<Entry, 16384> Table;
+typedef HashTable<Entry> Table;
+const size_t TableSize = 16384; // Default number of entries
 
 void init();
 Entry* probe(const Position& pos);
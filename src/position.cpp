@@ -26,6 +26,7 @@
 #include <sstream>
 
 #include "bitboard.h"
+#include "engine.h"
 #include "misc.h"
 #include "movegen.h"
 #include "position.h"
@@ -97,6 +98,29 @@ PieceType min_attacker<KING>(const Bitboard*, Square, Bitboard, Bitboard&, Bitbo
   return KING; // No need to update bitboards: it is the last cycle
 }
 
+// The members instantiated per variant, as called by dispatch() from the
+// versions without a template argument.
+
+template<Variant V> struct Legal {
+  static bool call(const Position& pos, Move m) { return pos.legal<V>(m); }
+};
+
+template<Variant V> struct GivesCheck {
+  static bool call(const Position& pos, Move m) { return pos.gives_check<V>(m); }
+};
+
+template<Variant V> struct DoMove {
+  static void call(Position& pos, Move m, StateInfo& newSt, bool givesCheck) { pos.do_move<V>(m, newSt, givesCheck); }
+};
+
+template<Variant V> struct UndoMove {
+  static void call(Position& pos, Move m) { pos.undo_move<V>(m); }
+};
+
+template<Variant V> struct SeeGe {
+  static bool call(const Position& pos, Move m, Value threshold) { return pos.see_ge<V>(m, threshold); }
+};
+
 } // namespace
 
 
@@ -122,7 +146,7 @@ std::ostream& operator<<(std::ostream& os, const Position& pos) {
       os << UCI::square(pop_lsb(&b)) << " ";
 
 #ifndef __EMSCRIPTEN__
-  if (    int(Tablebases::MaxCardinality) >= popcount(pos.pieces())
+  if (    Tablebases::max_cardinality() >= popcount(pos.pieces())
       && !pos.can_castle(ANY_CASTLING))
   {
       StateInfo st;
@@ -511,6 +535,14 @@ void Position::set_state(StateInfo* si) const {
   si->nonPawnMaterial[WHITE] = si->nonPawnMaterial[BLACK] = VALUE_ZERO;
   si->psq = SCORE_ZERO;
   set_check_info(si);
+#ifdef INCREMENTAL_ATTACKS
+  for (Color c = WHITE; c <= BLACK; ++c)
+  {
+      si->attacks[c][ALL_PIECES] = 0;
+      for (PieceType pt = PAWN; pt <= KING; ++pt)
+          si->attacks[c][ALL_PIECES] |= si->attacks[c][pt] = attacks_of(c, pt);
+  }
+#endif
 #ifdef HORDE
   if (is_horde() && is_horde_color(sideToMove))
       si->checkersBB = 0;
@@ -574,6 +606,7 @@ void Position::set_state(StateInfo* si) const {
           if (type_of(pc) != PAWN && type_of(pc) != KING)
               si->nonPawnMaterial[color_of(pc)] += pieceCountInHand[color_of(pc)][type_of(pc)] * PieceValue[CHESS_VARIANT][MG][pc];
           si->key ^= Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)]];
+          si->materialKey ^= Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)]];
       }
 #endif
   }
@@ -734,6 +767,7 @@ Bitboard Position::attackers_to(Square s, Bitboard occupied) const {
 
 /// Position::legal() tests whether a pseudo-legal move is legal
 
+template<Variant V>
 bool Position::legal(Move m) const {
 
   assert(is_ok(m));
@@ -745,28 +779,28 @@ bool Position::legal(Move m) const {
 #ifdef ANTI
   // If a player can capture, that player must capture
   // Is handled by move generator
-  assert(!is_anti() || capture(m) == can_capture());
-  if (is_anti())
+  assert(V != ANTI_VARIANT || capture(m) == can_capture());
+  if (V == ANTI_VARIANT)
       return true;
 #endif
 #ifdef HORDE
-  assert((is_horde() && is_horde_color(us)) || piece_on(square<KING>(us)) == make_piece(us, KING));
+  assert((V == HORDE_VARIANT && is_horde_color(us)) || piece_on(square<KING>(us)) == make_piece(us, KING));
 #else
   assert(piece_on(square<KING>(us)) == make_piece(us, KING));
 #endif
 
 #ifdef RACE
   // Checking moves are illegal
-  if (is_race() && gives_check(m))
+  if (V == RACE_VARIANT && gives_check<V>(m))
       return false;
 #endif
 #ifdef HORDE
   // All pseudo-legal moves by the horde are legal
-  if (is_horde() && is_horde_color(us))
+  if (V == HORDE_VARIANT && is_horde_color(us))
       return true;
 #endif
 #ifdef ATOMIC
-  if (is_atomic())
+  if (V == ATOMIC_VARIANT)
   {
       Square ksq = square<KING>(us);
       Square to = to_sq(m);
@@ -816,12 +850,12 @@ bool Position::legal(Move m) const {
   }
 
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP)
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
       return pieceCountInHand[us][type_of(moved_piece(m))] && empty(to_sq(m));
 #endif
 
 #ifdef ATOMIC
-  if (is_atomic() && type_of(piece_on(from)) == KING && type_of(m) != CASTLING)
+  if (V == ATOMIC_VARIANT && type_of(piece_on(from)) == KING && type_of(m) != CASTLING)
   {
       Square ksq = square<KING>(~us);
       Square to = to_sq(m);
@@ -840,7 +874,7 @@ bool Position::legal(Move m) const {
   // square is attacked by the opponent. Castling moves are checked
   // for legality during move generation.
   if (type_of(piece_on(from)) == KING)
-      return type_of(m) == CASTLING || !(attackers_to(to_sq(m)) & pieces(~us));
+      return type_of(m) == CASTLING || !attacked_by(~us, to_sq(m));
 
   // A non-king move is legal if and only if it is not pinned or it
   // is moving along the ray towards or away from the king.
@@ -849,6 +883,43 @@ bool Position::legal(Move m) const {
 }
 
 
+/// The versions of legal(), gives_check() and see_ge() without a template
+/// argument call the ones for the variant of the position.
+
+bool Position::legal(Move m) const {
+  return dispatch<Legal>(var, *this, m);
+}
+
+template bool Position::legal<CHESS_VARIANT>(Move) const;
+#ifdef ANTI
+template bool Position::legal<ANTI_VARIANT>(Move) const;
+#endif
+#ifdef ATOMIC
+template bool Position::legal<ATOMIC_VARIANT>(Move) const;
+#endif
+#ifdef CRAZYHOUSE
+template bool Position::legal<CRAZYHOUSE_VARIANT>(Move) const;
+#endif
+#ifdef HORDE
+template bool Position::legal<HORDE_VARIANT>(Move) const;
+#endif
+#ifdef KOTH
+template bool Position::legal<KOTH_VARIANT>(Move) const;
+#endif
+#ifdef LOSERS
+template bool Position::legal<LOSERS_VARIANT>(Move) const;
+#endif
+#ifdef RACE
+template bool Position::legal<RACE_VARIANT>(Move) const;
+#endif
+#ifdef RELAY
+template bool Position::legal<RELAY_VARIANT>(Move) const;
+#endif
+#ifdef THREECHECK
+template bool Position::legal<THREECHECK_VARIANT>(Move) const;
+#endif
+
+
 /// Position::pseudo_legal() takes a random move and tests whether the move is
 /// pseudo legal. It is used to validate moves from TT that can be corrupted
 /// due to SMP concurrent access or hash position key aliasing.
@@ -989,6 +1060,7 @@ bool Position::pseudo_legal(const Move m) const {
 
 /// Position::gives_check() tests whether a pseudo-legal move gives a check
 
+template<Variant V>
 bool Position::gives_check(Move m) const {
 
   assert(is_ok(m));
@@ -998,19 +1070,19 @@ bool Position::gives_check(Move m) const {
   Square to = to_sq(m);
 
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP)
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
       return st->checkSquares[type_of(dropped_piece(m))] & to;
 #endif
 #ifdef HORDE
-  if (is_horde() && is_horde_color(~sideToMove))
+  if (V == HORDE_VARIANT && is_horde_color(~sideToMove))
       return false;
 #endif
 #ifdef ANTI
-  if (is_anti())
+  if (V == ANTI_VARIANT)
       return false;
 #endif
 #ifdef ATOMIC
-  if (is_atomic())
+  if (V == ATOMIC_VARIANT)
   {
       Square ksq = square<KING>(~sideToMove);
       Bitboard attacks = attacks_from<KING>(ksq);
@@ -1100,20 +1172,60 @@ bool Position::gives_check(Move m) const {
   }
 }
 
+
+bool Position::gives_check(Move m) const {
+  return dispatch<GivesCheck>(var, *this, m);
+}
+
+template bool Position::gives_check<CHESS_VARIANT>(Move) const;
+#ifdef ANTI
+template bool Position::gives_check<ANTI_VARIANT>(Move) const;
+#endif
+#ifdef ATOMIC
+template bool Position::gives_check<ATOMIC_VARIANT>(Move) const;
+#endif
+#ifdef CRAZYHOUSE
+template bool Position::gives_check<CRAZYHOUSE_VARIANT>(Move) const;
+#endif
+#ifdef HORDE
+template bool Position::gives_check<HORDE_VARIANT>(Move) const;
+#endif
+#ifdef KOTH
+template bool Position::gives_check<KOTH_VARIANT>(Move) const;
+#endif
+#ifdef LOSERS
+template bool Position::gives_check<LOSERS_VARIANT>(Move) const;
+#endif
+#ifdef RACE
+template bool Position::gives_check<RACE_VARIANT>(Move) const;
+#endif
+#ifdef RELAY
+template bool Position::gives_check<RELAY_VARIANT>(Move) const;
+#endif
+#ifdef THREECHECK
+template bool Position::gives_check<THREECHECK_VARIANT>(Move) const;
+#endif
+
 /// Position::do_move() makes a move, and saves all information necessary
 /// to a StateInfo object. The move is assumed to be legal. Pseudo-legal
 /// moves should be filtered out before this function is called.
 
+template<Variant V>
 void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
   assert(is_ok(m));
   assert(&newSt != st);
 #ifdef ANTI
-  assert(!is_anti() || !givesCheck);
+  assert(V != ANTI_VARIANT || !givesCheck);
 #endif
 
   thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
   Key k = st->key ^ Zobrist::side;
+#ifdef INCREMENTAL_ATTACKS
+  Bitboard prevByType[PIECE_TYPE_NB], prevByColor[COLOR_NB];
+  std::memcpy(prevByType, byTypeBB, sizeof(prevByType));
+  std::memcpy(prevByColor, byColorBB, sizeof(prevByColor));
+#endif
 
   // Copy some fields of the old state to our new StateInfo object except the
   // ones which are going to be recalculated from scratch anyway and then switch
@@ -1133,7 +1245,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   Square from = from_sq(m);
   Square to = to_sq(m);
 #ifdef CRAZYHOUSE
-  Piece pc = is_house() && type_of(m) == DROP ? dropped_piece(m) : piece_on(from);
+  Piece pc = V == CRAZYHOUSE_VARIANT && type_of(m) == DROP ? dropped_piece(m) : piece_on(from);
 #else
   Piece pc = piece_on(from);
 #endif
@@ -1142,7 +1254,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   assert(color_of(pc) == us);
   assert(captured == NO_PIECE || color_of(captured) == (type_of(m) != CASTLING ? them : us));
 #ifdef ANTI
-  assert(is_anti() || type_of(captured) != KING);
+  assert(V == ANTI_VARIANT || type_of(captured) != KING);
 #else
   assert(type_of(captured) != KING);
 #endif
@@ -1155,7 +1267,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       Square rfrom, rto;
       do_castling<true>(us, from, to, rfrom, rto);
 
-      st->psq += PSQT::psq[var][captured][rto] - PSQT::psq[var][captured][rfrom];
+      st->psq += PSQT::psq[V][captured][rto] - PSQT::psq[V][captured][rfrom];
       k ^= Zobrist::psq[captured][rfrom] ^ Zobrist::psq[captured][rto];
       captured = NO_PIECE;
   }
@@ -1189,7 +1301,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       // Update board and piece lists
       remove_piece(captured, capsq);
 #ifdef CRAZYHOUSE
-      if (is_house())
+      if (V == CRAZYHOUSE_VARIANT)
       {
           st->capturedpromoted = is_promoted(to);
 #ifdef BUGHOUSE
@@ -1198,9 +1310,13 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           {
               Piece add = is_promoted(to) ? make_piece(~color_of(captured), PAWN) : ~captured;
               add_to_hand(color_of(add), type_of(add));
-              st->psq += PSQT::psq[var][add][SQ_NONE];
-              k ^= Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)] - 1]
-                  ^ Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)]];
+              st->psq += PSQT::psq[V][add][SQ_NONE];
+              if (type_of(add) != PAWN) // Pieces in hand count as material, see set_state()
+                  st->nonPawnMaterial[color_of(add)] += PieceValue[CHESS_VARIANT][MG][type_of(add)];
+              Key handKey =  Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)] - 1]
+                           ^ Zobrist::inHand[add][pieceCountInHand[color_of(add)][type_of(add)]];
+              k ^= handKey;
+              st->materialKey ^= handKey; // The material evaluation reads the hands
           }
           promotedPieces -= to;
       }
@@ -1210,17 +1326,19 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       k ^= Zobrist::psq[captured][capsq];
       st->materialKey ^= Zobrist::psq[captured][pieceCount[captured]];
 #ifdef ATOMIC
-      if (is_atomic()) // Remove the blast piece(s)
+      if (V == ATOMIC_VARIANT) // Remove the blast piece(s)
       {
+          assert(blastCount < int(SQUARE_NB) / 2);
+
+          Piece* removed = blasts[blastCount++];
           Bitboard blast = attacks_from<KING>(to) - from;
           while (blast)
           {
               Square bsq = pop_lsb(&blast);
-              Piece bpc = piece_on(bsq);
-              st->blast[bsq] = bpc;
+              Piece bpc = *removed++ = piece_on(bsq);
               if (bpc != NO_PIECE && type_of(bpc) != PAWN)
               {
-                  Color bc = color_of(st->blast[bsq]);
+                  Color bc = color_of(bpc);
                   st->nonPawnMaterial[bc] -= PieceValue[CHESS_VARIANT][MG][type_of(bpc)];
 
                   // Update board and piece lists
@@ -1231,7 +1349,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                   st->materialKey ^= Zobrist::psq[bpc][pieceCount[bpc]];
 
                   // Update incremental scores
-                  st->psq -= PSQT::psq[var][bpc][bsq];
+                  st->psq -= PSQT::psq[V][bpc][bsq];
 
                   // Update castling rights if needed
                   if (st->castlingRights && castlingRightsMask[bsq])
@@ -1248,25 +1366,25 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       prefetch(thisThread->materialTable[st->materialKey]);
 
       // Update incremental scores
-      st->psq -= PSQT::psq[var][captured][capsq];
+      st->psq -= PSQT::psq[V][captured][capsq];
 
       // Reset rule 50 counter
       st->rule50 = 0;
   }
 
 #ifdef ATOMIC
-  if (is_atomic() && captured)
+  if (V == ATOMIC_VARIANT && captured)
       k ^= Zobrist::psq[pc][from];
   else
 #endif
   // Update hash key
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP)
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
   {
-      k ^= Zobrist::psq[pc][to] ^ Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)] - 1]
-          ^ Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)]];
-      if (type_of(pc) != PAWN)
-          st->nonPawnMaterial[us] += PieceValue[CHESS_VARIANT][MG][type_of(pc)];
+      Key handKey =  Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)] - 1]
+                   ^ Zobrist::inHand[pc][pieceCountInHand[color_of(pc)][type_of(pc)]];
+      k ^= Zobrist::psq[pc][to] ^ handKey;
+      st->materialKey ^= handKey;
   }
   else
 #endif
@@ -1281,7 +1399,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
   // Update castling rights if needed
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP) {} else
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP) {} else
 #endif
   if (st->castlingRights && (castlingRightsMask[from] | castlingRightsMask[to]))
   {
@@ -1291,7 +1409,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   }
 
 #ifdef THREECHECK
-  if (is_three_check() && givesCheck)
+  if (V == THREECHECK_VARIANT && givesCheck)
   {
       k ^= Zobrist::checks[us][st->checksGiven[us]];
       CheckCount checksGiven = ++(st->checksGiven[us]);
@@ -1301,9 +1419,9 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 #endif
 
 #ifdef ATOMIC
-  if (is_atomic() && captured) // Remove the blast piece(s)
+  if (V == ATOMIC_VARIANT && captured) // Remove the blast piece(s)
   {
-      st->blast[from] = piece_on(from);
+      blasts[blastCount - 1][8] = piece_on(from);
       remove_piece(pc, from);
       // Update material (hash key already updated)
       st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]];
@@ -1314,7 +1432,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 #endif
   // Move the piece. The tricky Chess960 castling is handled earlier
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP)
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
   {
       drop_piece(pc, to);
       st->materialKey ^= Zobrist::psq[pc][pieceCount[pc]-1];
@@ -1329,10 +1447,10 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   {
       // Set en-passant square if the moved pawn can be captured
 #ifdef HORDE
-      if (is_horde() && rank_of(from) == relative_rank(us, RANK_1)); else
+      if (V == HORDE_VARIANT && rank_of(from) == relative_rank(us, RANK_1)); else
 #endif
 #ifdef ATOMIC
-      if (is_atomic() && captured); else
+      if (V == ATOMIC_VARIANT && captured); else
 #endif
       if (   (int(to) ^ int(from)) == 16
           && (attacks_from<PAWN>(to - pawn_push(us), us) & pieces(them, PAWN)))
@@ -1346,7 +1464,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
           assert(relative_rank(us, to) == RANK_8);
 #ifdef ANTI
-          assert(type_of(promotion) >= KNIGHT && type_of(promotion) <= (is_anti() ? KING : QUEEN));
+          assert(type_of(promotion) >= KNIGHT && type_of(promotion) <= (V == ANTI_VARIANT ? KING : QUEEN));
 #else
           assert(type_of(promotion) >= KNIGHT && type_of(promotion) <= QUEEN);
 #endif
@@ -1355,9 +1473,9 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           put_piece(promotion, to);
 #ifdef CRAZYHOUSE
 #ifdef LOOP
-          if (is_house() && !is_loop())
+          if (V == CRAZYHOUSE_VARIANT && !is_loop())
 #else
-          if (is_house())
+          if (V == CRAZYHOUSE_VARIANT)
 #endif
               promotedPieces = promotedPieces | to;
 #endif
@@ -1369,7 +1487,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
                             ^ Zobrist::psq[pc][pieceCount[pc]];
 
           // Update incremental score
-          st->psq += PSQT::psq[var][promotion][to] - PSQT::psq[var][pc][to];
+          st->psq += PSQT::psq[V][promotion][to] - PSQT::psq[V][pc][to];
 
           // Update material
           st->nonPawnMaterial[us] += PieceValue[CHESS_VARIANT][MG][promotion];
@@ -1377,12 +1495,12 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
       // Update pawn hash key and prefetch access to pawnsTable
 #ifdef ATOMIC
-      if (is_atomic() && captured)
+      if (V == ATOMIC_VARIANT && captured)
           st->pawnKey ^= Zobrist::psq[make_piece(us, PAWN)][from];
       else
 #endif
 #ifdef CRAZYHOUSE
-      if (is_house() && type_of(m) == DROP)
+      if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
           st->pawnKey ^= Zobrist::psq[pc][to];
       else
 #endif
@@ -1394,17 +1512,17 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   }
 
 #ifdef ATOMIC
-  if (is_atomic() && captured)
-      st->psq -= PSQT::psq[var][pc][from];
+  if (V == ATOMIC_VARIANT && captured)
+      st->psq -= PSQT::psq[V][pc][from];
   else
 #endif
   // Update incremental scores
-  st->psq += PSQT::psq[var][pc][to] - PSQT::psq[var][pc][from];
+  st->psq += PSQT::psq[V][pc][to] - PSQT::psq[V][pc][from];
 
   // Set capture piece
   st->capturedPiece = captured;
 #ifdef CRAZYHOUSE
-  if (is_house() && !captured)
+  if (V == CRAZYHOUSE_VARIANT && !captured)
       st->capturedpromoted = false;
 #endif
 
@@ -1415,12 +1533,16 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
 
 #ifdef CRAZYHOUSE
-  if ((!is_house() || type_of(m) != DROP) && is_promoted(from))
+  if ((V != CRAZYHOUSE_VARIANT || type_of(m) != DROP) && is_promoted(from))
       promotedPieces = (promotedPieces - from) | to;
 #endif
 
   sideToMove = ~sideToMove;
 
+#ifdef INCREMENTAL_ATTACKS
+  update_attacks(prevByType, prevByColor);
+#endif
+
   // Update king attacks used for fast check detection
   set_check_info(st);
 
@@ -1428,9 +1550,58 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 }
 
 
+#ifdef INCREMENTAL_ATTACKS
+/// Position::attacks_of() computes the squares attacked by the pieces of color
+/// c and type pt, for the attack maps of the state.
+
+Bitboard Position::attacks_of(Color c, PieceType pt) const {
+
+  Bitboard b = pieces(c, pt), attacks = 0;
+
+  if (pt == PAWN)
+      return c == WHITE ? shift<NORTH_WEST>(b) | shift<NORTH_EAST>(b)
+                        : shift<SOUTH_WEST>(b) | shift<SOUTH_EAST>(b);
+
+  while (b)
+      attacks |= attacks_from(pt, pop_lsb(&b));
+
+  return attacks;
+}
+
+
+/// Position::update_attacks() updates the attack maps copied from the previous
+/// state, given the bitboards before the move. Those of a piece type are only
+/// recomputed if its pieces have changed, or for the sliders if they attack a
+/// square whose occupancy has changed, which may lengthen or shorten their
+/// rays. Castling, drops and the explosions of atomic need no special case.
+
+void Position::update_attacks(const Bitboard* prevByType, const Bitboard* prevByColor) {
+
+  Bitboard changed =  (prevByColor[WHITE] ^ byColorBB[WHITE])
+                    | (prevByColor[BLACK] ^ byColorBB[BLACK]);
+
+  for (Color c = WHITE; c <= BLACK; ++c)
+  {
+      Bitboard* attacks = st->attacks[c];
+      attacks[ALL_PIECES] = 0;
+
+      for (PieceType pt = PAWN; pt <= KING; ++pt)
+      {
+          if (   (prevByType[pt] & prevByColor[c]) != pieces(c, pt)
+              || (pt >= BISHOP && pt <= QUEEN && (attacks[pt] & changed)))
+              attacks[pt] = attacks_of(c, pt);
+
+          attacks[ALL_PIECES] |= attacks[pt];
+      }
+  }
+}
+#endif
+
+
 /// Position::undo_move() unmakes a move. When it returns, the position should
 /// be restored to exactly the same state as before the move was made.
 
+template<Variant V>
 void Position::undo_move(Move m) {
 
   assert(is_ok(m));
@@ -1442,18 +1613,18 @@ void Position::undo_move(Move m) {
   Square to = to_sq(m);
   Piece pc = piece_on(to);
 #ifdef ATOMIC
-  if (is_atomic() && st->capturedPiece) // Restore the blast piece(s)
-      pc = st->blast[from];
+  if (V == ATOMIC_VARIANT && st->capturedPiece) // Restore the blast piece(s)
+      pc = blasts[blastCount - 1][8];
 #endif
 
   assert(empty(to) || color_of(piece_on(to)) == us);
 #ifdef CRAZYHOUSE
-  assert((is_house() && type_of(m) == DROP) || empty(from) || type_of(m) == CASTLING);
+  assert((V == CRAZYHOUSE_VARIANT && type_of(m) == DROP) || empty(from) || type_of(m) == CASTLING);
 #else
   assert(empty(from) || type_of(m) == CASTLING);
 #endif
 #ifdef ANTI
-  assert(is_anti() || type_of(st->capturedPiece) != KING);
+  assert(V == ANTI_VARIANT || type_of(st->capturedPiece) != KING);
 #else
   assert(type_of(st->capturedPiece) != KING);
 #endif
@@ -1462,12 +1633,12 @@ void Position::undo_move(Move m) {
   {
       assert(relative_rank(us, to) == RANK_8);
 #ifdef ATOMIC
-      if (!is_atomic() || !st->capturedPiece)
+      if (V != ATOMIC_VARIANT || !st->capturedPiece)
       {
 #endif
       assert(type_of(pc) == promotion_type(m));
 #ifdef ANTI
-      assert(type_of(pc) >= KNIGHT && type_of(pc) <= (is_anti() ? KING : QUEEN));
+      assert(type_of(pc) >= KNIGHT && type_of(pc) <= (V == ANTI_VARIANT ? KING : QUEEN));
 #else
       assert(type_of(pc) >= KNIGHT && type_of(pc) <= QUEEN);
 #endif
@@ -1476,7 +1647,7 @@ void Position::undo_move(Move m) {
       pc = make_piece(us, PAWN);
       put_piece(pc, to);
 #ifdef CRAZYHOUSE
-      if (is_house())
+      if (V == CRAZYHOUSE_VARIANT)
           promotedPieces -= to;
 #endif
 #ifdef ATOMIC
@@ -1492,18 +1663,18 @@ void Position::undo_move(Move m) {
   else
   {
 #ifdef ATOMIC
-      if (is_atomic() && st->capturedPiece) // Restore the blast piece(s)
+      if (V == ATOMIC_VARIANT && st->capturedPiece) // Restore the blast piece(s)
           put_piece(pc, from);
       else
 #endif
 #ifdef CRAZYHOUSE
-      if (is_house() && type_of(m) == DROP)
+      if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
           undrop_piece(pc, to); // Remove the dropped piece
       else
 #endif
       move_piece(pc, to, from); // Put the piece back at the source square
 #ifdef CRAZYHOUSE
-      if (is_house() && is_promoted(to))
+      if (V == CRAZYHOUSE_VARIANT && is_promoted(to))
           promotedPieces = (promotedPieces - to) | from;
 #endif
 
@@ -1523,15 +1694,14 @@ void Position::undo_move(Move m) {
           }
 
 #ifdef ATOMIC
-          if (is_atomic() && st->capturedPiece) // Restore the blast piece(s)
+          if (V == ATOMIC_VARIANT && st->capturedPiece) // Restore the blast piece(s)
           {
-              Bitboard blast = attacks_from<KING>(to); // squares in blast radius
+              const Piece* removed = blasts[--blastCount];
+              Bitboard blast = attacks_from<KING>(to) - from; // squares in blast radius
               while (blast)
               {
                   Square bsq = pop_lsb(&blast);
-                  if (bsq == from)
-                      continue;
-                  Piece bpc = st->blast[bsq];
+                  Piece bpc = *removed++;
                   if (bpc != NO_PIECE && type_of(bpc) != PAWN)
                       put_piece(bpc, bsq);
               }
@@ -1539,7 +1709,7 @@ void Position::undo_move(Move m) {
 #endif
           put_piece(st->capturedPiece, capsq); // Restore the captured piece
 #ifdef CRAZYHOUSE
-          if (is_house())
+          if (V == CRAZYHOUSE_VARIANT)
           {
 #ifdef BUGHOUSE
               if (! is_bughouse())
@@ -1560,6 +1730,59 @@ void Position::undo_move(Move m) {
 }
 
 
+/// Position::do_move() and Position::undo_move() without a template argument
+/// call the versions for the variant of the position. The search calls the
+/// variant versions directly.
+
+void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
+  dispatch<DoMove>(var, *this, m, newSt, givesCheck);
+}
+
+void Position::undo_move(Move m) {
+  dispatch<UndoMove>(var, *this, m);
+}
+
+// Explicit template instantiations
+template void Position::do_move<CHESS_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<CHESS_VARIANT>(Move);
+#ifdef ANTI
+template void Position::do_move<ANTI_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<ANTI_VARIANT>(Move);
+#endif
+#ifdef ATOMIC
+template void Position::do_move<ATOMIC_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<ATOMIC_VARIANT>(Move);
+#endif
+#ifdef CRAZYHOUSE
+template void Position::do_move<CRAZYHOUSE_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<CRAZYHOUSE_VARIANT>(Move);
+#endif
+#ifdef HORDE
+template void Position::do_move<HORDE_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<HORDE_VARIANT>(Move);
+#endif
+#ifdef KOTH
+template void Position::do_move<KOTH_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<KOTH_VARIANT>(Move);
+#endif
+#ifdef LOSERS
+template void Position::do_move<LOSERS_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<LOSERS_VARIANT>(Move);
+#endif
+#ifdef RACE
+template void Position::do_move<RACE_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<RACE_VARIANT>(Move);
+#endif
+#ifdef RELAY
+template void Position::do_move<RELAY_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<RELAY_VARIANT>(Move);
+#endif
+#ifdef THREECHECK
+template void Position::do_move<THREECHECK_VARIANT>(Move, StateInfo&, bool);
+template void Position::undo_move<THREECHECK_VARIANT>(Move);
+#endif
+
+
 /// Position::do_castling() is a helper used to do/undo a castling move. This
 /// is a bit tricky in Chess960 where from/to squares can overlap.
 template<bool Do>
@@ -1670,6 +1893,24 @@ Key Position::key_after(Move m) const {
 }
 
 #ifdef ATOMIC
+/// Position::blast_value() returns the value of the pieces on the 'blast'
+/// squares, which must not hold pawns or kings, for the side 'us': those of
+/// the opponent count positively and ours negatively. There are at most 8
+/// squares, often only a few pieces, so we loop over these.
+
+Value Position::blast_value(Bitboard blast, Color us) const {
+
+  Value v = VALUE_ZERO;
+
+  while (blast)
+  {
+      Piece pc = piece_on(pop_lsb(&blast));
+      v += color_of(pc) == us ? -PieceValue[ATOMIC_VARIANT][MG][pc] : PieceValue[ATOMIC_VARIANT][MG][pc];
+  }
+
+  return v;
+}
+
 template<>
 Value Position::see<ATOMIC_VARIANT>(Move m) const {
   assert(is_ok(m));
@@ -1677,17 +1918,56 @@ Value Position::see<ATOMIC_VARIANT>(Move m) const {
   Square from = from_sq(m), to = to_sq(m);
   Color stm = color_of(piece_on(from));
 
-  Value blast_eval = VALUE_ZERO;
   Bitboard blast = attacks_from<KING>(to) & (pieces() ^ pieces(PAWN)) & ~SquareBB[from];
   if (blast & pieces(~stm,KING))
       return VALUE_MATE;
-  for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt)
-          if (c == stm)
-              blast_eval -= popcount(blast & pieces(c,pt)) * PieceValue[var][MG][pt];
-          else
-              blast_eval += popcount(blast & pieces(c,pt)) * PieceValue[var][MG][pt];
-  return blast_eval + PieceValue[var][MG][piece_on(to_sq(m))] - PieceValue[var][MG][moved_piece(m)];
+
+  return  blast_value(blast & ~pieces(KING), stm)
+        + PieceValue[var][MG][piece_on(to)] - PieceValue[var][MG][moved_piece(m)];
+}
+
+/// Position::see_ge_atomic() is see_ge() for atomic chess. A capture is worth
+/// the explosion it causes. After a quiet move, the opponent may capture the
+/// moved piece with any piece but the king, blowing up the capturer, the moved
+/// piece and the pieces around, so the move must pass for all the capturers.
+/// Their explosions differ only by the capturer, so the blast is scored once.
+
+bool Position::see_ge_atomic(Move m, Value threshold) const {
+
+  Square from = from_sq(m), to = to_sq(m);
+  Color us = color_of(piece_on(from));
+
+  if (capture(m))
+      return see<ATOMIC_VARIANT>(m) >= threshold + 1;
+
+  if (threshold > VALUE_ZERO)
+      return false;
+
+  Bitboard occupied = pieces() ^ from;
+  Bitboard attackers = attackers_to(to, occupied) & occupied & pieces(~us) & ~pieces(KING);
+
+  if (!attackers)
+      return true;
+
+  Bitboard blast = attacks_from<KING>(to) & (pieces() ^ pieces(PAWN)) & ~SquareBB[from];
+
+  if (blast & pieces(~us, KING)) // Any capture would blow up their king
+      return true;
+
+  if (blast & pieces(us, KING))
+      return false;
+
+  // A capturer next to 'to' is in the blast already, so it adds nothing
+  Value value = blast_value(blast & ~pieces(KING), us) - PieceValue[ATOMIC_VARIANT][MG][moved_piece(m)];
+
+  if ((attackers & blast) && value < threshold)
+      return false;
+
+  for (Bitboard b = attackers & ~blast; b; )
+      if (value + PieceValue[ATOMIC_VARIANT][MG][piece_on(pop_lsb(&b))] < threshold)
+          return false;
+
+  return true;
 }
 #endif
 
@@ -1695,14 +1975,15 @@ Value Position::see<ATOMIC_VARIANT>(Move m) const {
 /// SEE value of move is greater or equal to the given threshold. We'll use an
 /// algorithm similar to alpha-beta pruning with a null window.
 
+template<Variant V>
 bool Position::see_ge(Move m, Value threshold) const {
 
   assert(is_ok(m));
 #ifdef CRAZYHOUSE
-  if (is_house() && color_of(moved_piece(m)) == sideToMove)
+  if (V == CRAZYHOUSE_VARIANT && color_of(moved_piece(m)) == sideToMove)
   {
       // Reduce threshold based on remaining material in hand
-      if (gives_check(m))
+      if (gives_check<V>(m))
           threshold -= material_in_hand(sideToMove) / 5;
       // Increase threshold based on remaining material in hand
       if (checkers())
@@ -1713,21 +1994,28 @@ bool Position::see_ge(Move m, Value threshold) const {
 #endif
 
 #ifdef THREECHECK
-  if (is_three_check() && color_of(moved_piece(m)) == sideToMove && gives_check(m))
+  if (V == THREECHECK_VARIANT && color_of(moved_piece(m)) == sideToMove && gives_check<V>(m))
       return true;
 #endif
 
   // Only deal with normal moves, assume others pass a simple see
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP) {} else
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP) {} else
 #endif
   if (type_of(m) != NORMAL)
       return VALUE_ZERO >= threshold;
 
+#ifdef ATOMIC
+  if (V == ATOMIC_VARIANT)
+      return see_ge_atomic(m, threshold);
+#endif
+
+  // Antichess uses the exchange below as well. Playing it out to the end
+  // without the early cutoffs, as captures are compulsory, was no stronger.
   Square from = from_sq(m), to = to_sq(m);
 #ifdef CRAZYHOUSE
-  PieceType nextVictim = type_of(is_house() && type_of(m) == DROP ? dropped_piece(m) : piece_on(from));
-  Color stm = ~color_of(is_house() && type_of(m) == DROP ? dropped_piece(m) : piece_on(from)); // First consider opponent's move
+  PieceType nextVictim = type_of(V == CRAZYHOUSE_VARIANT && type_of(m) == DROP ? dropped_piece(m) : piece_on(from));
+  Color stm = ~color_of(V == CRAZYHOUSE_VARIANT && type_of(m) == DROP ? dropped_piece(m) : piece_on(from)); // First consider opponent's move
 #else
   PieceType nextVictim = type_of(piece_on(from));
   Color stm = ~color_of(piece_on(from)); // First consider opponent's move
@@ -1735,58 +2023,20 @@ bool Position::see_ge(Move m, Value threshold) const {
   Value balance; // Values of the pieces taken by us minus opponent's ones
   Bitboard occupied, stmAttackers;
 
-#ifdef ATOMIC
-  if (is_atomic())
-  {
-      stm = color_of(piece_on(from));
-      if (capture(m))
-          return see<ATOMIC_VARIANT>(m) >= threshold + 1;
-      else
-      {
-          if (threshold > VALUE_ZERO)
-              return false;
 
-          occupied = pieces() ^ from;
-          Bitboard b = attackers_to(to, occupied) & occupied & pieces(~stm) & ~pieces(KING);
-
-          // Loop over attacking pieces
-          while (b)
-          {
-              Square s = pop_lsb(&b);
-
-              Value blast_eval = VALUE_ZERO;
-              Bitboard blast = attacks_from<KING>(to) & (pieces() ^ pieces(PAWN)) & ~SquareBB[from] & ~SquareBB[s];
-              if (blast & pieces(~stm,KING))
-                  continue;
-              if (blast & pieces(stm,KING))
-                  return false;
-              for (Color c = WHITE; c <= BLACK; ++c)
-                  for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt)
-                      if (c == stm)
-                          blast_eval -= popcount(blast & pieces(c,pt)) * PieceValue[var][MG][pt];
-                      else
-                          blast_eval += popcount(blast & pieces(c,pt)) * PieceValue[var][MG][pt];
-              if (blast_eval + PieceValue[var][MG][piece_on(s)] - PieceValue[var][MG][moved_piece(m)] < threshold)
-                  return false;
-          }
-          return true;
-      }
-  }
-#endif
-
-  balance = PieceValue[var][MG][piece_on(to)];
+  balance = PieceValue[V][MG][piece_on(to)];
 
   if (balance < threshold)
       return false;
 
-  balance -= PieceValue[var][MG][nextVictim];
+  balance -= PieceValue[V][MG][nextVictim];
 
   if (balance >= threshold) // Always true if nextVictim == KING
       return true;
 
   bool relativeStm = true; // True if the opponent is to move
 #ifdef CRAZYHOUSE
-  if (is_house() && type_of(m) == DROP)
+  if (V == CRAZYHOUSE_VARIANT && type_of(m) == DROP)
       occupied = pieces() ^ to;
   else
 #endif
@@ -1811,15 +2061,27 @@ bool Position::see_ge(Move m, Value threshold) const {
       // Locate and remove the next least valuable attacker
       nextVictim = min_attacker<PAWN>(byTypeBB, to, stmAttackers, occupied, attackers);
 
-      // Don't allow pinned pieces to attack pieces except the king
 #ifdef ANTI
-      if (is_anti()) {} else
+      // The king of antichess is captured like any piece, and min_attacker()
+      // leaves it on the board, as in chess it ends the exchange.
+      if (V == ANTI_VARIANT)
+      {
+          if (nextVictim == KING)
+          {
+              occupied ^= lsb(stmAttackers & pieces(KING));
+              attackers |=  (attacks_bb<BISHOP>(to, occupied) & pieces(BISHOP, QUEEN))
+                          | (attacks_bb<ROOK  >(to, occupied) & pieces(ROOK, QUEEN));
+              attackers &= occupied;
+          }
+      }
+      else
 #endif
+      // Don't allow pinned pieces to attack pieces except the king
       if (nextVictim == KING)
           return relativeStm == bool(attackers & pieces(~stm));
 
-      balance += relativeStm ?  PieceValue[var][MG][nextVictim]
-                             : -PieceValue[var][MG][nextVictim];
+      balance += relativeStm ?  PieceValue[V][MG][nextVictim]
+                             : -PieceValue[V][MG][nextVictim];
 
       relativeStm = !relativeStm;
 
@@ -1831,6 +2093,40 @@ bool Position::see_ge(Move m, Value threshold) const {
 }
 
 
+bool Position::see_ge(Move m, Value threshold) const {
+  return dispatch<SeeGe>(var, *this, m, threshold);
+}
+
+template bool Position::see_ge<CHESS_VARIANT>(Move, Value) const;
+#ifdef ANTI
+template bool Position::see_ge<ANTI_VARIANT>(Move, Value) const;
+#endif
+#ifdef ATOMIC
+template bool Position::see_ge<ATOMIC_VARIANT>(Move, Value) const;
+#endif
+#ifdef CRAZYHOUSE
+template bool Position::see_ge<CRAZYHOUSE_VARIANT>(Move, Value) const;
+#endif
+#ifdef HORDE
+template bool Position::see_ge<HORDE_VARIANT>(Move, Value) const;
+#endif
+#ifdef KOTH
+template bool Position::see_ge<KOTH_VARIANT>(Move, Value) const;
+#endif
+#ifdef LOSERS
+template bool Position::see_ge<LOSERS_VARIANT>(Move, Value) const;
+#endif
+#ifdef RACE
+template bool Position::see_ge<RACE_VARIANT>(Move, Value) const;
+#endif
+#ifdef RELAY
+template bool Position::see_ge<RELAY_VARIANT>(Move, Value) const;
+#endif
+#ifdef THREECHECK
+template bool Position::see_ge<THREECHECK_VARIANT>(Move, Value) const;
+#endif
+
+
 /// Position::is_draw() tests whether the position is drawn by 50-move rule
 /// or by repetition. It does not detect stalemates.
 
@@ -47,24 +47,20 @@ struct StateInfo {
 #endif
   Score  psq;
   Square epSquare;
+#ifdef INCREMENTAL_ATTACKS
+  Bitboard attacks[COLOR_NB][PIECE_TYPE_NB]; // See Position::update_attacks()
+#endif
 
   // Not copied when making a move (will be recomputed anyhow)
   Key        key;
   Bitboard   checkersBB;
   Piece      capturedPiece;
-#ifdef ATOMIC
-  Piece      blast[SQUARE_NB];
-#endif
 #ifdef CRAZYHOUSE
   bool       capturedpromoted;
 #endif
   StateInfo* previous;
   Bitboard   blockersForKing[COLOR_NB];
   Bitboard   pinnersForKing[COLOR_NB];
-#ifdef RELAY
-  Square     pieceListRelay[PIECE_NB][16];
-  Bitboard   byTypeBBRelay[PIECE_TYPE_NB];
-#endif
   Bitboard   checkSquares[PIECE_TYPE_NB];
 };
 
@@ -131,13 +127,19 @@ public:
   template<PieceType> Bitboard attacks_from(Square s) const;
   template<PieceType> Bitboard attacks_from(Square s, Color c) const;
   Bitboard slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const;
+  bool attacked_by(Color c, Square s) const;
+#ifdef INCREMENTAL_ATTACKS
+  Bitboard attacks_by(Color c, PieceType pt = ALL_PIECES) const;
+#endif
 
   // Properties of moves
   bool legal(Move m) const;
+  template<Variant V> bool legal(Move m) const;
   bool pseudo_legal(const Move m) const;
   bool capture(Move m) const;
   bool capture_or_promotion(Move m) const;
   bool gives_check(Move m) const;
+  template<Variant V> bool gives_check(Move m) const;
   bool advanced_pawn_push(Move m) const;
   Piece moved_piece(Move m) const;
   Piece captured_piece() const;
@@ -150,6 +152,8 @@ public:
   void do_move(Move m, StateInfo& newSt);
   void do_move(Move m, StateInfo& newSt, bool givesCheck);
   void undo_move(Move m);
+  template<Variant V> void do_move(Move m, StateInfo& newSt, bool givesCheck);
+  template<Variant V> void undo_move(Move m);
   void do_null_move(StateInfo& newSt);
   void undo_null_move();
 
@@ -159,6 +163,7 @@ public:
   Value see(Move m) const;
 #endif
   bool see_ge(Move m, Value threshold = VALUE_ZERO) const;
+  template<Variant V> bool see_ge(Move m, Value threshold = VALUE_ZERO) const;
 
   // Accessing hash keys
   Key key() const;
@@ -189,10 +194,12 @@ public:
 #ifdef CRAZYHOUSE
   bool is_house() const;
   template<PieceType Pt> int count_in_hand(Color c) const;
+  int count_in_hand(Color c, PieceType pt) const;
   Value material_in_hand(Color c) const;
   void add_to_hand(Color c, PieceType pt);
   void remove_from_hand(Color c, PieceType pt);
   bool is_promoted(Square s) const;
+  Bitboard promoted_pieces() const;
   void drop_piece(Piece pc, Square s);
   void undrop_piece(Piece pc, Square s);
 #endif
@@ -265,6 +272,17 @@ private:
   template<bool Do>
   void do_castling(Color us, Square from, Square& to, Square& rfrom, Square& rto);
 
+#ifdef INCREMENTAL_ATTACKS
+  Bitboard attacks_of(Color c, PieceType pt) const;
+  void update_attacks(const Bitboard* prevByType, const Bitboard* prevByColor);
+#endif
+
+  // Static Exchange Evaluation of the variants with their own capture rules
+#ifdef ATOMIC
+  Value blast_value(Bitboard blast, Color us) const;
+  bool see_ge_atomic(Move m, Value threshold) const;
+#endif
+
   // Data members
   Piece board[SQUARE_NB];
   Bitboard byTypeBB[PIECE_TYPE_NB];
@@ -293,6 +311,14 @@ private:
   bool chess960;
   Variant var;
   Variant subvar;
+#ifdef ATOMIC
+  // The pieces removed by each atomic capture on the current line, to be put
+  // back by undo_move(): those next to the target square, and the capturing one
+  // at [8]. Each capture removes at least two pieces, so there can't be more
+  // than SQUARE_NB / 2 of them.
+  Piece blasts[int(SQUARE_NB) / 2][9];
+  int blastCount;
+#endif
 
 };
 
@@ -452,6 +478,24 @@ inline Bitboard Position::attackers_to(Square s) const {
   return attackers_to(s, byTypeBB[ALL_PIECES]);
 }
 
+/// Position::attacked_by() tests whether a piece of color c attacks square s.
+/// Built with INCREMENTAL_ATTACKS, the state keeps the attack maps of each
+/// color and piece type, which attacks_by() returns.
+
+#ifdef INCREMENTAL_ATTACKS
+inline Bitboard Position::attacks_by(Color c, PieceType pt) const {
+  return st->attacks[c][pt];
+}
+
+inline bool Position::attacked_by(Color c, Square s) const {
+  return st->attacks[c][ALL_PIECES] & s;
+}
+#else
+inline bool Position::attacked_by(Color c, Square s) const {
+  return attackers_to(s) & pieces(c);
+}
+#endif
+
 inline Bitboard Position::checkers() const {
 #ifdef ANTI
   assert(!is_anti() || !st->checkersBB);
@@ -682,6 +726,10 @@ template<PieceType Pt> inline int Position::count_in_hand(Color c) const {
   return pieceCountInHand[c][Pt];
 }
 
+inline int Position::count_in_hand(Color c, PieceType pt) const {
+  return pieceCountInHand[c][pt];
+}
+
 inline Value Position::material_in_hand(Color c) const {
   Value v = VALUE_ZERO;
   for (PieceType pt = PAWN; pt <= QUEEN; ++pt)
@@ -702,6 +750,10 @@ inline void Position::remove_from_hand(Color c, PieceType pt) {
 inline bool Position::is_promoted(Square s) const {
   return promotedPieces & s;
 }
+
+inline Bitboard Position::promoted_pieces() const {
+  return promotedPieces;
+}
 #endif
 
 #ifdef BUGHOUSE
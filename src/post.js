@@ -1,4 +1,44 @@
+// The search runs on the event loop of this worker and cannot be started
+// again before it is finished. Until its result is printed, only commands
+// that interrupt or query the search are passed on, all others wait.
+var searching = false, pending = [];
+
+function command(cmd) {
+  if (typeof cmd === 'object') {
+    if (cmd.batch) { // {batch: [fen or move list, ...], limits: 'depth 12'}
+      searching = true;
+      Module.ccall('uci_batch', null, ['string', 'string'], [cmd.batch.join('\n'), cmd.limits || '']);
+    }
+    else if (cmd.ttSave !== undefined) { // {ttSave: min depth}, answered with {tt: ArrayBuffer}
+      var size = Module['_tt_save'](cmd.ttSave), ptr = Module['_tt_data']();
+      var blob = HEAPU8.slice(ptr, ptr + size);
+      postMessage({tt: blob.buffer}, [blob.buffer]);
+    }
+    else if (cmd.ttLoad) { // {ttLoad: ArrayBuffer}
+      var bytes = new Uint8Array(cmd.ttLoad), buf = Module['_malloc'](bytes.length);
+      HEAPU8.set(bytes, buf);
+      postMessage('info string Loaded ' + Module['_tt_load'](buf, bytes.length) + ' hash entries');
+      Module['_free'](buf);
+    }
+    else if (cmd.book) { // {book: ArrayBuffer} with the content of a book file
+      var bytes = new Uint8Array(cmd.book), buf = Module['_malloc'](bytes.length);
+      HEAPU8.set(bytes, buf);
+      postMessage('info string Book has ' + Module['_book_load'](buf, bytes.length) + ' entries');
+      Module['_free'](buf);
+    }
+    return;
+  }
+  if (/^(go|bench)\b/.test(cmd)) searching = true;
+  Module.ccall("uci_command", "number", ["string"], [cmd]);
+}
+
+function searchFinished() {
+  searching = false;
+  while (!searching && pending.length) command(pending.shift());
+}
+
 onmessage = function (e) {
   if (e.data == 'quit') close();
-  else Module.ccall("uci_command", "number", ["string"], [e.data]);
+  else if (searching && !/^(stop|ponderhit|isready)\b/.test(e.data)) pending.push(e.data);
+  else command(e.data);
 };
@@ -1,5 +1,31 @@
+var readyokTime = 0;
+
 var Module = {
   print: function(stdout) {
+    if (stdout == 'readyok' && !readyokTime) // Measured from the worker's creation
+      postMessage('info string Startup took ' + (readyokTime = Math.round(performance.now())) + ' ms');
     postMessage(stdout);
-  }
+    if (/^(bestmove|batch|bench|Nodes searched)/.test(stdout))
+      setTimeout(searchFinished, 0); // Not from within uci_command()
+  },
+  // Binary info records, see UCI::pv_records(). The copy's buffer is
+  // transferred to the receiver instead of being cloned once more.
+  onInfo: function(ptr, size) {
+    var records = HEAPU8.slice(ptr, ptr + size);
+    postMessage({info: records.buffer}, [records.buffer]);
+  },
+  // Zero-delay scheduling of engine tasks, see schedule() in misc.cpp
+  schedule: (function () {
+    var tasks = [], channel = typeof MessageChannel === 'function' ? new MessageChannel() : null;
+    function run() {
+      var task = tasks.shift();
+      Module['_run_scheduled'](task[0], task[1]);
+    }
+    if (channel) channel.port1.onmessage = run;
+    return function (func, arg) {
+      tasks.push([func, arg]);
+      if (channel) channel.port2.postMessage(0);
+      else setTimeout(run, 0);
+    };
+  })()
 };
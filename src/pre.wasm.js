@@ -1,27 +1,96 @@
+// Workers spawned for pthreads load this file as well, but they are set up
+// by Emscripten and must not take over the UCI message handler.
+if (typeof ENVIRONMENT_IS_PTHREAD === 'undefined' || !ENVIRONMENT_IS_PTHREAD)
 Module = (function () {
-  var queue = [];
+  // Commands wait in the queue until the runtime is ready. Afterwards, while
+  // a search is running, only commands that interrupt or query the search are
+  // passed on: it cannot be started again before its result is printed.
+  var queue = [], ready = false, searching = false, startup = 0;
+
+  function command(cmd) {
+    if (typeof cmd === 'object') {
+      if (cmd.batch) { // {batch: [fen or move list, ...], limits: 'depth 12'}
+        searching = true;
+        Module.ccall('uci_batch', null, ['string', 'string'], [cmd.batch.join('\n'), cmd.limits || '']);
+      }
+      else if (cmd.ttSave !== undefined) { // {ttSave: min depth}, answered with {tt: ArrayBuffer}
+        var size = Module['_tt_save'](cmd.ttSave), ptr = Module['_tt_data']();
+        var blob = HEAPU8.slice(ptr, ptr + size);
+        postMessage({tt: blob.buffer}, [blob.buffer]);
+      }
+      else if (cmd.ttLoad) { // {ttLoad: ArrayBuffer}
+        var bytes = new Uint8Array(cmd.ttLoad), buf = Module['_malloc'](bytes.length);
+        HEAPU8.set(bytes, buf);
+        postMessage('info string Loaded ' + Module['_tt_load'](buf, bytes.length) + ' hash entries');
+        Module['_free'](buf);
+      }
+      else if (cmd.book) { // {book: ArrayBuffer} with the content of a book file
+        var bytes = new Uint8Array(cmd.book), buf = Module['_malloc'](bytes.length);
+        HEAPU8.set(bytes, buf);
+        postMessage('info string Book has ' + Module['_book_load'](buf, bytes.length) + ' entries');
+        Module['_free'](buf);
+      }
+      return;
+    }
+    if (/^(go|bench)\b/.test(cmd)) searching = true;
+    Module.ccall('uci_command', 'number', ['string'], [cmd]);
+  }
+
+  function flush() {
+    searching = false;
+    while (ready && !searching && queue.length) command(queue.shift());
+  }
 
   onmessage = function (e) {
     if (e.data == 'quit') close();
-    else if (queue !== null) queue.push(e.data);
-    else Module.ccall('uci_command', 'number', ['string'], [e.data]);
+    else if (e.data == 'infobuffer') // Shared with pthreads, the records can be polled
+      postMessage({infoBuffer: HEAPU8.buffer, offset: Module['_info_buffer']()});
+    else if (ready && (!searching || /^(stop|ponderhit|isready)\b/.test(e.data))) command(e.data);
+    else queue.push(e.data);
   };
 
+  // Prefer the SIMD build if a module with a v128 instruction validates
+  var simd = WebAssembly.validate(new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0,
+    65, 0, 253, 15, 253, 98, 11]));
+
   var xhr = new XMLHttpRequest();
-  xhr.open('GET', 'stockfish.wasm?v=SF_VERSION', false);
+  xhr.open('GET', simd ? 'stockfish.simd.wasm?v=SF_SIMD_VERSION' : 'stockfish.wasm?v=SF_VERSION', false);
   xhr.responseType = 'arraybuffer';
   xhr.send(null);
 
   return {
     wasmBinary: xhr.response,
     print: function(stdout) {
+      if (stdout == 'readyok' && !startup) // Measured from the worker's creation
+        postMessage('info string Startup took ' + (startup = Math.round(performance.now())) + ' ms');
       postMessage(stdout);
+      if (/^(bestmove|batch|bench|Nodes searched)/.test(stdout))
+        setTimeout(flush, 0); // Not from within uci_command()
     },
     postRun: function() {
-      for (var i = 0; i < queue.length; i++) {
-        Module.ccall('uci_command', 'number', ['string'], [queue[i]]);
+      ready = true;
+      flush();
+    },
+    // Binary info records, see UCI::pv_records(). The copy's buffer is
+    // transferred to the receiver instead of being cloned once more.
+    onInfo: function(ptr, size) {
+      var records = HEAPU8.slice(ptr, ptr + size);
+      postMessage({info: records.buffer}, [records.buffer]);
+    },
+    // Zero-delay scheduling of engine tasks, see schedule() in misc.cpp
+    schedule: (function () {
+      var tasks = [], channel = typeof MessageChannel === 'function' ? new MessageChannel() : null;
+      function run() {
+        var task = tasks.shift();
+        Module['_run_scheduled'](task[0], task[1]);
       }
-      queue = null;
-    }
+      if (channel) channel.port1.onmessage = run;
+      return function (func, arg) {
+        tasks.push([func, arg]);
+        if (channel) channel.port2.postMessage(0);
+        else setTimeout(run, 0);
+      };
+    })()
   };
 })();
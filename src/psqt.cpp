@@ -20,6 +20,7 @@
 
 #include <algorithm>
 
+#include "thread_win32.h"
 #include "types.h"
 
 Value PieceValue[VARIANT_NB][PHASE_NB][PIECE_NB] = {
@@ -736,35 +737,48 @@ Score psq[VARIANT_NB][PIECE_NB][SQUARE_NB];
 
 #undef S
 
-// init() initializes piece-square tables: the white halves of the tables are
-// copied from Bonus[] adding the piece value, then the black halves of the
-// tables are initialized by flipping and changing the sign of the white scores.
-void init() {
+// init() initializes piece-square tables of a variant: the white halves of the
+// tables are copied from Bonus[] adding the piece value, then the black halves
+// of the tables are initialized by flipping and changing the sign of the white
+// scores. Variants are only set up when first played, see UCI_Variant.
+void init(Variant var) {
 
-  for (Variant var = CHESS_VARIANT; var < VARIANT_NB; ++var)
-      for (Piece pc = W_PAWN; pc <= W_KING; ++pc)
-      {
-          PieceValue[var][MG][~pc] = PieceValue[var][MG][pc];
-          PieceValue[var][EG][~pc] = PieceValue[var][EG][pc];
+  static bool initialized[VARIANT_NB];
+  static Mutex mutex; // Engines of the same process may select it at once
+
+  std::lock_guard<Mutex> lock(mutex);
+
+  if (initialized[var])
+      return;
+
+  initialized[var] = true;
+
+  for (Piece pc = W_PAWN; pc <= W_KING; ++pc)
+  {
+      PieceValue[var][MG][~pc] = PieceValue[var][MG][pc];
+      PieceValue[var][EG][~pc] = PieceValue[var][EG][pc];
 
-          Score v = make_score(PieceValue[var][MG][pc], PieceValue[var][EG][pc]);
+      Score v = make_score(PieceValue[var][MG][pc], PieceValue[var][EG][pc]);
 
-          for (Square s = SQ_A1; s <= SQ_H8; ++s)
-          {
-              File f = std::min(file_of(s), FILE_H - file_of(s));
-              psq[var][ pc][ s] = v + Bonus[var][pc][rank_of(s)][f];
+      for (Square s = SQ_A1; s <= SQ_H8; ++s)
+      {
+          File f = std::min(file_of(s), FILE_H - file_of(s));
+          psq[var][ pc][ s] = v + Bonus[var][pc][rank_of(s)][f];
 #ifdef RACE
-              if (var == RACE_VARIANT)
-                  psq[var][~pc][horizontal_flip(s)] = -psq[var][pc][s];
-              else
+          if (var == RACE_VARIANT)
+              psq[var][~pc][horizontal_flip(s)] = -psq[var][pc][s];
+          else
 #endif
-              psq[var][~pc][~s] = -psq[var][pc][s];
-          }
+          psq[var][~pc][~s] = -psq[var][pc][s];
+      }
 #ifdef CRAZYHOUSE
-          psq[var][ pc][SQ_NONE] = v + inHandBonus[type_of(pc)];
-          psq[var][~pc][SQ_NONE] = -psq[var][pc][SQ_NONE];
+      psq[var][ pc][SQ_NONE] = v + inHandBonus[type_of(pc)];
+      psq[var][~pc][SQ_NONE] = -psq[var][pc][SQ_NONE];
 #endif
-      }
+  }
 }
 
+// bytes() returns the size of the tables, for the "memory" command
+size_t bytes() { return sizeof(psq) + sizeof(Bonus); }
+
 } // namespace PSQT
@@ -23,13 +23,17 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstring>   // For std::memset
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
+#include "engine.h"
 #include "evaluate.h"
+#include "mate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
@@ -39,26 +43,16 @@
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
 #include "syzygy/tbprobe.h"
 #endif
 
-namespace Search {
-
-  LimitsType Limits;
-}
-
-namespace Tablebases {
+namespace TB = Tablebases;
 
-  int Cardinality;
-  bool RootInTB;
-  bool UseRule50;
-  Depth ProbeDepth;
-  Value Score;
+namespace PSQT {
+  size_t bytes();
 }
 
-namespace TB = Tablebases;
-
 using std::string;
 using Eval::evaluate;
 using namespace Search;
@@ -263,13 +257,11 @@ namespace {
     Move pv[3];
   };
 
-  EasyMoveManager EasyMove;
-  Value DrawValue[COLOR_NB];
 
-  template <NodeType NT>
+  template <NodeType NT, Variant V>
   Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode, bool skipEarlyPruning);
 
-  template <NodeType NT, bool InCheck>
+  template <NodeType NT, bool InCheck, Variant V>
   Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth = DEPTH_ZERO);
 
   Value value_to_tt(Value v, int ply);
@@ -277,31 +269,270 @@ namespace {
   void update_pv(Move* pv, Move move, Move* childPv);
   void update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus);
   void update_stats(const Position& pos, Stack* ss, Move move, Move* quiets, int quietsCnt, int bonus);
+  Value search_root(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth);
+  Value kth_score(const RootMoves& rootMoves, size_t k);
+
+  // The PV lines last sent to the GUI, and those withheld since because of
+  // "Info Interval". With "Info Coalesce" the withheld lines are merged by
+  // multipv, otherwise only the last batch is kept.
+  struct PVOutput {
+    std::vector<UCI::PVLine> sent, withheld; // Lines sent indexed by multipv - 1
+    TimePoint sentTime;
+  };
+
+  // PerftTable caches the leaf counts of perft subtrees by position key and
+  // depth. An entry holds the key XOR-ed with its data, so that the threads
+  // can share the table without locks and a torn entry is never matched.
+  struct PerftTable {
+
+    struct Entry {
+      Key keyXorData;
+      uint64_t data; // Count << 8 | depth
+    };
+
+    void reset(size_t mbSize) {
+
+      size_t count = mbSize ? (mbSize * 1024 * 1024 / sizeof(Entry)) : 0;
+      while (count & (count - 1)) // Round down to a power of 2
+          count &= count - 1;
+
+      entries.assign(count, Entry());
+    }
+
+    bool probe(Key key, Depth d, uint64_t& count) const {
+
+      if (entries.empty())
+          return false;
+
+      const Entry& e = entries[index(key, d)];
+      uint64_t data = e.data;
+
+      if ((e.keyXorData ^ data) != key || (data & 0xFF) != uint64_t(d))
+          return false;
+
+      count = data >> 8;
+      return true;
+    }
+
+    void store(Key key, Depth d, uint64_t count) {
+
+      if (entries.empty())
+          return;
+
+      Entry& e = entries[index(key, d)];
+      e.data = count << 8 | uint64_t(d);
+      e.keyXorData = key ^ e.data;
+    }
+
+  private:
+    size_t index(Key key, Depth d) const {
+      return size_t(key ^ (uint64_t(d) * 0x9E3779B97F4A7C15ULL)) & (entries.size() - 1);
+    }
+
+    std::vector<Entry> entries;
+
+  public:
+    size_t bytes() const { return entries.size() * sizeof(Entry); }
+  };
+
+  // PerftDivide holds the root moves of a perft to be split between the
+  // threads, and the count and time of each of them once done.
+  struct PerftDivide {
+    std::atomic<size_t> next;
+    std::vector<uint64_t> counts;
+    std::vector<TimePoint> times;
+  };
+
+} // namespace
+
+
+/// Search::State is the part of the search state shared by all the threads of
+/// an engine, instead of kept per thread.
+
+struct Search::State {
+
+  EasyMoveManager easyMove;
+  Value drawValue[COLOR_NB];
+  PVOutput output;
+  PerftTable perftTable;
+  PerftDivide perftDivide;
+  Mate::Table mateTable;
+#ifdef SKILL
+  Skill skill{20}; // Only used by the main thread, set at the start of a search
+#endif
+
+  struct {
+    int Cardinality;
+    bool RootInTB;
+    bool UseRule50;
+    Depth ProbeDepth;
+    Value Score;
+  } tb; // Set by Tablebases::filter_root_moves() at the start of the search
+};
+
+Search::State* Search::new_state() { return new State(); }
+
+void Search::delete_state(State* state) { delete state; }
+
+#define EasyMove  (CurrentEngine->search->easyMove)
+#define DrawValue (CurrentEngine->search->drawValue)
+#define Output    (CurrentEngine->search->output)
+#define TBState   (CurrentEngine->search->tb)
+#define MainSkill (CurrentEngine->search->skill)
+#define PerftTT   (CurrentEngine->search->perftTable)
+#define Divide    (CurrentEngine->search->perftDivide)
+#define MateTT    (CurrentEngine->search->mateTable)
+
+namespace {
+
+  // flush_pv() sends the withheld PV lines to the GUI, as UCI info strings
+  // unless the binary output mode is enabled. With "Info Delta" the lines with
+  // the same move and score as when last sent are left out.
+  void flush_pv(bool chess960) {
+
+    std::vector<UCI::PVLine>& lines = Output.withheld;
+
+    std::sort(lines.begin(), lines.end(), [](const UCI::PVLine& a, const UCI::PVLine& b) {
+        return a.multipv < b.multipv; });
+
+    if (Options["Info Delta"])
+        lines.erase(std::remove_if(lines.begin(), lines.end(), [](const UCI::PVLine& l) {
+                        return   size_t(l.multipv) <= Output.sent.size()
+                              && Output.sent[l.multipv - 1].score == l.score
+                              && Output.sent[l.multipv - 1].pv[0] == l.pv[0]; }),
+                    lines.end());
+
+    if (lines.empty())
+        return;
+
+#ifdef __EMSCRIPTEN__
+    if (!Options["Info Output"].compare("binary"))
+        UCI::pv_records(lines);
+    else
+#endif
+    sync_cout << UCI::pv(lines, chess960) << sync_endl;
+
+    for (const UCI::PVLine& l : lines)
+    {
+        if (size_t(l.multipv) > Output.sent.size())
+            Output.sent.resize(l.multipv);
+        Output.sent[l.multipv - 1] = l;
+    }
+
+    Output.sentTime = now();
+    lines.clear();
+  }
+
+  // send_pv() sends the PV lines to the GUI, unless the last ones were sent
+  // less than "Info Interval" milliseconds ago and the lines are not forced.
+  void send_pv(const Position& pos, Depth depth, Value alpha, Value beta, bool force = false) {
+
+    if (!Options["Info Coalesce"])
+        Output.withheld.clear();
+
+    for (const UCI::PVLine& l : UCI::pv_lines(pos, depth, alpha, beta))
+    {
+        auto it = std::find_if(Output.withheld.begin(), Output.withheld.end(),
+                               [&](const UCI::PVLine& w) { return w.multipv == l.multipv; });
+        if (it != Output.withheld.end())
+            *it = l;
+        else
+            Output.withheld.push_back(l);
+    }
+
+    if (force || now() - Output.sentTime >= int(Options["Info Interval"]))
+        flush_pv(pos.is_chess960());
+  }
+
+#ifdef USE_STATS
+  // count_probe() counts a TT probe as a hit, a miss on an empty entry or a
+  // miss replacing another position. A hit with a TT move that is not legal
+  // here is a key collision that we can detect.
+  void count_probe(Stats& stats, const Position& pos, const TTEntry* tte, bool ttHit) {
+
+    if (!ttHit)
+    {
+        ++stats.ttMisses;
+        ++(tte->empty() ? stats.ttEmpty : stats.ttReplaced);
+    }
+    else
+    {
+        ++stats.ttHits;
+        if (tte->move() && !pos.pseudo_legal(tte->move()))
+            ++stats.ttCollisions;
+    }
+  }
+#endif
+
+  // perft_key() is the key of a position in the perft hash. In crazyhouse the
+  // promoted pieces are not in the position key, but are captured as pawns.
+  Key perft_key(const Position& pos) {
+
+#ifdef CRAZYHOUSE
+    if (pos.is_house())
+        return pos.key() ^ (pos.promoted_pieces() * 0x9E3779B97F4A7C15ULL);
+#endif
+    return pos.key();
+  }
 
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
-  template<bool Root>
+  // Nodes just above the leaves are counted in bulk from their move lists.
   uint64_t perft(Position& pos, Depth depth) {
 
+    if (depth <= ONE_PLY)
+        return MoveList<LEGAL>(pos).size();
+
+    uint64_t nodes = 0;
+
+    if (depth >= 3 * ONE_PLY && PerftTT.probe(perft_key(pos), depth, nodes))
+        return nodes;
+
     StateInfo st;
-    uint64_t cnt, nodes = 0;
-    const bool leaf = (depth == 2 * ONE_PLY);
 
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= ONE_PLY)
-            cnt = 1, nodes++;
-        else
+        pos.do_move(m, st);
+        nodes += perft(pos, depth - ONE_PLY);
+        pos.undo_move(m);
+    }
+
+    if (depth >= 3 * ONE_PLY)
+        PerftTT.store(perft_key(pos), depth, nodes);
+
+    return nodes;
+  }
+
+  // perft_root_moves() is run by all the threads for a "go perft". Each one
+  // takes the next root move not yet taken by another, until none is left.
+  void perft_root_moves(Thread* th) {
+
+    Depth depth = Limits.perft * ONE_PLY;
+    Position& pos = th->rootPos;
+    uint64_t nodes = 0;
+    size_t i;
+    StateInfo st;
+
+    while ((i = Divide.next++) < th->rootMoves.size())
+    {
+        Move m = th->rootMoves[i].pv[0];
+        TimePoint start = now();
+
+        uint64_t cnt = 1;
+
+        if (depth > ONE_PLY)
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - ONE_PLY);
-            nodes += cnt;
+            cnt = perft(pos, depth - ONE_PLY);
             pos.undo_move(m);
         }
-        if (Root)
-            sync_cout << UCI::move(m, pos.is_chess960()) << ": " << cnt << sync_endl;
+
+        Divide.counts[i] = cnt;
+        Divide.times[i] = now() - start;
+        nodes += cnt;
     }
-    return nodes;
+
+    th->nodes = nodes; // Leaf nodes, instead of the moves made
   }
 
 } // namespace
@@ -359,12 +590,15 @@ void Search::init() {
 
 void Search::clear() {
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_THREADS
   Threads.main()->wait_for_search_finished();
 #endif
 
   Time.availableNodes = 0;
-  TT.clear();
+  MateTT.resize(0); // Reallocated by the next "go mate"
+
+  if (&TT == &CurrentEngine->ownTT) // A shared table is cleared by its owner
+      TT.clear();
 
   for (Thread* th : Threads)
       th->clear();
@@ -374,27 +608,191 @@ void Search::clear() {
 }
 
 
+#ifdef USE_STATS
+/// Search::Stats::operator+=() adds the counters of another thread, knowing
+/// that Stats holds nothing but uint64_t counters.
+
+Stats& Stats::operator+=(const Stats& s) {
+
+  static_assert(sizeof(Stats) % sizeof(uint64_t) == 0, "Stats must hold only counters");
+
+  const uint64_t* src = reinterpret_cast<const uint64_t*>(&s);
+  uint64_t* dst = reinterpret_cast<uint64_t*>(this);
+
+  for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); ++i)
+      dst[i] += src[i];
+
+  return *this;
+}
+
+
+/// Search::print_stats() prints the counters of all the threads added up,
+/// together with the hit rates of the pawn and material hash tables.
+
+void Search::print_stats(std::ostream& os) {
+
+  const char* PruneNames[] = {
+    "razoring", "futility", "null move", "probcut", "move count",
+    "countermove history", "futility parent", "see quiet", "see capture",
+    "qsearch futility", "qsearch see"
+  };
+  static_assert(sizeof(PruneNames) / sizeof(*PruneNames) == Stats::PRUNE_NB, "Missing prune name");
+
+  Stats s = Stats();
+  uint64_t hits[4] = {}, misses[4] = {};
+
+  for (Thread* th : Threads)
+  {
+      s += th->stats;
+      hits[0] += th->pawnsTable.hits;
+      hits[1] += th->materialTable.hits;
+      misses[0] += th->pawnsTable.misses;
+      misses[1] += th->materialTable.misses;
+      hits[2] += th->evalTable.hits;
+      misses[2] += th->evalTable.misses;
+#ifndef NO_SYZYGY
+      hits[3] += th->tbCache.hits;
+      misses[3] += th->tbCache.misses;
+#endif
+  }
+
+  auto pct = [](uint64_t n, uint64_t total) { return 100.0 * n / std::max(total, uint64_t(1)); };
+  uint64_t nodes = s.nodes + s.qnodes, probes = s.ttHits + s.ttMisses;
+
+  os << std::fixed << std::setprecision(1)
+     << "Nodes           : " << nodes << ", qsearch " << pct(s.qnodes, nodes) << "%"
+     << "\nTT probes       : " << probes << ", hits " << pct(s.ttHits, probes) << "%"
+     << ", collisions " << pct(s.ttCollisions, s.ttHits) << "% of hits"
+     << "\nTT misses       : " << s.ttMisses << ", on empty entries " << pct(s.ttEmpty, s.ttMisses) << "%"
+     << ", replacing " << pct(s.ttReplaced, s.ttMisses) << "%"
+     << "\nTT layout       : " << TranspositionTable::cluster_size() << " entries with "
+     << 8 * sizeof(TTEntry::KeyBits) << "-bit keys per " << TranspositionTable::cluster_bytes()
+     << " bytes, hashfull " << TT.hashfull()
+     << "\nPawn hash hits  : " << pct(hits[0], hits[0] + misses[0]) << "% of " << hits[0] + misses[0]
+     << "\nMat. hash hits  : " << pct(hits[1], hits[1] + misses[1]) << "% of " << hits[1] + misses[1]
+     << "\nEval hash hits  : " << pct(hits[2], hits[2] + misses[2]) << "% of " << hits[2] + misses[2]
+     << "\nTB cache hits   : " << pct(hits[3], hits[3] + misses[3]) << "% of " << hits[3] + misses[3];
+
+  for (Variant v = CHESS_VARIANT; v < VARIANT_NB; ++v)
+      if (s.evalHits[v] + s.evalMisses[v])
+          os << "\n  " << std::left << std::setw(20) << variants[v] << std::right << ": "
+             << pct(s.evalHits[v], s.evalHits[v] + s.evalMisses[v]) << "% of "
+             << s.evalHits[v] + s.evalMisses[v];
+
+  os << "\nLMR searches    : " << s.reduced << ", failing high " << pct(s.researched, s.reduced) << "%"
+     << "\nPruned by";
+
+  for (int i = 0; i < Stats::PRUNE_NB; ++i)
+      os << "\n  " << std::left << std::setw(20) << PruneNames[i] << std::right << ": " << s.pruned[i];
+
+  os << "\nCutoffs         : " << s.cutoffs << "\nCutoffs by stage";
+
+  // Several stages name the TT move, add them up in the order of first use
+  std::vector<std::pair<string, uint64_t>> stages;
+
+  for (int i = 0; i < MovePicker::StageNb; ++i)
+      if (const char* name = MovePicker::stage_name(i))
+      {
+          auto it = std::find_if(stages.begin(), stages.end(),
+                                 [&](const std::pair<string, uint64_t>& p) { return p.first == name; });
+          if (it == stages.end())
+              stages.emplace_back(name, s.cutoffStage[i]);
+          else
+              it->second += s.cutoffStage[i];
+      }
+
+  for (const auto& p : stages)
+      os << "\n  " << std::left << std::setw(20) << p.first << std::right << ": "
+         << pct(p.second, s.cutoffs) << "%";
+
+  os << "\nCutoffs by move index";
+
+  for (int i = 0; i < Stats::CutoffIndexNb; ++i)
+      os << "\n  " << i + 1 << (i == Stats::CutoffIndexNb - 1 ? "+" : " ")
+         << "                 : " << pct(s.cutoffIndex[i], s.cutoffs) << "%";
+}
+#endif
+
+
+/// Search::print_memory() prints the bytes held by each part of the engine as
+/// a JSON object, the per thread parts added up over the threads. The move
+/// pickers are on the stack, for a search down to MAX_PLY, and the endgames
+/// are estimated from the number of map nodes.
+
+void Search::print_memory(std::ostream& os) {
+
+  size_t pawns = 0, material = 0, eval = 0, tbCache = 0, histories = 0, threads = 0, endgames = 0;
+
+  for (Thread* th : Threads)
+  {
+      pawns += th->pawnsTable.bytes();
+      material += th->materialTable.bytes();
+      eval += th->evalTable.bytes();
+#ifndef NO_SYZYGY
+      tbCache += th->tbCache.bytes();
+#endif
+      histories += sizeof(th->counterMoves) + sizeof(th->mainHistory) + sizeof(th->contHistory);
+      threads += (th == Threads.main() ? sizeof(MainThread) : sizeof(Thread));
+      endgames += th->endgames.bytes();
+  }
+
+  threads -= histories; // Held by the Thread objects, but counted apart
+
+  std::pair<const char*, size_t> parts[] = {
+    { "tt", TT.bytes() },
+    { "pawns", pawns },
+    { "material", material },
+    { "eval", eval },
+    { "tbcache", tbCache },
+    { "histories", histories },
+    { "threads", threads },
+    { "movepickers", Threads.size() * MAX_PLY * sizeof(MovePicker) },
+    { "endgames", endgames },
+    { "sliders", Bitboards::slider_bytes() },
+    { "kpk", Bitbases::bytes() },
+    { "psqt", PSQT::bytes() },
+    { "book", CurrentEngine->book.bytes() },
+    { "perft", PerftTT.bytes() },
+    { "mate", MateTT.bytes() },
+    { "store", CurrentEngine->store.bytes() }
+  };
+
+  size_t total = 0;
+  os << "{";
+
+  for (const auto& p : parts)
+  {
+      os << "\"" << p.first << "\":" << p.second << ",";
+      total += p.second;
+  }
+
+  os << "\"total\":" << total << "}";
+}
+
+
 /// MainThread::search() is called by the main thread when the program receives
 /// the UCI 'go' command. It searches from the root position and outputs the "bestmove".
 
-Color us_;
-
 void MainThread::search() {
 
   if (Limits.perft)
   {
-      nodes = perft<true>(rootPos, Limits.perft * ONE_PLY);
-      sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+      perft();
       return;
   }
 
-  us_ = rootPos.side_to_move();
-  Time.init(Limits, us_, rootPos.game_ply());
+#ifdef NO_THREADS
+  scheduler_wait(); // Reset
+#endif
+
+  Output = PVOutput();
+  Color us = rootPos.side_to_move();
+  Time.init(Limits, us, rootPos.game_ply());
   TT.new_search();
 
   int contempt = Options["Contempt"] * PawnValueEg / 100; // From centipawns
-  DrawValue[ us_] = VALUE_DRAW - Value(contempt);
-  DrawValue[~us_] = VALUE_DRAW + Value(contempt);
+  DrawValue[ us] = VALUE_DRAW - Value(contempt);
+  DrawValue[~us] = VALUE_DRAW + Value(contempt);
 
   if (rootMoves.empty())
   {
@@ -402,7 +800,17 @@ void MainThread::search() {
       Value score = rootPos.is_variant_end() ? rootPos.variant_result()
                    : rootPos.checkers() ? rootPos.checkmate_value()
                    : rootPos.stalemate_value();
-      sync_cout << "info depth 0 score " << UCI::value(score) << sync_endl;
+      rootMoves[0].score = score;
+
+      if (!Limits.silent)
+          sync_cout << "info depth 0 score " << UCI::value(score) << sync_endl;
+  }
+  else if (   Limits.mate
+           && Limits.searchmoves.empty()
+           && !Options["Mate Search"].compare("proof-number"))
+  {
+      mate_search();
+      return;
   }
   else
   {
@@ -411,7 +819,85 @@ void MainThread::search() {
               th->start_searching();
 
       Thread::search(); // Let's start searching!
+      return;
   }
+
+  after_search(); // Send "bestmove (none)"
+}
+
+
+/// MainThread::mate_search() answers a "go mate N" with a proof-number search,
+/// see mate.cpp, when "Mate Search" is "proof-number". The main thread searches
+/// alone, and sends the proof as the PV.
+
+void MainThread::mate_search() {
+
+  size_t count = size_t(Options["Mate Hash"]) * 1024 * 1024 / sizeof(Mate::Entry);
+  while (count & (count - 1)) // Round down to a power of 2
+      count &= count - 1;
+
+  MateTT.resize(count);
+  PVIdx = 0;
+
+  // As in alpha-beta, a mate in N may end after the reply of the defender, as
+  // when the defender must capture the last piece in antichess.
+  Mate::Result r = Mate::solve(rootPos, std::min(2 * Limits.mate, MAX_PLY - 1), MateTT);
+
+  if (r.proven && !r.pv.empty())
+  {
+      std::swap(rootMoves[0], *std::find(rootMoves.begin(), rootMoves.end(), r.pv[0]));
+      rootMoves[0].pv = r.pv;
+      rootMoves[0].score = mate_in(int(r.pv.size()));
+      rootMoves[0].selDepth = int(r.pv.size());
+      completedDepth = int(r.pv.size()) * ONE_PLY;
+
+      if (!Limits.silent)
+          send_pv(rootPos, completedDepth, -VALUE_INFINITE, VALUE_INFINITE, true);
+  }
+  else if (!Limits.silent)
+      sync_cout << "info string " << (r.disproven ? "No mate in " : "Stopped before finding a mate in ")
+                << Limits.mate << sync_endl;
+
+  after_search();
+}
+
+/// MainThread::perft() runs a "go perft" with the root moves split between
+/// the threads, then prints the leaf count of each move with the time it took,
+/// the total and the speed.
+
+void MainThread::perft() {
+
+  TimePoint elapsed = now();
+  size_t n = rootMoves.size();
+
+  PerftTT.reset(Options["Perft Hash"]);
+  Divide.next = 0;
+  Divide.counts.assign(n, 0);
+  Divide.times.assign(n, 0);
+
+  for (Thread* th : Threads)
+      if (th != this)
+          th->start_searching();
+
+  perft_root_moves(this);
+
+  for (Thread* th : Threads)
+      if (th != this)
+          th->wait_for_search_finished();
+
+  elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+  uint64_t searched = Threads.nodes_searched();
+
+  if (Limits.silent)
+      return;
+
+  for (size_t i = 0; i < n; ++i)
+      sync_cout << UCI::move(rootMoves[i].pv[0], rootPos.is_chess960()) << ": "
+                << Divide.counts[i] << " (" << Divide.times[i] << " ms)" << sync_endl;
+
+  sync_cout << "\nNodes searched: " << searched
+            << "\nTime (ms)     : " << elapsed
+            << "\nNodes/second  : " << 1000 * searched / elapsed << "\n" << sync_endl;
 }
 
 void MainThread::after_search() {
@@ -423,7 +909,7 @@ void MainThread::after_search() {
   // until the GUI sends one of those commands (which also raises Threads.stop).
   Threads.stopOnPonderhit = true;
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_THREADS
   while (!Threads.stop && (Threads.ponder || Limits.infinite))
   {} // Busy wait for a stop or a ponder reset
 #endif
@@ -440,10 +926,10 @@ void MainThread::after_search() {
   // When playing in 'nodes as time' mode, subtract the searched nodes from
   // the available ones before exiting.
   if (Limits.npmsec)
-      Time.availableNodes += Limits.inc[us_] - Threads.nodes_searched();
+      Time.availableNodes += Limits.inc[rootPos.side_to_move()] - Threads.nodes_searched();
 
   // Check if there are threads with a better score than main thread
-  Thread* bestThread = this;
+  bestThread = this;
 #ifdef USELONGESTPV
   size_t longestPlies = 0;
   Thread* longestPVThread = this;
@@ -516,22 +1002,50 @@ void MainThread::after_search() {
 
   previousScore = bestThread->rootMoves[0].score;
 
+  if (Limits.silent)
+  {
+#ifdef NO_THREADS
+      if (Threads.searchFinished)
+          Threads.searchFinished();
+#endif
+      return;
+  }
+
 #ifdef USELONGESTPV
   if (longestPVThread != this)
-      sync_cout << UCI::pv(longestPVThread->rootPos, longestPVThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+      send_pv(longestPVThread->rootPos, longestPVThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE, true);
 #else
   // Send new PV when needed
   if (bestThread != this)
-      sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+      send_pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE, true);
+#endif
+
+  flush_pv(rootPos.is_chess960()); // Lines withheld because of "Info Interval"
+
+#ifdef NO_THREADS
+  // Time spent waiting for the event loop, instead of searching
+  sync_cout << "info string scheduler wait " << int(scheduler_wait()) << " ms" << sync_endl;
+#endif
+
+  Time.played();
+
+#ifndef __EMSCRIPTEN__
+  if (!Output.sent.empty() && ResultStore::applies(Limits))
+      CurrentEngine->store.save(rootPos, Output.sent[0]);
 #endif
 
   // Best move could be MOVE_NONE when searching on a terminal position
   sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
 
   if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
-      std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
+      engine_out() << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
+
+  engine_out() << sync_endl;
 
-  std::cout << sync_endl;
+#ifdef NO_THREADS
+  if (Threads.searchFinished)
+      Threads.searchFinished();
+#endif
 }
 
 
@@ -539,74 +1053,81 @@ void MainThread::after_search() {
 /// repeatedly with increasing depth until the allocated thinking time has been
 /// consumed, the user stops the search, or the maximum search depth is reached.
 
-Stack stack_[MAX_PLY+7], *ss_ = stack_ + 4; // To reference from (ss-4) and (ss+2)
-Value bestValue_, alpha_, beta_, delta_;
-Move easyMove_;
-MainThread* mainThread_;
-size_t multiPV_;
-#ifdef SKILL
-Skill skill_(Options["Skill Level"]);
-#endif
-
 void search_iteration_call(void *thread) {
+  CurrentEngine = ((Thread *)thread)->engine;
   ((Thread *)thread)->search_iteration();
 }
 
 void after_search_call(void *mainThread) {
+  CurrentEngine = ((MainThread *)mainThread)->engine;
   ((MainThread *)mainThread)->after_search();
 }
 
 void Thread::search() {
-  easyMove_ = MOVE_NONE;
-  mainThread_ = (this == Threads.main() ? Threads.main() : nullptr);
 
-  std::memset(ss_-4, 0, 7 * sizeof(Stack));
+  if (Limits.perft)
+  {
+      perft_root_moves(this);
+      return;
+  }
+
+  MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
+
+  ss = stack + 4;
+  easyMove = MOVE_NONE;
+
+  std::memset(ss-4, 0, 7 * sizeof(Stack));
   for (int i = 4; i > 0; i--)
-     (ss_-i)->contHistory = &this->contHistory[NO_PIECE][0]; // Use as sentinel
+     (ss-i)->contHistory = this->contHistory.at(NO_PIECE, SQ_A1); // Use as sentinel
 
-  bestValue_ = delta_ = alpha_ = -VALUE_INFINITE;
-  beta_ = VALUE_INFINITE;
+  bestValue = delta = alpha = -VALUE_INFINITE;
+  beta = VALUE_INFINITE;
 
-  if (mainThread_)
+  if (mainThread)
   {
-      easyMove_ = EasyMove.get(rootPos.key());
+      easyMove = EasyMove.get(rootPos.key());
       EasyMove.clear();
-      mainThread_->easyMovePlayed = mainThread_->failedLow = false;
-      mainThread_->bestMoveChanges = 0;
+      mainThread->easyMovePlayed = mainThread->failedLow = false;
+      mainThread->bestMoveChanges = 0;
   }
 
-  multiPV_ = Options["MultiPV"];
+  multiPV = Options["MultiPV"];
 #ifdef SKILL
-  skill_ = Skill(Options["Skill Level"]);
+  Skill skill(Options["Skill Level"]);
+  if (mainThread)
+      MainSkill = skill;
 
   // When playing with strength handicap enable MultiPV search that we will
   // use behind the scenes to retrieve a set of possible moves.
-  if (skill_.enabled())
-      multiPV_ = std::max(multiPV_, (size_t)4);
+  if (skill.enabled())
+      multiPV = std::max(multiPV, (size_t)4);
 #endif
 
-  multiPV_ = std::min(multiPV_, rootMoves.size());
+  multiPV = std::min(multiPV, rootMoves.size());
+  sharedMultiPV = multiPV > 1 && !Options["MultiPV Mode"].compare("shared");
 
-#ifdef __EMSCRIPTEN__
-  emscripten_async_call(search_iteration_call, this, 0);
+#ifdef NO_THREADS
+  schedule(search_iteration_call, this);
 #else
   search_iteration();
 #endif
 }
 
 void Thread::search_iteration() {
+  MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
+
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   (rootDepth += ONE_PLY) < DEPTH_MAX
          && !Threads.stop
-         && !(Limits.depth && mainThread_ && rootDepth / ONE_PLY > Limits.depth))
+         && !(Limits.depth && mainThread && rootDepth / ONE_PLY > Limits.depth))
   {
       // Distribute search depths across the threads
       if (idx)
       {
           int i = (idx - 1) % 20;
           if (((rootDepth / ONE_PLY + rootPos.game_ply() + skipPhase[i]) / skipSize[i]) % 2) {
-#ifdef __EMSCRIPTEN__
-              emscripten_async_call(search_iteration_call, this, 0);
+#ifdef NO_THREADS
+              schedule(search_iteration_call, this);
 #else
               search_iteration();
 #endif
@@ -615,26 +1136,32 @@ void Thread::search_iteration() {
       }
 
       // Age out PV variability metric
-      if (mainThread_)
-          mainThread_->bestMoveChanges *= 0.505, mainThread_->failedLow = false;
+      if (mainThread)
+          mainThread->bestMoveChanges *= 0.505, mainThread->failedLow = false;
 
       // Save the last iteration's scores before first PV line is searched and
       // all the move scores except the (new) PV are set to -VALUE_INFINITE.
       for (RootMove& rm : rootMoves)
           rm.previousScore = rm.score;
 
-      // MultiPV loop. We perform a full root search for each PV line
-      for (PVIdx = 0; PVIdx < multiPV_ && !Threads.stop; ++PVIdx)
+      // MultiPV loop. We perform a full root search for each PV line. With a
+      // shared window, the first search looks for all the lines at once: its
+      // window starts at the previous score of the last line, and the root
+      // raises alpha to the score of the last line found so far, see search().
+      // The lines not found above alpha are then searched one by one.
+      for (PVIdx = 0; PVIdx < multiPV && !Threads.stop; ++PVIdx)
       {
+          pvLast = sharedMultiPV && !PVIdx ? multiPV - 1 : PVIdx;
+
           // Reset UCI info selDepth for each depth and each PV line
           selDepth = 0;
 
           // Reset aspiration window starting size
           if (rootDepth >= 5 * ONE_PLY)
           {
-              delta_ = Value(18);
-              alpha_ = std::max(rootMoves[PVIdx].previousScore - delta_,-VALUE_INFINITE);
-              beta_  = std::min(rootMoves[PVIdx].previousScore + delta_, VALUE_INFINITE);
+              delta = Value(18);
+              alpha = std::max(rootMoves[pvLast].previousScore - delta,-VALUE_INFINITE);
+              beta  = std::min(rootMoves[PVIdx].previousScore + delta, VALUE_INFINITE);
           }
 
           // Start with a small aspiration window and, in the case of a fail
@@ -642,7 +1169,12 @@ void Thread::search_iteration() {
           // high/low anymore.
           while (true)
           {
-              bestValue_ = ::search<PV>(rootPos, ss_, alpha_, beta_, rootDepth, false, false);
+              // The lines of a shared window are found anew by each search
+              if (pvLast > PVIdx)
+                  for (RootMove& rm : rootMoves)
+                      rm.score = -VALUE_INFINITE;
+
+              bestValue = search_root(rootPos, ss, alpha, beta, rootDepth);
 
               // Bring the best move to the front. It is critical that sorting
               // is done with a stable algorithm because all the values but the
@@ -660,41 +1192,48 @@ void Thread::search_iteration() {
 
               // When failing high/low give some update (without cluttering
               // the UI) before a re-search.
-              if (   mainThread_
-                  && multiPV_ == 1
-                  && (bestValue_ <= alpha_ || bestValue_ >= beta_)
+              if (   mainThread
+                  && !Limits.silent
+                  && multiPV == 1
+                  && (bestValue <= alpha || bestValue >= beta)
                   && Time.elapsed() > 3000)
-                  sync_cout << UCI::pv(rootPos, rootDepth, alpha_, beta_) << sync_endl;
+                  send_pv(rootPos, rootDepth, alpha, beta);
 
               // In case of failing low/high increase aspiration window and
               // re-search, otherwise exit the loop.
-              if (bestValue_ <= alpha_)
+              if (bestValue <= alpha)
               {
-                  beta_ = (alpha_ + beta_) / 2;
-                  alpha_ = std::max(bestValue_ - delta_, -VALUE_INFINITE);
+                  beta = (alpha + beta) / 2;
+                  alpha = std::max(bestValue - delta, -VALUE_INFINITE);
 
-                  if (mainThread_)
+                  if (mainThread)
                   {
-                      mainThread_->failedLow = true;
+                      mainThread->failedLow = true;
                       Threads.stopOnPonderhit = false;
                   }
               }
-              else if (bestValue_ >= beta_)
-                  beta_ = std::min(bestValue_ + delta_, VALUE_INFINITE);
+              else if (bestValue >= beta)
+                  beta = std::min(bestValue + delta, VALUE_INFINITE);
               else
                   break;
 
-              delta_ += delta_ / 4 + 5;
+              delta += delta / 4 + 5;
 
               assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
           }
 
+          // Keep the lines a shared window found, up to the first failing low
+          if (pvLast > PVIdx && !Threads.stop)
+              while (PVIdx < pvLast && rootMoves[PVIdx + 1].score > alpha)
+                  ++PVIdx;
+
           // Sort the PV lines searched so far and update the GUI
           std::stable_sort(rootMoves.begin(), rootMoves.begin() + PVIdx + 1);
 
-          if (    mainThread_
-              && (Threads.stop || PVIdx + 1 == multiPV_ || Time.elapsed() > 3000))
-              sync_cout << UCI::pv(rootPos, rootDepth, alpha_, beta_) << sync_endl;
+          if (    mainThread
+              && !Limits.silent
+              && (Threads.stop || PVIdx + 1 == multiPV || Time.elapsed() > 3000))
+              send_pv(rootPos, rootDepth, alpha, beta);
       }
 
       if (!Threads.stop)
@@ -702,13 +1241,13 @@ void Thread::search_iteration() {
 
       // Have we found a "mate in x"?
       if (   Limits.mate
-          && bestValue_ >= VALUE_MATE_IN_MAX_PLY
-          && VALUE_MATE - bestValue_ <= 2 * Limits.mate)
+          && bestValue >= VALUE_MATE_IN_MAX_PLY
+          && VALUE_MATE - bestValue <= 2 * Limits.mate)
           Threads.stop = true;
 
-      if (!mainThread_) {
-#ifdef __EMSCRIPTEN__
-          emscripten_async_call(search_iteration_call, this, 0);
+      if (!mainThread) {
+#ifdef NO_THREADS
+          schedule(search_iteration_call, this);
 #else
           search_iteration();
 #endif
@@ -717,8 +1256,8 @@ void Thread::search_iteration() {
 
       // If skill level is enabled and time is up, pick a sub-optimal best move
 #ifdef SKILL
-      if (skill_.enabled() && skill_.time_to_pick(rootDepth))
-          skill_.pick_best(multiPV_);
+      if (MainSkill.enabled() && MainSkill.time_to_pick(rootDepth))
+          MainSkill.pick_best(multiPV);
 #endif
 
       // Do we have time for the next iteration? Can we stop searching now?
@@ -729,19 +1268,19 @@ void Thread::search_iteration() {
               // Stop the search if only one legal move is available, or if all
               // of the available time has been used, or if we matched an easyMove
               // from the previous search and just did a fast verification.
-              const int F[] = { mainThread_->failedLow,
-                                bestValue_ - mainThread_->previousScore };
+              const int F[] = { mainThread->failedLow,
+                                bestValue - mainThread->previousScore };
 
               int improvingFactor = std::max(229, std::min(715, 357 + 119 * F[0] - 6 * F[1]));
-              double unstablePvFactor = 1 + mainThread_->bestMoveChanges;
+              double unstablePvFactor = 1 + mainThread->bestMoveChanges;
 
-              bool doEasyMove =   rootMoves[0].pv[0] == easyMove_
-                               && mainThread_->bestMoveChanges < 0.03
+              bool doEasyMove =   rootMoves[0].pv[0] == easyMove
+                               && mainThread->bestMoveChanges < 0.03
                                && Time.elapsed() > Time.optimum() * 5 / 44;
 
               if (   rootMoves.size() == 1
                   || Time.elapsed() > Time.optimum() * unstablePvFactor * improvingFactor / 628
-                  || (mainThread_->easyMovePlayed = doEasyMove, doEasyMove))
+                  || (mainThread->easyMovePlayed = doEasyMove, doEasyMove))
               {
                   // If we are allowed to ponder do not stop the search now but
                   // keep pondering until the GUI sends "ponderhit" or "stop".
@@ -758,34 +1297,34 @@ void Thread::search_iteration() {
               EasyMove.clear();
       }
 
-#ifdef __EMSCRIPTEN__
-      emscripten_async_call(search_iteration_call, this, 0);
+#ifdef NO_THREADS
+      schedule(search_iteration_call, this);
 #else
       search_iteration();
 #endif
       return;
   }
 
-  if (!mainThread_)
+  if (!mainThread)
       return;
 
   // Clear any candidate easy move that wasn't stable for the last search
   // iterations; the second condition prevents consecutive fast moves.
-  if (EasyMove.stableCnt < 6 || mainThread_->easyMovePlayed)
+  if (EasyMove.stableCnt < 6 || mainThread->easyMovePlayed)
       EasyMove.clear();
 
 #ifdef SKILL
   // If skill level is enabled, swap best PV line with the sub-optimal one
-  if (skill_.enabled())
+  if (MainSkill.enabled())
       std::swap(rootMoves[0], *std::find(rootMoves.begin(),
-                rootMoves.end(), skill_.best_move(multiPV_)));
+                rootMoves.end(), MainSkill.best_move(multiPV)));
 #endif
 
-  if (mainThread_) {
-#ifdef __EMSCRIPTEN__
-      emscripten_async_call(after_search_call, mainThread_, 0);
+  if (mainThread) {
+#ifdef NO_THREADS
+      schedule(after_search_call, mainThread);
 #else
-      mainThread_->after_search();
+      mainThread->after_search();
 #endif
   }
 }
@@ -794,9 +1333,43 @@ void Thread::search_iteration() {
 
 namespace {
 
+  // kth_score() returns the k-th best score of the root moves which have one
+  // in the current search, or -VALUE_INFINITE if there are fewer than k.
+
+  Value kth_score(const RootMoves& rootMoves, size_t k) {
+
+    std::vector<Value> scores;
+
+    for (const RootMove& rm : rootMoves)
+        if (rm.score != -VALUE_INFINITE)
+            scores.push_back(rm.score);
+
+    if (scores.size() < k)
+        return -VALUE_INFINITE;
+
+    std::nth_element(scores.begin(), scores.begin() + k - 1, scores.end(), std::greater<Value>());
+    return scores[k - 1];
+  }
+
+
+  // search_root() calls search() instantiated for the variant of the root
+  // position. Each variant is thus searched without testing the variant at
+  // every node, and standard chess doesn't pay for the other variants.
+
+  template<Variant V> struct SearchRoot {
+    static Value call(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
+      return search<PV, V>(pos, ss, alpha, beta, depth, false, false);
+    }
+  };
+
+  Value search_root(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
+    return dispatch<SearchRoot>(pos.variant(), pos, ss, alpha, beta, depth);
+  }
+
+
   // search<>() is the main search function for both PV and non-PV nodes
 
-  template <NodeType NT>
+  template <NodeType NT, Variant V>
   Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode, bool skipEarlyPruning) {
 
     const bool PvNode = NT == PV;
@@ -822,6 +1395,8 @@ namespace {
 
     // Step 1. Initialize node
     Thread* thisThread = pos.this_thread();
+    STATS(Stats& stats = thisThread->stats);
+    STATS(++stats.nodes);
     inCheck = pos.checkers();
     moveCount = quietCount = ss->moveCount = 0;
     ss->statScore = 0;
@@ -842,7 +1417,7 @@ namespace {
 
         // Step 2. Check for aborted search and immediate draw
         if (Threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
-            return ss->ply >= MAX_PLY && !inCheck ? evaluate(pos)
+            return ss->ply >= MAX_PLY && !inCheck ? evaluate<V>(pos)
                                                   : DrawValue[pos.side_to_move()];
 
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
@@ -861,7 +1436,7 @@ namespace {
 
     (ss+1)->ply = ss->ply + 1;
     ss->currentMove = (ss+1)->excludedMove = bestMove = MOVE_NONE;
-    ss->contHistory = &thisThread->contHistory[NO_PIECE][0];
+    ss->contHistory = thisThread->contHistory.at(NO_PIECE, SQ_A1);
     (ss+2)->killers[0] = (ss+2)->killers[1] = MOVE_NONE;
     Square prevSq = to_sq((ss-1)->currentMove);
 
@@ -871,6 +1446,7 @@ namespace {
     excludedMove = ss->excludedMove;
     posKey = pos.key() ^ Key(excludedMove);
     tte = TT.probe(posKey, ttHit);
+    STATS(count_probe(stats, pos, tte, ttHit));
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
     ttMove =  rootNode ? thisThread->rootMoves[thisThread->PVIdx].pv[0]
             : ttHit    ? tte->move() : MOVE_NONE;
@@ -906,40 +1482,40 @@ namespace {
         return ttValue;
     }
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
     // Step 4a. Tablebase probe
 #ifdef KOTH
-    if (pos.is_koth()) {} else
+    if (V == KOTH_VARIANT) {} else
 #endif
 #ifdef LOSERS
-    if (pos.is_losers()) {} else
+    if (V == LOSERS_VARIANT) {} else
 #endif
 #ifdef RACE
-    if (pos.is_race()) {} else
+    if (V == RACE_VARIANT) {} else
 #endif
 #ifdef THREECHECK
-    if (pos.is_three_check()) {} else
+    if (V == THREECHECK_VARIANT) {} else
 #endif
 #ifdef HORDE
-    if (pos.is_horde()) {} else
+    if (V == HORDE_VARIANT) {} else
 #endif
-    if (!rootNode && TB::Cardinality)
+    if (!rootNode && TBState.Cardinality)
     {
         int piecesCount = pos.count<ALL_PIECES>();
 
-        if (    piecesCount <= TB::Cardinality
-            && (piecesCount <  TB::Cardinality || depth >= TB::ProbeDepth)
+        if (    piecesCount <= TBState.Cardinality
+            && (piecesCount <  TBState.Cardinality || depth >= TBState.ProbeDepth)
             &&  pos.rule50_count() == 0
             && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore v = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore v = Tablebases::probe_wdl(pos, &err, thisThread->tbCache);
 
-            if (err != TB::ProbeState::FAIL)
+            if (err != TB::ProbeState::FAIL) // Cached or not, it is a tablebase hit
             {
                 thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
 
-                int drawScore = TB::UseRule50 ? 1 : 0;
+                int drawScore = TBState.UseRule50 ? 1 : 0;
 
                 value =  v < -drawScore ? -VALUE_MATE + MAX_PLY + ss->ply + 1
                        : v >  drawScore ?  VALUE_MATE - MAX_PLY - ss->ply - 1
@@ -953,7 +1529,7 @@ namespace {
             }
         }
     }
-#endif  // ifndef __EMSCRIPTEN__
+#endif  // ifndef NO_SYZYGY
 
     // Step 5. Evaluate the position statically
     if (inCheck)
@@ -966,7 +1542,7 @@ namespace {
     {
         // Never assume anything on values stored in TT
         if ((ss->staticEval = eval = tte->eval()) == VALUE_NONE)
-            eval = ss->staticEval = evaluate(pos);
+            eval = ss->staticEval = evaluate<V>(pos);
 
         // Can ttValue be used as a better position evaluation?
         if (   ttValue != VALUE_NONE
@@ -976,18 +1552,18 @@ namespace {
     else
     {
         eval = ss->staticEval =
-        (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
-                                         : -(ss-1)->staticEval + 2 * Eval::Tempo[pos.variant()];
+        (ss-1)->currentMove != MOVE_NULL ? evaluate<V>(pos)
+                                         : -(ss-1)->staticEval + 2 * Eval::Tempo[V];
 
         tte->save(posKey, VALUE_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE,
                   ss->staticEval, TT.generation());
     }
 #ifdef ANTI
-    if (pos.is_anti() && pos.can_capture())
+    if (V == ANTI_VARIANT && pos.can_capture())
         goto moves_loop;
 #endif
 #ifdef LOSERS
-    if (pos.is_losers() && pos.can_capture_losers())
+    if (V == LOSERS_VARIANT && pos.can_capture_losers())
         goto moves_loop;
 #endif
 
@@ -997,32 +1573,41 @@ namespace {
     // Step 6. Razoring (skipped when in check)
     if (   !PvNode
         &&  depth < 4 * ONE_PLY
-        &&  eval + razor_margin[pos.variant()][depth / ONE_PLY] <= alpha)
+        &&  eval + razor_margin[V][depth / ONE_PLY] <= alpha)
     {
         if (depth <= ONE_PLY)
-            return qsearch<NonPV, false>(pos, ss, alpha, alpha+1);
+        {
+            STATS(++stats.pruned[Stats::RAZORING]);
+            return qsearch<NonPV, false, V>(pos, ss, alpha, alpha+1);
+        }
 
-        Value ralpha = alpha - razor_margin[pos.variant()][depth / ONE_PLY];
-        Value v = qsearch<NonPV, false>(pos, ss, ralpha, ralpha+1);
+        Value ralpha = alpha - razor_margin[V][depth / ONE_PLY];
+        Value v = qsearch<NonPV, false, V>(pos, ss, ralpha, ralpha+1);
         if (v <= ralpha)
+        {
+            STATS(++stats.pruned[Stats::RAZORING]);
             return v;
+        }
     }
 
     // Step 7. Futility pruning: child node (skipped when in check)
     if (   !rootNode
         &&  depth < 7 * ONE_PLY
-        &&  eval - futility_margin(pos.variant(), depth) >= beta
+        &&  eval - futility_margin(V, depth) >= beta
         &&  eval < VALUE_KNOWN_WIN  // Do not return unproven wins
 #ifdef HORDE
-        &&  (pos.non_pawn_material(pos.side_to_move()) || pos.is_horde()))
+        &&  (pos.non_pawn_material(pos.side_to_move()) || V == HORDE_VARIANT))
 #else
         &&  pos.non_pawn_material(pos.side_to_move()))
 #endif
+    {
+        STATS(++stats.pruned[Stats::FUTILITY]);
         return eval;
+    }
 
     // Step 8. Null move search with verification search (is omitted in PV nodes)
 #ifdef HORDE
-    if (pos.is_horde()) {} else
+    if (V == HORDE_VARIANT) {} else
 #endif
     if (   !PvNode
         &&  eval >= beta
@@ -1035,20 +1620,20 @@ namespace {
         // Null move dynamic reduction based on depth and value
         Depth R = ((823 + 67 * depth / ONE_PLY) / 256 + std::min((eval - beta) / PawnValueMg, 3)) * ONE_PLY;
 #ifdef ANTI
-        if (pos.is_anti())
+        if (V == ANTI_VARIANT)
             R = ((823 + 67 * depth / ONE_PLY) / 256 + std::min((eval - beta) / (2 * PawnValueMg), 3)) * ONE_PLY;
 #endif
 #ifdef ATOMIC
-        if (pos.is_atomic())
+        if (V == ATOMIC_VARIANT)
             R = ((823 + 67 * depth / ONE_PLY) / 256 + std::min((eval - beta) / (2 * PawnValueMg), 3)) * ONE_PLY;
 #endif
 
         ss->currentMove = MOVE_NULL;
-        ss->contHistory = &thisThread->contHistory[NO_PIECE][0];
+        ss->contHistory = thisThread->contHistory.at(NO_PIECE, SQ_A1);
 
         pos.do_null_move(st);
-        Value nullValue = depth-R < ONE_PLY ? -qsearch<NonPV, false>(pos, ss+1, -beta, -beta+1)
-                                            : - search<NonPV>(pos, ss+1, -beta, -beta+1, depth-R, !cutNode, true);
+        Value nullValue = depth-R < ONE_PLY ? -qsearch<NonPV, false, V>(pos, ss+1, -beta, -beta+1)
+                                            : - search<NonPV, V>(pos, ss+1, -beta, -beta+1, depth-R, !cutNode, true);
         pos.undo_null_move();
 
         if (nullValue >= beta)
@@ -1058,14 +1643,20 @@ namespace {
                 nullValue = beta;
 
             if (depth < 12 * ONE_PLY && abs(beta) < VALUE_KNOWN_WIN)
+            {
+                STATS(++stats.pruned[Stats::NULL_MOVE]);
                 return nullValue;
+            }
 
             // Do verification search at high depths
-            Value v = depth-R < ONE_PLY ? qsearch<NonPV, false>(pos, ss, beta-1, beta)
-                                        :  search<NonPV>(pos, ss, beta-1, beta, depth-R, false, true);
+            Value v = depth-R < ONE_PLY ? qsearch<NonPV, false, V>(pos, ss, beta-1, beta)
+                                        :  search<NonPV, V>(pos, ss, beta-1, beta, depth-R, false, true);
 
             if (v >= beta)
+            {
+                STATS(++stats.pruned[Stats::NULL_MOVE]);
                 return nullValue;
+            }
         }
     }
 
@@ -1073,36 +1664,39 @@ namespace {
     // If we have a good enough capture and a reduced search returns a value
     // much above beta, we can (almost) safely prune the previous move.
 #ifdef ANTI
-    if (pos.is_anti()) {} else
+    if (V == ANTI_VARIANT) {} else
 #endif
     if (   !PvNode
         &&  depth >= 5 * ONE_PLY
         &&  abs(beta) < VALUE_MATE_IN_MAX_PLY)
     {
-        Value rbeta = std::min(beta + probcut_margin[pos.variant()], VALUE_INFINITE);
+        Value rbeta = std::min(beta + probcut_margin[V], VALUE_INFINITE);
 
         assert(is_ok((ss-1)->currentMove));
 
         MovePicker mp(pos, ttMove, rbeta - ss->staticEval);
 
         while ((move = mp.next_move()) != MOVE_NONE)
-            if (pos.legal(move))
+            if (pos.legal<V>(move))
             {
                 ss->currentMove = move;
-                ss->contHistory = &thisThread->contHistory[pos.moved_piece(move)][to_sq(move)];
+                ss->contHistory = thisThread->contHistory.at(pos.moved_piece(move), to_sq(move));
 
                 assert(depth >= 5 * ONE_PLY);
-                pos.do_move(move, st);
-                value = -search<NonPV>(pos, ss+1, -rbeta, -rbeta+1, depth - 4 * ONE_PLY, !cutNode, false);
-                pos.undo_move(move);
+                pos.do_move<V>(move, st, pos.gives_check<V>(move));
+                value = -search<NonPV, V>(pos, ss+1, -rbeta, -rbeta+1, depth - 4 * ONE_PLY, !cutNode, false);
+                pos.undo_move<V>(move);
                 if (value >= rbeta)
+                {
+                    STATS(++stats.pruned[Stats::PROBCUT]);
                     return value;
+                }
             }
     }
 
     // Step 10. Internal iterative deepening (skipped when in check)
 #ifdef CRAZYHOUSE
-    if (    depth >= (pos.is_house() ? 4 : 6) * ONE_PLY
+    if (    depth >= (V == CRAZYHOUSE_VARIANT ? 4 : 6) * ONE_PLY
 #else
     if (    depth >= 6 * ONE_PLY
 #endif
@@ -1110,7 +1704,7 @@ namespace {
         && (PvNode || ss->staticEval + 256 >= beta))
     {
         Depth d = (3 * depth / (4 * ONE_PLY) - 2) * ONE_PLY;
-        search<NT>(pos, ss, alpha, beta, d, cutNode, true);
+        search<NT, V>(pos, ss, alpha, beta, d, cutNode, true);
 
         tte = TT.probe(posKey, ttHit);
         ttMove = ttHit ? tte->move() : MOVE_NONE;
@@ -1171,13 +1765,13 @@ moves_loop: // When in check search starts from here
 
       givesCheck =  type_of(move) == NORMAL && !pos.discovered_check_candidates()
 #ifdef ATOMIC
-                  && !pos.is_atomic()
+                  && V != ATOMIC_VARIANT
 #endif
                   ? pos.check_squares(type_of(pos.piece_on(from_sq(move)))) & to_sq(move)
-                  : pos.gives_check(move);
+                  : pos.gives_check<V>(move);
 
       moveCountPruning =   depth < 16 * ONE_PLY
-                        && moveCount >= FutilityMoveCounts[pos.variant()][improving][depth / ONE_PLY];
+                        && moveCount >= FutilityMoveCounts[V][improving][depth / ONE_PLY];
 
       // Step 12. Singular and Gives Check Extensions
 
@@ -1188,12 +1782,12 @@ moves_loop: // When in check search starts from here
       // ttValue minus a margin then we will extend the ttMove.
       if (    singularExtensionNode
           &&  move == ttMove
-          &&  pos.legal(move))
+          &&  pos.legal<V>(move))
       {
           Value rBeta = std::max(ttValue - 2 * depth / ONE_PLY, -VALUE_MATE);
           Depth d = (depth / (2 * ONE_PLY)) * ONE_PLY;
           ss->excludedMove = move;
-          value = search<NonPV>(pos, ss, rBeta - 1, rBeta, d, cutNode, true);
+          value = search<NonPV, V>(pos, ss, rBeta - 1, rBeta, d, cutNode, true);
           ss->excludedMove = MOVE_NONE;
 
           if (value < rBeta)
@@ -1201,10 +1795,10 @@ moves_loop: // When in check search starts from here
       }
       else if (    givesCheck
                && !moveCountPruning
-               &&  pos.see_ge(move))
+               &&  pos.see_ge<V>(move))
           extension = ONE_PLY;
 #ifdef ANTI
-      else if (   pos.is_anti()
+      else if (   V == ANTI_VARIANT
                && !moveCountPruning
                &&  pos.capture(move)
                &&  MoveList<LEGAL>(pos).size() == 1)
@@ -1217,7 +1811,7 @@ moves_loop: // When in check search starts from here
       // Step 13. Pruning at shallow depth
       if (  !rootNode
 #ifdef HORDE
-          && (pos.non_pawn_material(pos.side_to_move()) || pos.is_horde())
+          && (pos.non_pawn_material(pos.side_to_move()) || V == HORDE_VARIANT)
 #else
           && pos.non_pawn_material(pos.side_to_move())
 #endif
@@ -1226,13 +1820,13 @@ moves_loop: // When in check search starts from here
           if (   !captureOrPromotion
               && !givesCheck
 #ifdef ANTI
-              && (!pos.is_anti() || !(pos.attackers_to(to_sq(move)) & pos.pieces(~pos.side_to_move())))
+              && (V != ANTI_VARIANT || !pos.attacked_by(~pos.side_to_move(), to_sq(move)))
 #endif
 #ifdef LOSERS
-              && (!pos.is_losers() || !(pos.attackers_to(to_sq(move)) & pos.pieces(~pos.side_to_move())))
+              && (V != LOSERS_VARIANT || !pos.attacked_by(~pos.side_to_move(), to_sq(move)))
 #endif
 #ifdef HORDE
-              && (pos.is_horde() || !pos.advanced_pawn_push(move) || pos.non_pawn_material() >= Value(5000))
+              && (V == HORDE_VARIANT || !pos.advanced_pawn_push(move) || pos.non_pawn_material() >= Value(5000))
 #else
               && (!pos.advanced_pawn_push(move) || pos.non_pawn_material() >= Value(5000))
 #endif
@@ -1241,6 +1835,7 @@ moves_loop: // When in check search starts from here
               // Move count based pruning
               if (moveCountPruning)
               {
+                  STATS(++stats.pruned[Stats::MOVE_COUNT]);
                   skipQuiets = true;
                   continue;
               }
@@ -1252,36 +1847,48 @@ moves_loop: // When in check search starts from here
               if (   lmrDepth < 3
                   && (*contHist[0])[movedPiece][to_sq(move)] < CounterMovePruneThreshold
                   && (*contHist[1])[movedPiece][to_sq(move)] < CounterMovePruneThreshold)
+              {
+                  STATS(++stats.pruned[Stats::COUNTERMOVE_HISTORY]);
                   continue;
+              }
 
               // Futility pruning: parent node
               if (   lmrDepth < 7
                   && !inCheck
-                  && ss->staticEval + futility_margin_parent[pos.variant()][0] + futility_margin_parent[pos.variant()][1] * lmrDepth <= alpha)
+                  && ss->staticEval + futility_margin_parent[V][0] + futility_margin_parent[V][1] * lmrDepth <= alpha)
+              {
+                  STATS(++stats.pruned[Stats::FUTILITY_PARENT]);
                   continue;
+              }
 
               // Prune moves with negative SEE
 #ifdef ANTI
-              if (pos.is_anti()) {} else
+              if (V == ANTI_VARIANT) {} else
 #endif
 #ifdef RACE
-              if (pos.is_race()) {} else
+              if (V == RACE_VARIANT) {} else
 #endif
               if (   lmrDepth < 8
-                  && !pos.see_ge(move, Value(-35 * lmrDepth * lmrDepth)))
+                  && !pos.see_ge<V>(move, Value(-35 * lmrDepth * lmrDepth)))
+              {
+                  STATS(++stats.pruned[Stats::SEE_QUIET]);
                   continue;
+              }
           }
           else if (    depth < 7 * ONE_PLY
                    && !extension
-                   && !pos.see_ge(move, -PawnValueEg * (depth / ONE_PLY)))
-                  continue;
+                   && !pos.see_ge<V>(move, -PawnValueEg * (depth / ONE_PLY)))
+          {
+              STATS(++stats.pruned[Stats::SEE_CAPTURE]);
+              continue;
+          }
       }
 
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
-      if (!rootNode && !pos.legal(move))
+      if (!rootNode && !pos.legal<V>(move))
       {
           ss->moveCount = --moveCount;
           continue;
@@ -1292,10 +1899,10 @@ moves_loop: // When in check search starts from here
 
       // Update the current move (this must be done after singular extension search)
       ss->currentMove = move;
-      ss->contHistory = &thisThread->contHistory[movedPiece][to_sq(move)];
+      ss->contHistory = thisThread->contHistory.at(movedPiece, to_sq(move));
 
       // Step 14. Make the move
-      pos.do_move(move, st, givesCheck);
+      pos.do_move<V>(move, st, givesCheck);
 
       // Step 15. Reduced depth search (LMR). If the move fails high it will be
       // re-searched at full depth.
@@ -1306,12 +1913,12 @@ moves_loop: // When in check search starts from here
           Depth r = reduction<PvNode>(improving, depth, moveCount);
 
 #ifdef ANTI
-          if (pos.is_anti() && pos.can_capture())
+          if (V == ANTI_VARIANT && pos.can_capture())
               r -= r ? ONE_PLY : DEPTH_ZERO;
           else
 #endif
 #ifdef CRAZYHOUSE
-          if (pos.is_house() && givesCheck)
+          if (V == CRAZYHOUSE_VARIANT && givesCheck)
               r -= r ? ONE_PLY : DEPTH_ZERO;
           else
 #endif
@@ -1339,7 +1946,7 @@ moves_loop: // When in check search starts from here
               // castling moves, because they are coded as "king captures rook" and
               // hence break make_move().
               else if (    type_of(move) == NORMAL
-                       && !pos.see_ge(make_move(to_sq(move), from_sq(move))))
+                       && !pos.see_ge<V>(make_move(to_sq(move), from_sq(move))))
                   r -= 2 * ONE_PLY;
 
               ss->statScore =  thisThread->mainHistory[~pos.side_to_move()][from_to(move)]
@@ -1361,9 +1968,11 @@ moves_loop: // When in check search starts from here
 
           Depth d = std::max(newDepth - r, ONE_PLY);
 
-          value = -search<NonPV>(pos, ss+1, -(alpha+1), -alpha, d, true, false);
+          value = -search<NonPV, V>(pos, ss+1, -(alpha+1), -alpha, d, true, false);
 
           doFullDepthSearch = (value > alpha && d != newDepth);
+          STATS(++stats.reduced);
+          STATS(stats.researched += doFullDepthSearch);
       }
       else
           doFullDepthSearch = !PvNode || moveCount > 1;
@@ -1371,9 +1980,9 @@ moves_loop: // When in check search starts from here
       // Step 16. Full depth search when LMR is skipped or fails high
       if (doFullDepthSearch)
           value = newDepth <   ONE_PLY ?
-                            givesCheck ? -qsearch<NonPV,  true>(pos, ss+1, -(alpha+1), -alpha)
-                                       : -qsearch<NonPV, false>(pos, ss+1, -(alpha+1), -alpha)
-                                       : - search<NonPV>(pos, ss+1, -(alpha+1), -alpha, newDepth, !cutNode, false);
+                            givesCheck ? -qsearch<NonPV,  true, V>(pos, ss+1, -(alpha+1), -alpha)
+                                       : -qsearch<NonPV, false, V>(pos, ss+1, -(alpha+1), -alpha)
+                                       : - search<NonPV, V>(pos, ss+1, -(alpha+1), -alpha, newDepth, !cutNode, false);
 
       // For PV nodes only, do a full PV search on the first move or after a fail
       // high (in the latter case search only if value < beta), otherwise let the
@@ -1384,13 +1993,13 @@ moves_loop: // When in check search starts from here
           (ss+1)->pv[0] = MOVE_NONE;
 
           value = newDepth <   ONE_PLY ?
-                            givesCheck ? -qsearch<PV,  true>(pos, ss+1, -beta, -alpha)
-                                       : -qsearch<PV, false>(pos, ss+1, -beta, -alpha)
-                                       : - search<PV>(pos, ss+1, -beta, -alpha, newDepth, false, false);
+                            givesCheck ? -qsearch<PV,  true, V>(pos, ss+1, -beta, -alpha)
+                                       : -qsearch<PV, false, V>(pos, ss+1, -beta, -alpha)
+                                       : - search<PV, V>(pos, ss+1, -beta, -alpha, newDepth, false, false);
       }
 
       // Step 17. Undo move
-      pos.undo_move(move);
+      pos.undo_move<V>(move);
 
       assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1421,8 +2030,14 @@ moves_loop: // When in check search starts from here
               // We record how often the best move has been changed in each
               // iteration. This information is used for time management: When
               // the best move changes frequently, we allocate some more time.
-              if (moveCount > 1 && thisThread == Threads.main())
+              if (moveCount > 1 && value > bestValue && thisThread == Threads.main())
                   ++static_cast<MainThread*>(thisThread)->bestMoveChanges;
+
+              // With a shared MultiPV window alpha is raised to the score of
+              // the last line, so that only moves entering the lines need an
+              // exact score, rather than to the score of the best one.
+              if (thisThread->pvLast > thisThread->PVIdx && value < beta)
+                  alpha = std::max(alpha, kth_score(thisThread->rootMoves, thisThread->pvLast + 1));
           }
           else
               // All other moves but the PV are set to the lowest value: this
@@ -1443,10 +2058,11 @@ moves_loop: // When in check search starts from here
                   update_pv(ss->pv, move, (ss+1)->pv);
 
               if (PvNode && value < beta) // Update alpha! Always alpha < beta
-                  alpha = value;
+                  alpha = rootNode && thisThread->pvLast > thisThread->PVIdx ? alpha : value;
               else
               {
                   assert(value >= beta); // Fail high
+                  STATS(stats.cutoff(mp, moveCount));
                   break;
               }
           }
@@ -1509,7 +2125,7 @@ moves_loop: // When in check search starts from here
   // qsearch() is the quiescence search function, which is called by the main
   // search function with depth zero, or recursively with depth less than ONE_PLY.
 
-  template <NodeType NT, bool InCheck>
+  template <NodeType NT, bool InCheck, Variant V>
   Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
 
     const bool PvNode = NT == PV;
@@ -1526,6 +2142,8 @@ moves_loop: // When in check search starts from here
     Key posKey;
     Move ttMove, move, bestMove;
     Value bestValue, value, ttValue, futilityValue, futilityBase, oldAlpha;
+    STATS(Stats& stats = pos.this_thread()->stats);
+    STATS(++stats.qnodes);
     bool ttHit, givesCheck, evasionPrunable;
     Depth ttDepth;
     int moveCount;
@@ -1546,7 +2164,7 @@ moves_loop: // When in check search starts from here
 
     // Check for an instant draw or if the maximum ply has been reached
     if (pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
-        return ss->ply >= MAX_PLY && !InCheck ? evaluate(pos)
+        return ss->ply >= MAX_PLY && !InCheck ? evaluate<V>(pos)
                                               : DrawValue[pos.side_to_move()];
 
     assert(0 <= ss->ply && ss->ply < MAX_PLY);
@@ -1559,6 +2177,7 @@ moves_loop: // When in check search starts from here
     // Transposition table lookup
     posKey = pos.key();
     tte = TT.probe(posKey, ttHit);
+    STATS(count_probe(stats, pos, tte, ttHit));
     ttMove = ttHit ? tte->move() : MOVE_NONE;
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
 
@@ -1582,7 +2201,7 @@ moves_loop: // When in check search starts from here
         {
             // Never assume anything on values stored in TT
             if ((ss->staticEval = bestValue = tte->eval()) == VALUE_NONE)
-                ss->staticEval = bestValue = evaluate(pos);
+                ss->staticEval = bestValue = evaluate<V>(pos);
 
             // Can ttValue be used as a better position evaluation?
             if (   ttValue != VALUE_NONE
@@ -1591,8 +2210,8 @@ moves_loop: // When in check search starts from here
         }
         else
             ss->staticEval = bestValue =
-            (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
-                                             : -(ss-1)->staticEval + 2 * Eval::Tempo[pos.variant()];
+            (ss-1)->currentMove != MOVE_NULL ? evaluate<V>(pos)
+                                             : -(ss-1)->staticEval + 2 * Eval::Tempo[V];
 
         // Stand pat. Return immediately if static value is at least beta
         if (bestValue >= beta)
@@ -1623,10 +2242,10 @@ moves_loop: // When in check search starts from here
 
       givesCheck =  type_of(move) == NORMAL && !pos.discovered_check_candidates()
 #ifdef ATOMIC
-                  && !pos.is_atomic()
+                  && V != ATOMIC_VARIANT
 #endif
                   ? pos.check_squares(type_of(pos.piece_on(from_sq(move)))) & to_sq(move)
-                  : pos.gives_check(move);
+                  : pos.gives_check<V>(move);
 
       moveCount++;
 
@@ -1634,7 +2253,7 @@ moves_loop: // When in check search starts from here
       if (   !InCheck
           && !givesCheck
 #ifdef RACE
-          && !(pos.is_race() && type_of(pos.piece_on(from_sq(move))) == KING && rank_of(to_sq(move)) == RANK_8)
+          && !(V == RACE_VARIANT && type_of(pos.piece_on(from_sq(move))) == KING && rank_of(to_sq(move)) == RANK_8)
 #endif
           &&  futilityBase > -VALUE_KNOWN_WIN
           && !pos.advanced_pawn_push(move))
@@ -1642,25 +2261,27 @@ moves_loop: // When in check search starts from here
           assert(type_of(move) != ENPASSANT); // Due to !pos.advanced_pawn_push
 
 #ifdef ATOMIC
-          if (pos.is_atomic())
+          if (V == ATOMIC_VARIANT)
               futilityValue = futilityBase + pos.see<ATOMIC_VARIANT>(move);
           else
 #endif
 #ifdef CRAZYHOUSE
-          if (pos.is_house())
+          if (V == CRAZYHOUSE_VARIANT)
               futilityValue = futilityBase + 2 * PieceValue[CRAZYHOUSE_VARIANT][EG][pos.piece_on(to_sq(move))];
           else
 #endif
-          futilityValue = futilityBase + PieceValue[pos.variant()][EG][pos.piece_on(to_sq(move))];
+          futilityValue = futilityBase + PieceValue[V][EG][pos.piece_on(to_sq(move))];
 
           if (futilityValue <= alpha)
           {
+              STATS(++stats.pruned[Stats::QSEARCH_FUTILITY]);
               bestValue = std::max(bestValue, futilityValue);
               continue;
           }
 
-          if (futilityBase <= alpha && !pos.see_ge(move, VALUE_ZERO + 1))
+          if (futilityBase <= alpha && !pos.see_ge<V>(move, VALUE_ZERO + 1))
           {
+              STATS(++stats.pruned[Stats::QSEARCH_FUTILITY]);
               bestValue = std::max(bestValue, futilityBase);
               continue;
           }
@@ -1675,14 +2296,17 @@ moves_loop: // When in check search starts from here
       // Don't search moves with negative SEE values
       if (  (!InCheck || evasionPrunable)
           &&  type_of(move) != PROMOTION
-          &&  !pos.see_ge(move))
+          &&  !pos.see_ge<V>(move))
+      {
+          STATS(++stats.pruned[Stats::QSEARCH_SEE]);
           continue;
+      }
 
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
-      if (!pos.legal(move))
+      if (!pos.legal<V>(move))
       {
           moveCount--;
           continue;
@@ -1691,10 +2315,10 @@ moves_loop: // When in check search starts from here
       ss->currentMove = move;
 
       // Make and search the move
-      pos.do_move(move, st, givesCheck);
-      value = givesCheck ? -qsearch<NT,  true>(pos, ss+1, -beta, -alpha, depth - ONE_PLY)
-                         : -qsearch<NT, false>(pos, ss+1, -beta, -alpha, depth - ONE_PLY);
-      pos.undo_move(move);
+      pos.do_move<V>(move, st, givesCheck);
+      value = givesCheck ? -qsearch<NT,  true, V>(pos, ss+1, -beta, -alpha, depth - ONE_PLY)
+                         : -qsearch<NT, false, V>(pos, ss+1, -beta, -alpha, depth - ONE_PLY);
+      pos.undo_move<V>(move);
 
       assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1715,6 +2339,7 @@ moves_loop: // When in check search starts from here
               }
               else // Fail high
               {
+                  STATS(stats.cutoff(mp, moveCount));
                   tte->save(posKey, value_to_tt(value, ss->ply), BOUND_LOWER,
                             ttDepth, move, ss->staticEval, TT.generation());
 
@@ -1822,7 +2447,7 @@ moves_loop: // When in check search starts from here
   Move Skill::pick_best(size_t multiPV) {
 
     const RootMoves& rootMoves = Threads.main()->rootMoves;
-    static PRNG rng(now()); // PRNG sequence should be non-deterministic
+    static thread_local PRNG rng(now()); // PRNG sequence should be non-deterministic
 
     // RootMoves are already sorted by score in descending order
     Value topScore = rootMoves[0].score;
@@ -1864,8 +2489,6 @@ moves_loop: // When in check search starts from here
     // otherwise use a default value.
     callsCnt = Limits.nodes ? std::min(4096, int(Limits.nodes / 1024)) : 4096;
 
-    static TimePoint lastInfoTime = now();
-
     int elapsed = Time.elapsed();
     TimePoint tick = Limits.startTime + elapsed;
 
@@ -1875,6 +2498,27 @@ moves_loop: // When in check search starts from here
         dbg_print();
     }
 
+    // Coalesced PV lines are sent as soon as the interval has passed
+    if (   !Output.withheld.empty()
+        && tick - Output.sentTime >= int(Options["Info Interval"])
+        && Options["Info Coalesce"])
+        flush_pv(rootPos.is_chess960());
+
+#ifdef USE_ASYNCIFY
+    // Without threads the worker cannot receive "stop" or "ponderhit" while
+    // we are searching. Every few milliseconds unwind to the event loop, so
+    // that pending messages are handled, and resume where we left off.
+    int yieldInterval = Options["Yield Interval"];
+
+    if (yieldInterval && tick - lastYieldTime >= yieldInterval)
+    {
+        Engine* engine = CurrentEngine; // Others may run in the meantime
+        emscripten_sleep(0);
+        CurrentEngine = engine;
+        lastYieldTime = now();
+    }
+#endif
+
     // An engine may not stop pondering until told so by the GUI
     if (Threads.ponder)
         return;
@@ -1886,18 +2530,18 @@ moves_loop: // When in check search starts from here
   }
 
 
-/// UCI::pv() formats PV information according to the UCI protocol. UCI requires
-/// that all (if any) unsearched PV lines are sent using a previous search score.
+/// UCI::pv_lines() collects the PV lines to send to the GUI. UCI requires that
+/// all (if any) unsearched PV lines are sent using a previous search score.
 
-string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
+std::vector<UCI::PVLine> UCI::pv_lines(const Position& pos, Depth depth, Value alpha, Value beta) {
 
-  std::stringstream ss;
+  std::vector<PVLine> lines;
   int elapsed = Time.elapsed() + 1;
   const RootMoves& rootMoves = pos.this_thread()->rootMoves;
   size_t PVIdx = pos.this_thread()->PVIdx;
   size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
   uint64_t nodesSearched = Threads.nodes_searched();
-  uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  uint64_t tbHits = Threads.tb_hits() + (TBState.RootInTB ? rootMoves.size() : 0);
 
   for (size_t i = 0; i < multiPV; ++i)
   {
@@ -1909,39 +2553,118 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
       Depth d = updated ? depth : depth - ONE_PLY;
       Value v = updated ? rootMoves[i].score : rootMoves[i].previousScore;
 
-      bool tb = TB::RootInTB && abs(v) < VALUE_MATE - MAX_PLY;
-      v = tb ? TB::Score : v;
+      bool tb = TBState.RootInTB && abs(v) < VALUE_MATE - MAX_PLY;
+      v = tb ? TBState.Score : v;
 
-      if (ss.rdbuf()->in_avail()) // Not at first line
-          ss << "\n";
+      lines.push_back({ d / ONE_PLY, rootMoves[i].selDepth, int(i + 1), v,
+                        tb || i != PVIdx ? 0 : v >= beta ? 1 : v <= alpha ? 2 : 0,
+                        nodesSearched, tbHits, elapsed, rootMoves[i].pv });
+  }
+
+  return lines;
+}
 
-      ss << "info"
-         << " depth "    << d / ONE_PLY
-         << " seldepth " << rootMoves[i].selDepth
-         << " multipv "  << i + 1
-         << " score "    << UCI::value(v);
 
-      if (!tb && i == PVIdx)
-          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
+/// UCI::pv() formats PV lines according to the UCI protocol
 
-      ss << " nodes "    << nodesSearched
-         << " nps "      << nodesSearched * 1000 / elapsed;
+string UCI::pv(const std::vector<PVLine>& lines, bool chess960) {
+
+  std::stringstream ss;
 
-      if (elapsed > 1000) // Earlier makes little sense
+  for (const PVLine& l : lines)
+  {
+      if (ss.rdbuf()->in_avail()) // Not at first line
+          ss << "\n";
+
+      ss << "info"
+         << " depth "    << l.depth
+         << " seldepth " << l.seldepth
+         << " multipv "  << l.multipv
+         << " score "    << UCI::value(l.score)
+         << (l.bound == 1 ? " lowerbound" : l.bound == 2 ? " upperbound" : "")
+         << " nodes "    << l.nodes
+         << " nps "      << l.nodes * 1000 / l.time;
+
+      if (l.time > 1000) // Earlier makes little sense
           ss << " hashfull " << TT.hashfull();
 
-      ss << " tbhits "   << tbHits
-         << " time "     << elapsed
+      ss << " tbhits "   << l.tbHits
+         << " time "     << l.time
          << " pv";
 
-      for (Move m : rootMoves[i].pv)
-          ss << " " << UCI::move(m, pos.is_chess960());
+      for (Move m : l.pv)
+          ss << " " << UCI::move(m, chess960);
   }
 
   return ss.str();
 }
 
 
+#ifdef __EMSCRIPTEN__
+namespace {
+
+  UCI::InfoBuffer Info = { UCI::InfoBuffer::Capacity, sizeof(UCI::InfoRecord), 0, {} };
+}
+
+extern "C" UCI::InfoBuffer* info_buffer() { return &Info; }
+
+
+/// UCI::pv_records() is the binary counterpart of UCI::pv(). It writes one
+/// record per PV line to the info buffer and hands them to Module.onInfo()
+/// of the JavaScript glue.
+
+void UCI::pv_records(const std::vector<PVLine>& lines) {
+
+  uint32_t first = Info.written;
+
+  for (const PVLine& l : lines)
+  {
+      InfoRecord& r = Info.records[Info.written % InfoBuffer::Capacity];
+      uint32_t seq = 2 * Info.written;
+
+      r.seq = seq + 1; // Odd while writing
+      std::atomic_thread_fence(std::memory_order_release);
+
+      r.depth    = l.depth;
+      r.seldepth = l.seldepth;
+      r.multipv  = l.multipv;
+      r.mate     = abs(l.score) >= VALUE_MATE - MAX_PLY;
+      r.score    = r.mate ? (l.score > 0 ? VALUE_MATE - l.score + 1 : -VALUE_MATE - l.score) / 2
+                          : l.score * 100 / PawnValueEg;
+      r.bound    = l.bound;
+      r.nodes[0] = uint32_t(l.nodes), r.nodes[1] = uint32_t(l.nodes >> 32);
+      r.nps      = uint32_t(l.nodes * 1000 / l.time);
+      r.hashfull = l.time > 1000 ? TT.hashfull() : 0;
+      r.tbhits[0] = uint32_t(l.tbHits), r.tbhits[1] = uint32_t(l.tbHits >> 32);
+      r.time     = l.time;
+      r.pvLength = int(std::min(l.pv.size(), size_t(MAX_PLY)));
+
+      for (int j = 0; j < r.pvLength; ++j)
+          r.pv[j] = l.pv[j];
+
+      std::atomic_thread_fence(std::memory_order_release);
+      r.seq = seq + 2;
+      Info.written++;
+  }
+
+#ifdef NO_THREADS
+  // Pass the new records on as one block, or two if the buffer wrapped around.
+  // With pthreads the search runs off the main thread and the buffer in shared
+  // memory is polled instead.
+  for (uint32_t n = first; n != Info.written; )
+  {
+      uint32_t idx = n % InfoBuffer::Capacity;
+      uint32_t cnt = std::min(Info.written - n, InfoBuffer::Capacity - idx);
+
+      EM_ASM_({ if (Module['onInfo']) Module['onInfo']($0, $1); },
+              (int)(intptr_t)&Info.records[idx], int(cnt * sizeof(InfoRecord)));
+      n += cnt;
+  }
+#endif
+}
+#endif
+
+
 /// RootMove::extract_ponder_from_tt() is called in case we have no ponder move
 /// before exiting the search, for instance, in case we stop the search during a
 /// fail high at root. We try hard to have a ponder move to return to the GUI,
@@ -1973,44 +2696,44 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
     return pv.size() > 1;
 }
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
 void Tablebases::filter_root_moves(Position& pos, Search::RootMoves& rootMoves) {
 
-    RootInTB = false;
-    UseRule50 = Options["Syzygy50MoveRule"];
-    ProbeDepth = Options["SyzygyProbeDepth"] * ONE_PLY;
-    Cardinality = Options["SyzygyProbeLimit"];
+    TBState.RootInTB = false;
+    TBState.UseRule50 = Options["Syzygy50MoveRule"];
+    TBState.ProbeDepth = Options["SyzygyProbeDepth"] * ONE_PLY;
+    TBState.Cardinality = Options["SyzygyProbeLimit"];
 
-    // Skip TB probing when no TB found: !TBLargest -> !TB::Cardinality
-    if (Cardinality > MaxCardinality)
+    // Skip TB probing when no TB found: !TBLargest -> !TBState.Cardinality
+    if (TBState.Cardinality > max_cardinality())
     {
-        Cardinality = MaxCardinality;
-        ProbeDepth = DEPTH_ZERO;
+        TBState.Cardinality = max_cardinality();
+        TBState.ProbeDepth = DEPTH_ZERO;
     }
 
-    if (Cardinality < popcount(pos.pieces()) || pos.can_castle(ANY_CASTLING))
+    if (TBState.Cardinality < popcount(pos.pieces()) || pos.can_castle(ANY_CASTLING))
         return;
 
     // If the current root position is in the tablebases, then RootMoves
     // contains only moves that preserve the draw or the win.
-    RootInTB = root_probe(pos, rootMoves, TB::Score);
+    TBState.RootInTB = root_probe(pos, rootMoves, TBState.Score);
 
-    if (RootInTB)
-        Cardinality = 0; // Do not probe tablebases during the search
+    if (TBState.RootInTB)
+        TBState.Cardinality = 0; // Do not probe tablebases during the search
 
     else // If DTZ tables are missing, use WDL tables as a fallback
     {
         // Filter out moves that do not preserve the draw or the win.
-        RootInTB = root_probe_wdl(pos, rootMoves, TB::Score);
+        TBState.RootInTB = root_probe_wdl(pos, rootMoves, TBState.Score);
 
         // Only probe during search if winning
-        if (RootInTB && TB::Score <= VALUE_DRAW)
-            Cardinality = 0;
+        if (TBState.RootInTB && TBState.Score <= VALUE_DRAW)
+            TBState.Cardinality = 0;
     }
 
-    if (RootInTB && !UseRule50)
-        TB::Score =  TB::Score > VALUE_DRAW ?  VALUE_MATE - MAX_PLY - 1
-                   : TB::Score < VALUE_DRAW ? -VALUE_MATE + MAX_PLY + 1
-                                            :  VALUE_DRAW;
+    if (TBState.RootInTB && !TBState.UseRule50)
+        TBState.Score =  TBState.Score > VALUE_DRAW ?  VALUE_MATE - MAX_PLY - 1
+                       : TBState.Score < VALUE_DRAW ? -VALUE_MATE + MAX_PLY + 1
+                                                     :  VALUE_DRAW;
 }
-#endif  // ifndef __EMSCRIPTEN__
+#endif  // ifndef NO_SYZYGY
@@ -21,6 +21,7 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <algorithm>
 #include <vector>
 
 #include "misc.h"
@@ -52,6 +53,43 @@ struct Stack {
 };
 
 
+/// Stats struct counts, per thread, what happens in the hot paths of the search:
+/// nodes of search() and qsearch(), TT probes, prunings, and the stage and index
+/// of the moves causing a cutoff. It exists with stats=yes only, see STATS().
+/// Counters are reset with the histories on "ucinewgame" and printed by the
+/// "stats" command.
+
+#ifdef USE_STATS
+struct Stats {
+
+  enum Prune {
+    RAZORING, FUTILITY, NULL_MOVE, PROBCUT, MOVE_COUNT, COUNTERMOVE_HISTORY,
+    FUTILITY_PARENT, SEE_QUIET, SEE_CAPTURE, QSEARCH_FUTILITY, QSEARCH_SEE,
+    PRUNE_NB
+  };
+
+  enum { CutoffIndexNb = 8 }; // Last one counts all the later moves
+
+  uint64_t nodes, qnodes;
+  uint64_t ttHits, ttMisses, ttCollisions, ttEmpty, ttReplaced;
+  uint64_t reduced, researched; // LMR searches and those failing high
+  uint64_t pruned[PRUNE_NB];
+  uint64_t cutoffs, cutoffStage[MovePicker::StageNb], cutoffIndex[CutoffIndexNb];
+  uint64_t evalHits[VARIANT_NB], evalMisses[VARIANT_NB];
+
+  void cutoff(const MovePicker& mp, int moveCount) {
+    ++cutoffs;
+    ++cutoffStage[mp.stage_of_move()];
+    ++cutoffIndex[std::min(moveCount, int(CutoffIndexNb)) - 1];
+  }
+
+  Stats& operator+=(const Stats& s);
+};
+
+void print_stats(std::ostream& os);
+#endif
+
+
 /// RootMove struct is used for moves at the root of the tree. For each root move
 /// we store a score and a PV (really a refutation in the case of moves which
 /// fail low). Score is normally set at -VALUE_INFINITE for all non-pv moves.
@@ -82,7 +120,7 @@ struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
     nodes = time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] =
-    npmsec = movestogo = depth = movetime = mate = perft = infinite = 0;
+    npmsec = movestogo = depth = movetime = mate = perft = infinite = silent = 0;
   }
 
   bool use_time_management() const {
@@ -91,15 +129,19 @@ struct LimitsType {
 
   std::vector<Move> searchmoves;
   int time[COLOR_NB], inc[COLOR_NB], npmsec, movestogo, depth,
-      movetime, mate, perft, infinite;
+      movetime, mate, perft, infinite, silent; // No output, e.g. for batches
   int64_t nodes;
   TimePoint startTime;
 };
 
-extern LimitsType Limits;
+struct State; // Shared by the threads of an engine, see search.cpp
+
+State* new_state();
+void delete_state(State* state);
 
 void init();
 void clear();
+void print_memory(std::ostream& os);
 
 } // namespace Search
 
@@ -0,0 +1,307 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define USE_MMAP
+#endif
+
+#include "engine.h"
+#include "store.h"
+
+namespace {
+
+  const char StoreMagic[8] = { 'S', 'F', 'S', 'T', 'O', 'R', 'E', '1' };
+
+  // fnv1a() hashes 'len' bytes, going on from the hash 'h' of earlier bytes
+  uint64_t fnv1a(const void* data, size_t len, uint64_t h = 0xCBF29CE484222325ULL) {
+
+    const unsigned char* p = (const unsigned char*)data;
+
+    while (len--)
+        h = (h ^ *p++) * 0x100000001B3ULL;
+
+    return h;
+  }
+
+} // namespace
+
+
+/// ResultStore::open() maps the given file, creating it with about 'mbSize' MB
+/// of records if it does not exist, and returns false if it cannot be opened
+/// or is not a store. An existing store keeps its size. An empty name closes
+/// the store. Only builds with mmap() support it.
+
+bool ResultStore::open(const std::string& fileName, size_t mbSize) {
+
+  close();
+
+  if (fileName.empty() || fileName == "<empty>")
+      return true;
+
+#ifdef USE_MMAP
+  struct stat statbuf;
+  int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+
+  if (fd == -1)
+      return false;
+
+  fstat(fd, &statbuf);
+  size_t size = statbuf.st_size;
+  bool created = !size;
+
+  if (created)
+  {
+      size_t buckets = 1;
+      while (2 * buckets * BucketSize * sizeof(Record) <= mbSize * 1024 * 1024)
+          buckets *= 2;
+
+      size = sizeof(Record) + buckets * BucketSize * sizeof(Record); // The header takes a record
+      if (ftruncate(fd, off_t(size)) == -1)
+          return ::close(fd), false;
+  }
+
+  mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+      return mapping = nullptr, false;
+
+  mappedSize = size;
+  header = (Header*)mapping;
+  records0 = (Record*)((char*)mapping + sizeof(Record));
+
+  if (created)
+  {
+      std::memcpy(header->magic, StoreMagic, sizeof(StoreMagic));
+      header->bucketCount = (size - sizeof(Record)) / sizeof(Record) / BucketSize;
+  }
+
+  uint64_t n = header->bucketCount;
+
+  if (   std::memcmp(header->magic, StoreMagic, sizeof(StoreMagic))
+      || !n || (n & (n - 1))
+      || size != sizeof(Record) + n * BucketSize * sizeof(Record))
+      return close(), false;
+
+  return true;
+#else
+  (void)mbSize;
+  return false;
+#endif
+}
+
+
+/// ResultStore::close() unmaps the store
+
+void ResultStore::close() {
+
+#ifdef USE_MMAP
+  if (mapping)
+      munmap(mapping, mappedSize);
+#endif
+
+  mapping = nullptr;
+  mappedSize = 0;
+  header = nullptr;
+  records0 = nullptr;
+}
+
+
+/// ResultStore::store_key() returns the key of a position in the store, which
+/// also tells the variants and the 50-move counters apart, and the values of
+/// the options which change the result of a search as deep: Contempt, and the
+/// Syzygy ones when a path is set. The moves before the position are not part
+/// of it: a result is served as well where one of its lines would repeat an
+/// earlier position of the game, and so be a draw.
+
+Key ResultStore::store_key(const Position& pos) {
+
+  std::string options = std::to_string(int(Options["Contempt"]));
+
+#ifndef NO_SYZYGY
+  if (std::string(Options["SyzygyPath"]) != "<empty>")
+      options +=  "\n" + std::string(Options["SyzygyPath"])
+                + "\n" + std::to_string(int(Options["SyzygyProbeDepth"]))
+                + "\n" + std::to_string(int(Options["Syzygy50MoveRule"]))
+                + "\n" + std::to_string(int(Options["SyzygyProbeLimit"]));
+#endif
+
+  return  pos.key()
+        ^ (uint64_t(pos.subvariant() + 1) * 0x9E3779B97F4A7C15ULL)
+        ^ (uint64_t(pos.rule50_count() + 1) * 0xC2B2AE3D27D4EB4FULL)
+        ^ fnv1a(options.data(), options.size());
+}
+
+
+/// ResultStore::content_hash() hashes the fields of a record after the stamp
+
+uint64_t ResultStore::content_hash(const Record& r) {
+
+  const char* p = (const char*)&r.depth;
+
+  return fnv1a(p, (const char*)(&r + 1) - p) | 1; // Never 0, so that an empty record matches no key
+}
+
+
+/// ResultStore::applies() returns whether the result of a search with these
+/// limits and the current options is the one of any other search as deep, i.e.
+/// a single PV of all the moves at full strength.
+
+bool ResultStore::applies(const Search::LimitsType& limits) {
+
+  return   limits.searchmoves.empty()
+        && !limits.perft
+        && !limits.mate
+        && Options["MultiPV"] == 1
+#ifdef SKILL
+        && Options["Skill Level"] == 20
+#endif
+        ;
+}
+
+
+/// ResultStore::records() counts the records in use, scanning the whole store
+
+size_t ResultStore::records() const {
+
+  size_t count = 0;
+
+  for (size_t i = 0; i < capacity(); ++i)
+      count += records0[i].check != 0;
+
+  return count;
+}
+
+
+/// ResultStore::probe() looks for the position and, if it was searched to at
+/// least 'depth', fills 'line' with the stored result and returns true. Only
+/// the legal part of the PV is returned, in case the key is of another
+/// position. A line which failed high or low is complete one ply less deep.
+
+bool ResultStore::probe(const Position& pos, int depth, UCI::PVLine& line) {
+
+  if (!header)
+      return false;
+
+  Key key = store_key(pos);
+  Record* b = bucket(key);
+
+  for (int i = 0; i < BucketSize; ++i)
+  {
+      Record r;
+      std::memcpy(&r, &b[i], sizeof(Record)); // Another process may be writing it
+
+      if ((r.check ^ content_hash(r)) != key)
+          continue;
+
+      if (r.depth - (r.bound ? 1 : 0) < depth)
+          break;
+
+      Position p;
+      StateInfo st[1 + sizeof(r.pv) / sizeof(r.pv[0])];
+      p.set(pos.fen(), pos.is_chess960(), pos.subvariant(), &st[0], pos.this_thread());
+
+      line = UCI::PVLine();
+      line.depth = r.depth;
+      line.seldepth = r.selDepth;
+      line.multipv = 1;
+      line.score = Value(r.score);
+      line.bound = r.bound;
+      line.time = 1;
+
+      for (int j = 0; j < r.length; ++j)
+      {
+          Move m = Move(r.pv[j]);
+          if (!p.pseudo_legal(m) || !p.legal(m))
+              break;
+
+          line.pv.push_back(m);
+          p.do_move(m, st[j + 1]);
+      }
+
+      if (line.pv.empty())
+          break;
+
+      b[i].stamp = ++header->clock;
+      ++hits;
+      return true;
+  }
+
+  ++misses;
+  return false;
+}
+
+
+/// ResultStore::save() stores the line sent for a position, unless the store
+/// has a deeper result for it. Otherwise the record of the position, an empty
+/// one or the least recently used one of the bucket is replaced.
+
+void ResultStore::save(const Position& pos, const UCI::PVLine& line) {
+
+  if (!header || line.pv.empty())
+      return;
+
+  Key key = store_key(pos);
+  Record* b = bucket(key);
+  Record* replace = b;
+
+  for (int i = 0; i < BucketSize; ++i)
+  {
+      if ((b[i].check ^ content_hash(b[i])) == key)
+      {
+          if (b[i].depth > line.depth)
+              return;
+
+          replace = &b[i];
+          break;
+      }
+
+      if (!b[i].check || b[i].stamp < replace->stamp)
+          replace = &b[i];
+
+      if (!b[i].check)
+          break;
+  }
+
+  if (replace->check && (replace->check ^ content_hash(*replace)) != key)
+      ++evictions;
+
+  Record r = {};
+  r.stamp = ++header->clock;
+  r.depth = uint8_t(std::min(line.depth, 255));
+  r.selDepth = uint8_t(std::min(line.seldepth, 255));
+  r.bound = uint8_t(line.bound);
+  r.length = uint8_t(std::min(line.pv.size(), sizeof(r.pv) / sizeof(r.pv[0])));
+  r.score = int16_t(line.score);
+
+  for (int j = 0; j < r.length; ++j)
+      r.pv[j] = uint16_t(line.pv[j]);
+
+  r.check = key ^ content_hash(r);
+  std::memcpy(replace, &r, sizeof(Record));
+  ++writes;
+}
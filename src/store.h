@@ -0,0 +1,85 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STORE_H_INCLUDED
+#define STORE_H_INCLUDED
+
+#include <string>
+
+#include "position.h"
+#include "search.h"
+#include "types.h"
+#include "uci.h"
+
+/// ResultStore is a file of search results, mapped in memory and shared by all
+/// the engines and processes which open it. A result is the last PV line sent
+/// for a position, stored under Position::key(), the variant and the 50-move
+/// counter, but not the moves which led to the position. Records of 64
+/// bytes are grouped in buckets of 4, and the least recently used one of the
+/// bucket is replaced when a new position does not fit. The file is in the
+/// byte order of the machine. Writes of several processes are not locked: a
+/// record is checked against its key and content, so that a torn one is just
+/// a miss.
+
+class ResultStore {
+
+  struct Record {
+    uint64_t check;    // Key xor a hash of the content
+    uint32_t stamp;    // Last use, not part of the content
+    uint8_t depth, selDepth, bound, length;
+    int16_t score;
+    uint16_t pv[23];
+  };
+
+  static_assert(sizeof(Record) == 64, "Record size incorrect");
+
+  static const int BucketSize = 4;
+
+  struct Header {
+    char magic[8];
+    uint64_t bucketCount;
+    uint32_t clock;    // Stamp of the last use, approximate between processes
+  };
+
+public:
+ ~ResultStore() { close(); }
+  bool open(const std::string& fileName, size_t mbSize);
+  void close();
+  bool probe(const Position& pos, int depth, UCI::PVLine& line);
+  void save(const Position& pos, const UCI::PVLine& line);
+  size_t bytes() const { return mappedSize; }
+  size_t records() const;
+  size_t capacity() const { return header ? size_t(header->bucketCount) * BucketSize : 0; }
+  static bool applies(const Search::LimitsType& limits);
+
+  uint64_t hits = 0, misses = 0, writes = 0, evictions = 0; // Of this engine
+
+private:
+  Record* bucket(Key key) const { return records0 + (key & (header->bucketCount - 1)) * BucketSize; }
+  static Key store_key(const Position& pos);
+  static uint64_t content_hash(const Record& r);
+
+  Header* header = nullptr;
+  Record* records0 = nullptr;
+  void* mapping = nullptr;
+  size_t mappedSize = 0;
+};
+
+#endif // #ifndef STORE_H_INCLUDED
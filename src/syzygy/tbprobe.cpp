@@ -20,15 +20,18 @@
 #include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>   // For std::memset
 #include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
 #include <sstream>
 #include <type_traits>
 
 #include "../bitboard.h"
+#include "../engine.h"
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
@@ -37,7 +40,10 @@
 
 #include "tbprobe.h"
 
-#ifndef _WIN32
+#if defined(__EMSCRIPTEN__)
+#include <emscripten.h>
+#include <unordered_map>
+#elif !defined(_WIN32)
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -50,8 +56,6 @@
 
 using namespace Tablebases;
 
-int Tablebases::MaxCardinality;
-
 namespace {
 
 const char* WdlSuffixes[SUBVARIANT_NB] = {
@@ -278,6 +282,9 @@ struct PairsData {
     SparseEntry* sparseIndex;      // Partial indices into blockLength[]
     size_t sparseIndexSize;        // Size of SparseIndex[] table
     uint8_t* data;                 // Start of Huffman compressed data
+#ifdef __EMSCRIPTEN__
+    int file;                      // Index of the remote file, see Remote::Files
+#endif
     std::vector<uint64_t> base64;  // base64[l - min_sym_len] is the 64bit-padded lowest symbol of length l
     std::vector<uint8_t> symlen;   // Number of values (-1) represented by a given Huffman symbol: 1..256
     Piece pieces[TBPIECES];        // Position pieces: the order of pieces defines the groups
@@ -523,7 +530,11 @@ template<typename T, int LE> T number(void* addr)
     return v;
 }
 
-class HashTable {
+} // namespace
+
+// Tables is a hash table of the entries of the tables found by init(), with the
+// paths where their files are opened on the first probe.
+class Tablebases::Tables {
 
     typedef std::pair<WDLEntry*, DTZEntry*> EntryPair;
     typedef std::pair<Key, EntryPair> Entry;
@@ -572,38 +583,255 @@ public:
       return nullptr;
   }
 
-  void clear() {
-      std::memset(hashTable, 0, sizeof(hashTable));
-      wdlTable.clear();
-      dtzTable.clear();
-  }
   size_t size() const { return wdlTable.size(); }
   void insert(const std::vector<PieceType>& w, const std::vector<PieceType>& b, Variant variant);
+
+  std::string paths;
+  int maxCardinality = 0;
+  uint8_t generation; // To tell the entries of the caches for other tables
 };
 
-HashTable EntryTable;
+namespace {
+
+Mutex TablesMutex; // Guards the map below and the set up of the index tables
+std::map<std::pair<std::string, Variant>, std::weak_ptr<Tables>> AllTables;
+uint8_t Generation; // Of the last tables created, guarded by TablesMutex
+
+#ifdef __EMSCRIPTEN__
+
+// In the web build the tables are fetched over HTTP. When a table is probed for
+// the first time, its prefix up to the compressed data is fetched, afterwards
+// the data is fetched in chunks on demand and kept in an LRU cache. Nothing
+// waits for the network: a probe fails until the parts of the table it needs
+// have arrived, which happens on the event loop between two search steps.
+namespace Remote {
+
+const size_t PrefixChunk  = 64 * 1024;
+const size_t ChunkSize    = 16 * 1024;
+const size_t ChunkOverlap = 2048; // Blocks have at most 1024 bytes, plus the bits read ahead
+const int MaxPending      = 8;    // Probes miss without fetching beyond this
+
+struct File {
+    enum State { Idle, Fetching, Ready, Failed };
+
+    // The prefix is 64 byte aligned like a mapped file, see do_init()
+    uint8_t* prefix() { return (uint8_t*)(((uintptr_t)buffer.data() + 0x3F) & ~uintptr_t(0x3F)); }
+
+    std::string paths, name; // The URL is found in the listings of the paths
+    State state;
+    uint64_t size;   // File size, known after the first response
+    size_t want;     // Bytes of the prefix to fetch
+    size_t fetched;
+    std::vector<uint8_t> buffer;
+};
+
+struct Chunk {
+    uint64_t key;              // File index and chunk number
+    bool ready;
+    std::vector<uint8_t> data; // ChunkSize + ChunkOverlap bytes from the start of the chunk
+};
+
+int Pending;
+std::vector<File> Files;                        // Kept for the life of the module
+std::unordered_map<std::string, int> FileIndex; // By paths and name
+std::list<Chunk> Chunks;       // Most recently used first
+std::unordered_map<uint64_t, std::list<Chunk>::iterator> ChunkIndex;
+size_t MaxChunks;
+
+// fetch() requests bytes [begin, end) of a file, the response is passed on to
+// tb_fetched(). Chunk is the chunk number, or -1 for the prefix.
+void fetch(int file, int chunk, uint64_t begin, uint64_t end) {
+
+    ++Pending;
+
+    EM_ASM_({
+        var xhr = new XMLHttpRequest();
+        xhr.open('GET', Module['syzygyFiles'][UTF8ToString($0)][UTF8ToString($1)]);
+        xhr.setRequestHeader('Range', 'bytes=' + $2 + '-' + ($3 - 1));
+        xhr.responseType = 'arraybuffer';
+        xhr.onloadend = function () {
+            var data = xhr.status == 206 ? new Uint8Array(xhr.response)
+                     : xhr.status == 200 ? new Uint8Array(xhr.response).subarray($2, $3) : null;
+            var range = String(xhr.getResponseHeader('Content-Range')).split('/')[1];
+            var size = range ? +range : data ? xhr.response.byteLength : 0;
+            var ptr = data ? Module['_malloc'](data.length) : 0;
+            if (data) HEAPU8.set(data, ptr);
+            Module['_tb_fetched']($4, $5, ptr, data ? data.length : -1, size);
+        };
+        xhr.send(null);
+    }, Files[file].paths.c_str(), Files[file].name.c_str(), double(begin), double(end), file, chunk);
+}
+
+// data() returns the address of the byte at 'addr', which points into the
+// table as if it was mapped, or nullptr if the chunk is not in the cache yet.
+const uint8_t* data(int file, const uint8_t* addr) {
+
+    File& f = Files[file];
+    uint64_t offset = uintptr_t(addr) - uintptr_t(f.prefix()); // Modulo 2^32, tables are smaller
+
+    if (offset + ChunkOverlap <= f.fetched || f.fetched >= f.size)
+        return addr;
+
+    uint64_t chunk = offset / ChunkSize, key = (uint64_t(file) << 32) | chunk;
+    auto it = ChunkIndex.find(key);
+
+    if (it != ChunkIndex.end())
+    {
+        if (!it->second->ready)
+            return nullptr;
+
+        Chunks.splice(Chunks.begin(), Chunks, it->second);
+        return it->second->data.data() + offset % ChunkSize;
+    }
+
+    if (Pending >= MaxPending)
+        return nullptr;
+
+    // Take a new chunk or reuse the least recently used one that has arrived
+    auto slot = Chunks.end();
+
+    if (Chunks.size() < MaxChunks)
+        slot = Chunks.insert(Chunks.begin(), Chunk{ key, false, std::vector<uint8_t>(ChunkSize + ChunkOverlap) });
+    else
+    {
+        for (auto c = Chunks.end(); c != Chunks.begin(); )
+            if ((--c)->ready)
+            {
+                slot = c;
+                break;
+            }
+
+        if (slot == Chunks.end())
+            return nullptr;
+
+        ChunkIndex.erase(slot->key);
+        slot->key = key;
+        slot->ready = false;
+        std::fill(slot->data.begin(), slot->data.end(), 0);
+        Chunks.splice(Chunks.begin(), Chunks, slot);
+    }
+
+    ChunkIndex[key] = slot;
+    fetch(file, int(chunk), chunk * ChunkSize, std::min(chunk * ChunkSize + ChunkSize + ChunkOverlap, f.size));
+    return nullptr;
+}
+
+} // namespace Remote
+
+class TBFile {
+
+    int file; // Index in Remote::Files, -1 if not found
+
+public:
+    // Look for the file among the tables named at the paths, which are URLs of
+    // directory listings or of any text files naming the tables, separated by
+    // ";". The tables are fetched from the directory of the listing.
+    //
+    // Example:
+    // https://example.com/syzygy/345/;https://example.com/syzygy/6/list.txt
+    static void list(const std::string& paths) {
+
+        std::stringstream ss(paths);
+        std::string path;
+
+        EM_ASM_({
+            Module['syzygyFiles'] = Module['syzygyFiles'] || {};
+            Module['syzygyFiles'][UTF8ToString($0)] = {};
+        }, paths.c_str());
+
+        while (std::getline(ss, path, ';'))
+            EM_ASM_({
+                var files = Module['syzygyFiles'][UTF8ToString($1)];
+                var url = UTF8ToString($0);
+                var file = url.split('/').pop();
+                var base = file.indexOf('.') < 0 ? url + (file ? '/' : "") : url.slice(0, url.lastIndexOf('/') + 1);
+                var xhr = new XMLHttpRequest();
+                xhr.open('GET', url, false);
+                try { xhr.send(null); } catch (e) { return; }
+                if (xhr.status != 200) return;
+                (xhr.responseText.match(/[KQRBNP]+v[KQRBNP]+[.][a-z]+/g) || []).forEach(function (name) {
+                    if (!files[name]) files[name] = base + name;
+                });
+            }, path.c_str(), paths.c_str());
+    }
+
+    TBFile(const std::string& paths, const std::string& f) : file(-1) {
+
+        auto it = Remote::FileIndex.find(paths + '\n' + f);
+
+        if (it != Remote::FileIndex.end())
+            file = it->second;
+
+        else if (EM_ASM_INT({ return !!Module['syzygyFiles'][UTF8ToString($0)][UTF8ToString($1)]; }, paths.c_str(), f.c_str()))
+        {
+            file = Remote::FileIndex[paths + '\n' + f] = int(Remote::Files.size());
+            Remote::Files.push_back({ paths, f, Remote::File::Idle, ~0ULL, Remote::PrefixChunk, 0, {} });
+        }
+    }
+
+    bool is_open() const { return file >= 0; }
+    void close() {}
+
+    // Map the fetched prefix of the file, or start fetching it. The mapping is
+    // the file index plus one, the table is pending until it is complete().
+    uint8_t* map(void** baseAddress, uint64_t* mapping, const uint8_t* TB_MAGIC) {
+
+        assert(is_open());
+
+        Remote::File& f = Remote::Files[file];
+        *mapping = file + 1;
+        *baseAddress = nullptr;
+
+        if (f.state == Remote::File::Idle && Remote::Pending < Remote::MaxPending)
+        {
+            f.state = Remote::File::Fetching;
+            Remote::fetch(file, -1, f.fetched, std::min(uint64_t(f.want), f.size));
+        }
+
+        if (f.state != Remote::File::Ready)
+            return nullptr;
+
+        if (f.fetched < 4 || memcmp(f.prefix(), TB_MAGIC, 4)) {
+            std::cerr << "Corrupted table in file " << f.name << std::endl;
+            f.state = Remote::File::Failed;
+            return nullptr;
+        }
+
+        *baseAddress = f.prefix();
+        return f.prefix() + 4;
+    }
+
+    static bool pending(uint64_t mapping) {
+
+        return    mapping
+               && (   Remote::Files[mapping - 1].state == Remote::File::Idle
+                   || Remote::Files[mapping - 1].state == Remote::File::Fetching);
+    }
+
+    static void unmap(void*, uint64_t) {} // The prefix stays with the file
+};
+
+#else
 
 class TBFile : public std::ifstream {
 
     std::string fname;
 
 public:
-    // Look for and open the file among the Paths directories where the .rtbw
+    // Look for and open the file among the paths directories where the .rtbw
     // and .rtbz files can be found. Multiple directories are separated by ";"
     // on Windows and by ":" on Unix-based operating systems.
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
-    static std::string Paths;
-
-    TBFile(const std::string& f) {
+    TBFile(const std::string& paths, const std::string& f) {
 
 #ifndef _WIN32
         const char SepChar = ':';
 #else
         const char SepChar = ';';
 #endif
-        std::stringstream ss(Paths);
+        std::stringstream ss(paths);
         std::string path;
 
         while (std::getline(ss, path, SepChar)) {
@@ -689,7 +917,7 @@ public:
     }
 };
 
-std::string TBFile::Paths;
+#endif // __EMSCRIPTEN__
 
 WDLEntry::WDLEntry(const std::string& code, Variant v) {
 
@@ -774,7 +1002,9 @@ DTZEntry::~DTZEntry() {
         delete pieceTable.precomp;
 }
 
-void HashTable::insert(const std::vector<PieceType>& w, const std::vector<PieceType>& b, Variant variant) {
+} // namespace
+
+void Tables::insert(const std::vector<PieceType>& w, const std::vector<PieceType>& b, Variant variant) {
 
     if (!WdlSuffixes[variant])
         return;
@@ -787,14 +1017,14 @@ void HashTable::insert(const std::vector<PieceType>& w, const std::vector<PieceT
     for (PieceType pt: b)
         code += PieceToChar[pt];
 
-    TBFile file(code + WdlSuffixes[variant]);
+    TBFile file(paths, code + WdlSuffixes[variant]);
 
     if (file.is_open()) // Only WDL file is checked
         file.close();
     else if (variant != CHESS_VARIANT && code.find("P") == std::string::npos &&
              PawnlessWdlSuffixes[variant])
     {
-        TBFile pawnlessFile(code + PawnlessWdlSuffixes[variant]);
+        TBFile pawnlessFile(paths, code + PawnlessWdlSuffixes[variant]);
         if (!pawnlessFile.is_open()) // Only WDL file is checked
             return;
         pawnlessFile.close();
@@ -802,7 +1032,7 @@ void HashTable::insert(const std::vector<PieceType>& w, const std::vector<PieceT
     else
         return;
 
-    MaxCardinality = std::max((int)(w.size() + b.size()), MaxCardinality);
+    maxCardinality = std::max((int)(w.size() + b.size()), maxCardinality);
 
     wdlTable.emplace_back(code, variant);
     dtzTable.emplace_back(wdlTable.back());
@@ -811,6 +1041,8 @@ void HashTable::insert(const std::vector<PieceType>& w, const std::vector<PieceT
     insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
 }
 
+namespace {
+
 // TB tables are compressed with canonical Huffman code. The compressed data is divided into
 // blocks of size d->sizeofBlock, and each block stores a variable number of symbols.
 // Each symbol represents either a WDL or a (remapped) DTZ value, or a pair of other symbols
@@ -872,7 +1104,14 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
         offset -= d->blockLength[block++] + 1;
 
     // Finally, we find the start address of our block of canonical Huffman symbols
+#ifdef __EMSCRIPTEN__
+    uint32_t* ptr = (uint32_t*)Remote::data(d->file, d->data + block * d->sizeofBlock);
+
+    if (!ptr) // Not fetched yet
+        return -1;
+#else
     uint32_t* ptr = (uint32_t*)(d->data + block * d->sizeofBlock);
+#endif
 
     // Read the first 64 bits in our block, this is a (truncated) sequence of
     // unknown number of symbols of unknown length but we know the first one
@@ -1279,7 +1518,14 @@ encode_remaining:
     }
 
     // Now that we have the index, decompress the pair and get the score
-    return map_score(entry, tbFile, decompress_pairs(d, idx), wdl);
+    int value = decompress_pairs(d, idx);
+
+#ifdef __EMSCRIPTEN__
+    if (value < 0)
+        return *result = FAIL, T();
+#endif
+
+    return map_score(entry, tbFile, value, wdl);
 }
 
 // Group together pieces that will be encoded together. The general rule is that
@@ -1485,8 +1731,12 @@ void do_init(Entry& e, T& p, uint8_t* data) {
 
     for (File f = FILE_A; f <= MaxFile; ++f) {
 
-        for (int i = 0; i < Sides; i++)
+        for (int i = 0; i < Sides; i++) {
             item(p, i, f).precomp = new PairsData();
+#ifdef __EMSCRIPTEN__
+            item(p, i, f).precomp->file = int(e.mapping) - 1;
+#endif
+        }
 
         int order[][2] = { { *data & 0xF, pp ? *(data + 1) & 0xF : 0xF },
                            { *data >>  4, pp ? *(data + 1) >>  4 : 0xF } };
@@ -1535,8 +1785,42 @@ void do_init(Entry& e, T& p, uint8_t* data) {
         }
 }
 
+#ifdef __EMSCRIPTEN__
+// complete() checks that the fetched prefix of a remote table reaches up to the
+// compressed data, otherwise the rest is fetched on the next probe. The offset
+// of the data is found with do_init() on a copy of the entry and of the prefix,
+// padded with zeros so that it is safe to read beyond the fetched bytes.
+template<typename Entry>
+bool complete(Entry& e, uint8_t* data) {
+
+    const size_t Padding = 256 * 1024; // More than the symbol tables of a table
+
+    Remote::File& f = Remote::Files[e.mapping - 1];
+
+    if (f.fetched >= f.size)
+        return true;
+
+    std::vector<uint8_t> buffer(f.fetched + Padding + 64);
+    uint8_t* copy = (uint8_t*)(((uintptr_t)buffer.data() + 0x3F) & ~uintptr_t(0x3F));
+    std::memcpy(copy, f.prefix(), f.fetched);
+
+    Entry tmp(e);
+    data = copy + (data - f.prefix());
+    tmp.hasPawns ? do_init(tmp, tmp.pawnTable, data) : do_init(tmp, tmp.pieceTable, data);
+
+    size_t end = (tmp.hasPawns ? item(tmp.pawnTable, 0, FILE_A).precomp->data
+                               : item(tmp.pieceTable, 0, FILE_A).precomp->data) - copy;
+    if (end <= f.fetched)
+        return true;
+
+    f.want = end;
+    f.state = Remote::File::Idle;
+    return false;
+}
+#endif
+
 template<typename Entry>
-void* init(Entry& e, const Position& pos) {
+void* init(Entry& e, const Position& pos, const std::string& paths) {
 
     const bool IsWDL = std::is_same<Entry, WDLEntry>::value;
 
@@ -1723,15 +2007,21 @@ void* init(Entry& e, const Position& pos) {
     const char** PawnlessSuffixes = IsWDL ? PawnlessWdlSuffixes : PawnlessDtzSuffixes;
 
     uint8_t* data = nullptr;
-    TBFile file(fname + Suffixes[e.variant]);
+    TBFile file(paths, fname + Suffixes[e.variant]);
 
     if (file.is_open())
         data = file.map(&e.baseAddress, &e.mapping, TB_MAGIC[e.variant][IsWDL]);
     else if (fname.find("P") == std::string::npos && PawnlessSuffixes[e.variant]) {
-        TBFile pawnlessFile(fname + PawnlessSuffixes[e.variant]);
+        TBFile pawnlessFile(paths, fname + PawnlessSuffixes[e.variant]);
         data = pawnlessFile.map(&e.baseAddress, &e.mapping, PAWNLESS_TB_MAGIC[e.variant][IsWDL]);
     }
 
+#ifdef __EMSCRIPTEN__
+    // Until the fetched prefix is complete, the table is missing but not ready
+    if (TBFile::pending(e.mapping) || (data && !complete(e, data)))
+        return nullptr;
+#endif
+
     if (data) {
         e.hasPawns ? do_init(e, e.pawnTable, data) : do_init(e, e.pieceTable, data);
 
@@ -1790,9 +2080,10 @@ T probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
     if (!(pos.pieces() ^ pos.pieces(KING)))
         return T(WDLDraw); // KvK
 
-    E* entry = EntryTable.get<E>(pos.material_key());
+    Tables* tables = CurrentEngine->tablebases.get();
+    E* entry = tables ? tables->get<E>(pos.material_key()) : nullptr;
 
-    if (!entry || !init(*entry, pos))
+    if (!entry || !init(*entry, pos, tables->paths))
         return *result = FAIL, T();
 
     return do_probe_table(pos, entry, wdl, result);
@@ -1968,14 +2259,66 @@ WDLScore search(Position& pos, ProbeState* result) {
 
 } // namespace
 
-void Tablebases::init(const std::string& paths, Variant variant) {
+#ifdef __EMSCRIPTEN__
+extern "C" void tb_fetched(int file, int chunk, uint8_t* bytes, int length, double size) {
 
-    EntryTable.clear();
-    MaxCardinality = 0;
-    TBFile::Paths = paths;
+    --Remote::Pending;
 
-    if (paths.empty() || paths == "<empty>")
-        return;
+    if (chunk < 0)
+    {
+        Remote::File& f = Remote::Files[file];
+
+        if (length < 0)
+            f.state = Remote::File::Failed;
+        else
+        {
+            // Grow the prefix, keeping it aligned
+            std::vector<uint8_t> prefix(f.prefix(), f.prefix() + f.fetched);
+            f.buffer.assign(f.fetched + length + 64, 0);
+            std::copy(prefix.begin(), prefix.end(), f.prefix());
+            std::copy(bytes, bytes + length, f.prefix() + f.fetched);
+            f.fetched += length;
+            f.size = uint64_t(size);
+            f.state = Remote::File::Ready;
+        }
+    }
+    else
+    {
+        auto it = Remote::ChunkIndex.find((uint64_t(file) << 32) | uint64_t(chunk));
+
+        if (it != Remote::ChunkIndex.end())
+        {
+            if (length < 0) // Fetched again when probed next time
+            {
+                Remote::Chunks.erase(it->second);
+                Remote::ChunkIndex.erase(it);
+            }
+            else
+            {
+                std::memcpy(it->second->data.data(), bytes, std::min(size_t(length), it->second->data.size()));
+                it->second->ready = true;
+            }
+        }
+    }
+
+    free(bytes);
+}
+
+void Tablebases::resize_cache(size_t mbSize) {
+
+    Remote::MaxChunks = mbSize * 1024 * 1024 / (Remote::ChunkSize + Remote::ChunkOverlap);
+
+    // Chunks still being fetched are dropped when they arrive
+    Remote::Chunks.clear();
+    Remote::ChunkIndex.clear();
+}
+#endif
+
+namespace {
+
+// init_indices() sets up the tables for the encoding of the positions, which
+// are the same for all the tablebases.
+void init_indices() {
 
     // MapB1H1H7[] encodes a square below a1-h8 diagonal to 0..27
     int code = 0;
@@ -2080,78 +2423,135 @@ void Tablebases::init(const std::string& paths, Variant variant) {
             // After a file is traversed, store the cumulated per-file index
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
+}
+
+} // namespace
+
+// Tablebases::init() gives the engine the tables found at the paths for the
+// variant. They are set up by the first engine asking for them and shared by
+// the next ones, so they are never changed while another engine probes them.
+void Tablebases::init(const std::string& paths, Variant variant) {
+
+#ifndef NO_THREADS
+    Threads.main()->wait_for_search_finished(); // Its search may probe the old ones
+#endif
+
+    TablesPtr tables;
+
+    if (paths.empty() || paths == "<empty>")
+    {
+        CurrentEngine->tablebases = tables;
+        return;
+    }
+
+    std::unique_lock<Mutex> lk(TablesMutex);
+
+    std::weak_ptr<Tables>& shared = AllTables[std::make_pair(paths, variant)];
+    tables = shared.lock();
+
+    if (!tables)
+    {
+        static bool indicesReady = false;
+
+        if (!indicesReady)
+            init_indices(), indicesReady = true;
+
+        tables = std::make_shared<Tables>();
+        tables->paths = paths;
+
+        if (++Generation == 0) // Zero is for the empty entries
+            Generation = 1;
+        tables->generation = Generation;
+
+#ifdef __EMSCRIPTEN__
+        TBFile::list(paths);
+#endif
 
 #ifdef ANTI
-    if (main_variant(variant) == ANTI_VARIANT) {
-        for (PieceType p1 = PAWN; p1 <= KING; ++p1) {
-            for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
-                EntryTable.insert({p1}, {p2}, variant);
+        if (main_variant(variant) == ANTI_VARIANT) {
+            for (PieceType p1 = PAWN; p1 <= KING; ++p1) {
+                for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
+                    tables->insert({p1}, {p2}, variant);
 
-                for (PieceType p3 = PAWN; p3 <= KING; ++p3)
-                    EntryTable.insert({p1, p2}, {p3}, variant);
+                    for (PieceType p3 = PAWN; p3 <= KING; ++p3)
+                        tables->insert({p1, p2}, {p3}, variant);
 
-                for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
-                    for (PieceType p4 = PAWN; p4 <= KING; ++p4) {
-                        EntryTable.insert({p1, p2, p3}, {p4}, variant);
+                    for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
+                        for (PieceType p4 = PAWN; p4 <= KING; ++p4) {
+                            tables->insert({p1, p2, p3}, {p4}, variant);
 
-                        for (PieceType p5 = PAWN; p5 <= p4; ++p5)
-                            EntryTable.insert({p1, p2, p3}, {p4, p5}, variant);
-                    }
+                            for (PieceType p5 = PAWN; p5 <= p4; ++p5)
+                                tables->insert({p1, p2, p3}, {p4, p5}, variant);
+                        }
+
+                        for (PieceType p4 = PAWN; p4 <= p3; ++p4) {
+                            for (PieceType p5 = PAWN; p5 <= KING; ++p5) {
+                                tables->insert({p1, p2, p3, p4}, {p5}, variant);
 
-                    for (PieceType p4 = PAWN; p4 <= p3; ++p4) {
-                        for (PieceType p5 = PAWN; p5 <= KING; ++p5) {
-                            EntryTable.insert({p1, p2, p3, p4}, {p5}, variant);
+                                for (PieceType p6 = PAWN; p6 <= p5; ++p6)
+                                    tables->insert({p1, p2, p3, p4}, {p5, p6}, variant);
+                            }
 
-                            for (PieceType p6 = PAWN; p6 <= p5; ++p6)
-                                EntryTable.insert({p1, p2, p3, p4}, {p5, p6}, variant);
+                            for (PieceType p5 = PAWN; p5 <= p4; ++p5)
+                                for (PieceType p6 = PAWN; p6 <= KING; ++p6)
+                                    tables->insert({p1, p2, p3, p4, p5}, {p6}, variant);
                         }
 
-                        for (PieceType p5 = PAWN; p5 <= p4; ++p5)
-                            for (PieceType p6 = PAWN; p6 <= KING; ++p6)
-                                EntryTable.insert({p1, p2, p3, p4, p5}, {p6}, variant);
+                        for (PieceType p4 = PAWN; p4 <= p1; ++p4)
+                            for (PieceType p5 = PAWN; p5 <= (p1 == p4 ? p2 : p4); ++p5)
+                                for (PieceType p6 = PAWN; p6 <= ((p1 == p4 && p5 == p2) ? p3 : p5); ++p6)
+                                    tables->insert({p1, p2, p3}, {p4, p5, p6}, variant);
                     }
 
-                    for (PieceType p4 = PAWN; p4 <= p1; ++p4)
-                        for (PieceType p5 = PAWN; p5 <= (p1 == p4 ? p2 : p4); ++p5)
-                            for (PieceType p6 = PAWN; p6 <= ((p1 == p4 && p5 == p2) ? p3 : p5); ++p6)
-                                EntryTable.insert({p1, p2, p3}, {p4, p5, p6}, variant);
+                    for (PieceType p3 = PAWN; p3 <= p1; ++p3)
+                        for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
+                            tables->insert({p1, p2}, {p3, p4}, variant);
                 }
-
-                for (PieceType p3 = PAWN; p3 <= p1; ++p3)
-                    for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
-                        EntryTable.insert({p1, p2}, {p3, p4}, variant);
             }
-        }
-    } else
+        } else
 #endif
 
-    for (PieceType p1 = PAWN; p1 < KING; ++p1) {
-        EntryTable.insert({KING, p1}, {KING}, variant);
+        for (PieceType p1 = PAWN; p1 < KING; ++p1) {
+            tables->insert({KING, p1}, {KING}, variant);
 
-        for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
-            EntryTable.insert({KING, p1, p2}, {KING}, variant);
-            EntryTable.insert({KING, p1}, {KING, p2}, variant);
+            for (PieceType p2 = PAWN; p2 <= p1; ++p2) {
+                tables->insert({KING, p1, p2}, {KING}, variant);
+                tables->insert({KING, p1}, {KING, p2}, variant);
 
-            for (PieceType p3 = PAWN; p3 < KING; ++p3)
-                EntryTable.insert({KING, p1, p2}, {KING, p3}, variant);
+                for (PieceType p3 = PAWN; p3 < KING; ++p3)
+                    tables->insert({KING, p1, p2}, {KING, p3}, variant);
 
-            for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
-                EntryTable.insert({KING, p1, p2, p3}, {KING}, variant);
+                for (PieceType p3 = PAWN; p3 <= p2; ++p3) {
+                    tables->insert({KING, p1, p2, p3}, {KING}, variant);
 
-                for (PieceType p4 = PAWN; p4 <= p3; ++p4)
-                    EntryTable.insert({KING, p1, p2, p3, p4}, {KING}, variant);
+                    for (PieceType p4 = PAWN; p4 <= p3; ++p4)
+                        tables->insert({KING, p1, p2, p3, p4}, {KING}, variant);
 
-                for (PieceType p4 = PAWN; p4 < KING; ++p4)
-                    EntryTable.insert({KING, p1, p2, p3}, {KING, p4}, variant);
-            }
+                    for (PieceType p4 = PAWN; p4 < KING; ++p4)
+                        tables->insert({KING, p1, p2, p3}, {KING, p4}, variant);
+                }
 
-            for (PieceType p3 = PAWN; p3 <= p1; ++p3)
-                for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
-                    EntryTable.insert({KING, p1, p2}, {KING, p3, p4}, variant);
+                for (PieceType p3 = PAWN; p3 <= p1; ++p3)
+                    for (PieceType p4 = PAWN; p4 <= (p1 == p3 ? p2 : p3); ++p4)
+                        tables->insert({KING, p1, p2}, {KING, p3, p4}, variant);
+            }
         }
+
+        shared = tables;
     }
 
-    sync_cout << "info string Found " << EntryTable.size() << " tablebases" << sync_endl;
+    lk.unlock();
+
+    CurrentEngine->tablebases = tables;
+
+    sync_cout << "info string Found " << tables->size() << " tablebases" << sync_endl;
+}
+
+// Tablebases::max_cardinality() is the number of pieces of the largest tables
+// of the engine, or 0 without tables.
+int Tablebases::max_cardinality() {
+
+    return CurrentEngine->tablebases ? CurrentEngine->tablebases->maxCardinality : 0;
 }
 
 // Probe the WDL table for a particular position.
@@ -2168,6 +2568,40 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
     return search(pos, result);
 }
 
+// Probe the WDL table through a cache of the results. A cached result gives
+// *result == OK, even when the probe itself gave another successful state.
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, Cache& cache) {
+
+    const Tables* tables = CurrentEngine->tablebases.get();
+
+    if (!tables)
+        return probe_wdl(pos, result);
+
+    CacheEntry* e = cache[pos.key()];
+
+    if (   e->key32 == uint32_t(pos.key() >> 32)
+        && e->material16 == uint16_t(pos.material_key())
+        && e->generation == tables->generation)
+    {
+        STATS(cache.hits++);
+        *result = OK;
+        return WDLScore(e->wdl);
+    }
+
+    STATS(cache.misses++);
+    WDLScore v = probe_wdl(pos, result);
+
+    if (*result != FAIL) // A failed probe may succeed later, when not cached
+    {
+        e->key32 = uint32_t(pos.key() >> 32);
+        e->material16 = uint16_t(pos.material_key());
+        e->generation = tables->generation;
+        e->wdl = int8_t(v);
+    }
+
+    return v;
+}
+
 // Probe the DTZ table for a particular position.
 // If *result != FAIL, the probe was successful.
 // The return value is from the point of view of the side to move:
@@ -20,6 +20,7 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <memory>
 #include <ostream>
 
 #include "../search.h"
@@ -45,14 +46,37 @@ enum ProbeState {
     THREAT            =  3  // Threatening to force capture in giveaway
 };
 
-extern int MaxCardinality;
+// CacheEntry holds a successful probe_wdl() result, verified by the high 32
+// bits of the position key, 16 bits of the material key and the generation of
+// the tables, which differs for each set of tables init() creates. Each thread has a table of them, probed
+// before the tables by the search.
+struct CacheEntry {
+    uint32_t key32;
+    uint16_t material16;
+    uint8_t generation;
+    int8_t wdl;
+};
+
+typedef HashTable<CacheEntry> Cache;
+const size_t CacheSize = 8192; // Default number of entries
+
+// Tables are the tables found at a path for a variant. They don't change once
+// set up, and are shared by the engines with the same path and variant until
+// the last of them lets them go.
+class Tables;
+typedef std::shared_ptr<Tables> TablesPtr;
 
 void init(const std::string& paths, Variant variant);
+int max_cardinality();
 WDLScore probe_wdl(Position& pos, ProbeState* result);
+WDLScore probe_wdl(Position& pos, ProbeState* result, Cache& cache);
 int probe_dtz(Position& pos, ProbeState* result);
 bool root_probe(Position& pos, Search::RootMoves& rootMoves, Value& score);
 bool root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, Value& score);
 void filter_root_moves(Position& pos, Search::RootMoves& rootMoves);
+#ifdef __EMSCRIPTEN__
+void resize_cache(size_t mbSize);
+#endif
 
 inline std::ostream& operator<<(std::ostream& os, const WDLScore v) {
 
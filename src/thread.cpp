@@ -21,31 +21,31 @@
 #include <algorithm> // For std::count
 #include <cassert>
 
+#include "engine.h"
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
-#ifndef __EMSCRIPTEN__
+#include "uci.h"
+#ifndef NO_SYZYGY
 #include "syzygy/tbprobe.h"
 #endif
 
-#ifndef _WIN32
+#if !defined(_WIN32) && !defined(NO_THREADS)
 void* run_idle_loop(void* thread) {
   static_cast<Thread*>(thread)->idle_loop();
   return nullptr;
 }
 #endif
 
-ThreadPool Threads; // Global object
-
 
 /// Thread constructor launches the thread and waits until it goes to sleep
 /// in idle_loop(). Note that 'searching' and 'exit' should be alredy set.
 
-Thread::Thread(size_t n) : idx(n) {
+Thread::Thread(size_t n) : idx(n), engine(CurrentEngine) {
 
-#ifdef _WIN32
+#if defined(_WIN32)
   stdThread = std::thread(&Thread::idle_loop, this);
-#else
+#elif !defined(NO_THREADS)
   // With increased MAX_MOVES (for variants) the stack can grow larger than the
   // system default. Explicitly set a sufficient stack size.
   pthread_attr_t attr;
@@ -54,9 +54,11 @@ Thread::Thread(size_t n) : idx(n) {
   pthread_create(&nativeThread, &attr, run_idle_loop, this);
 #endif
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_THREADS
   wait_for_search_finished();
 #endif
+  resize_tables();
+  set_variant();
   clear(); // Zero-init histories (based on std::array)
 }
 
@@ -69,10 +71,11 @@ Thread::~Thread() {
   assert(!searching);
 
   exit = true;
+#if defined(_WIN32)
   start_searching();
-#ifdef _WIN32
   stdThread.join();
-#else
+#elif !defined(NO_THREADS)
+  start_searching();
   pthread_join(nativeThread, nullptr);
 #endif
 }
@@ -85,11 +88,97 @@ void Thread::clear() {
   counterMoves.fill(MOVE_NONE);
   mainHistory.fill(0);
 
-  for (auto& to : contHistory)
-      for (auto& h : to)
-          h.fill(0);
+  contHistory.clear();
+  contHistory.at(NO_PIECE, SQ_A1)->fill(Search::CounterMovePruneThreshold - 1);
 
-  contHistory[NO_PIECE][0].fill(Search::CounterMovePruneThreshold - 1);
+#ifdef USE_STATS
+  pawnsTable.hits = pawnsTable.misses = materialTable.hits = materialTable.misses = 0;
+  evalTable.hits = evalTable.misses = 0;
+#ifndef NO_SYZYGY
+  tbCache.hits = tbCache.misses = 0;
+#endif
+  stats = Search::Stats();
+#endif
+}
+
+
+namespace {
+
+  // table_size() returns the number of entries for a pawn or material hash
+  // table, a power of 2. It is given by the option value in KB, or if that is
+  // 0, it is the default size times 'factor', halved while the tables of all
+  // threads would take more than half the Hash, down to a quarter of the default,
+  // which LOW_MEMORY builds always take.
+
+  size_t table_size(int kb, size_t entrySize, size_t defaultSize, int factor) {
+
+    size_t size = 1;
+
+    if (kb)
+    {
+        while (2 * size * entrySize <= size_t(kb) * 1024)
+            size *= 2;
+        return size;
+    }
+
+    size_t budget = size_t(Options["Hash"]) * 1024 * 1024 / 2 / size_t(Options["Threads"]);
+
+#ifdef LOW_MEMORY
+    budget = 0; // Always the smallest size
+#endif
+
+    for (size = defaultSize * factor; size > defaultSize / 4 && size * entrySize > budget; size /= 2) {}
+
+    return size;
+  }
+
+} // namespace
+
+
+/// Thread::resize_tables() sets the size of the pawn, material and eval hash
+/// tables from the "Pawn Hash", "Material Hash" and "Eval Hash" options, and
+/// that of the tablebase cache from "SyzygyProbeCache". With
+/// their default of 0, the sizes depend on Hash and Threads, and are bigger for
+/// the variants which produce many more pawn structures or material
+/// configurations than chess. The eval hash is only there when given a size.
+
+void Thread::resize_tables() {
+
+  Variant v = main_variant(UCI::variant_from_name(Options["UCI_Variant"]));
+  int pawnFactor = 1, materialFactor = 1;
+
+#ifdef CRAZYHOUSE
+  if (v == CRAZYHOUSE_VARIANT)
+      pawnFactor = 4, materialFactor = 4; // Dropped pawns and pieces in hand
+#endif
+#ifdef HORDE
+  if (v == HORDE_VARIANT)
+      pawnFactor = 4;
+#endif
+
+  pawnsTable.resize(table_size(Options["Pawn Hash"], sizeof(Pawns::Entry), Pawns::TableSize, pawnFactor));
+  materialTable.resize(table_size(Options["Material Hash"], sizeof(Material::Entry), Material::TableSize, materialFactor));
+  evalTable.resize(Options["Eval Hash"] ? table_size(Options["Eval Hash"], sizeof(Eval::Entry), 0, 1) : 0);
+#ifndef NO_SYZYGY
+  tbCache.resize(table_size(Options["SyzygyProbeCache"], sizeof(Tablebases::CacheEntry), Tablebases::CacheSize, 1));
+#endif
+}
+
+
+/// Thread::set_variant() adds the specialized endgames of the "UCI_Variant",
+/// the first time it is played. Unless "Keep Variant Data" is set, those of the
+/// other variants are dropped.
+
+void Thread::set_variant() {
+
+  Variant v = main_variant(UCI::variant_from_name(Options["UCI_Variant"]));
+
+  if (!Options["Keep Variant Data"])
+      for (Variant var = CHESS_VARIANT; var < VARIANT_NB; ++var)
+          if (var != v)
+              endgames.clear(var);
+
+  endgames.init(v);
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -98,7 +187,7 @@ void Thread::start_searching() {
 
   std::lock_guard<Mutex> lk(mutex);
   searching = true;
-#ifndef __EMSCRIPTEN__
+#ifndef NO_THREADS
   cv.notify_one(); // Wake up the thread in idle_loop()
 #else
   search();
@@ -121,6 +210,8 @@ void Thread::wait_for_search_finished() {
 
 void Thread::idle_loop() {
 
+  CurrentEngine = engine;
+
   WinProcGroup::bindThisThread(idx);
 
   while (true)
@@ -142,8 +233,8 @@ void Thread::idle_loop() {
 
 /// ThreadPool::init() creates and launches the threads that will go
 /// immediately to sleep in idle_loop. We cannot use the constructor because
-/// Threads is a static object and we need a fully initialized engine at
-/// this point due to allocation of Endgames in the Thread constructor.
+/// the Thread constructor reads the options of the engine, which are set up
+/// after the pool is constructed, see Engine::Engine().
 
 void ThreadPool::init(size_t requested) {
 
@@ -175,19 +266,38 @@ void ThreadPool::set(size_t requested) {
 }
 
 
+/// ThreadPool::resize_tables() resizes the pawn and material hash tables of
+/// all threads, after a change of the options they depend on.
+
+void ThreadPool::resize_tables() {
+
+  for (Thread* th : *this)
+      th->resize_tables();
+}
+
+
+/// ThreadPool::set_variant() prepares all threads for a new "UCI_Variant"
+
+void ThreadPool::set_variant() {
+
+  for (Thread* th : *this)
+      th->set_variant();
+}
+
+
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
 /// returns immediately. Main thread will wake up other threads and start the search.
 
 void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
                                 const Search::LimitsType& limits, bool ponderMode) {
 
-#ifndef __EMSCRIPTEN__
+#ifndef NO_THREADS
   main()->wait_for_search_finished();
 #endif
 
   stopOnPonderhit = stop = false;
   ponder = ponderMode;
-  Search::Limits = limits;
+  Limits = limits;
   Search::RootMoves rootMoves;
 
   for (const auto& m : MoveList<LEGAL>(pos))
@@ -195,8 +305,8 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
           || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), m))
           rootMoves.emplace_back(m);
 
-#ifndef __EMSCRIPTEN__
-  if (!rootMoves.empty())
+#ifndef NO_SYZYGY
+  if (!rootMoves.empty() && !limits.perft)
       Tablebases::filter_root_moves(pos, rootMoves);
 #endif
 
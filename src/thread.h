@@ -31,12 +31,18 @@
 #endif
 #include <vector>
 
+#include "evaluate.h"
 #include "material.h"
 #include "movepick.h"
 #include "pawns.h"
 #include "position.h"
 #include "search.h"
 #include "thread_win32.h"
+#ifndef NO_SYZYGY
+#include "syzygy/tbprobe.h"
+#endif
+
+struct Engine;
 
 
 /// Thread class keeps together all the thread-related stuff. We use
@@ -50,9 +56,9 @@ class Thread {
   ConditionVariable cv;
   size_t idx;
   bool exit = false, searching = true; // Set before starting std::thread
-#ifdef _WIN32
+#if defined(_WIN32)
   std::thread stdThread;
-#else
+#elif !defined(NO_THREADS)
   pthread_t nativeThread;
 #endif
 
@@ -64,12 +70,22 @@ public:
   void search_iteration();
   /* </REFACTORED FOR EMSCRIPTEN> */
   void clear();
+  void resize_tables();
+  void set_variant();
   void idle_loop();
   void start_searching();
   void wait_for_search_finished();
 
+  Engine* const engine; // Owner of the thread, see engine.h
   Pawns::Table pawnsTable;
   Material::Table materialTable;
+  Eval::Table evalTable;
+#ifndef NO_SYZYGY
+  Tablebases::Cache tbCache;
+#endif
+#ifdef USE_STATS
+  Search::Stats stats;
+#endif
   Endgames endgames;
   size_t PVIdx;
   int selDepth;
@@ -81,6 +97,16 @@ public:
   CounterMoveHistory counterMoves;
   ButterflyHistory mainHistory;
   ContinuationHistory contHistory;
+
+  /* <REFACTORED FOR EMSCRIPTEN> */
+  // Iterative deepening state, kept across calls of search_iteration()
+  Search::Stack stack[MAX_PLY+7], *ss; // To reference from (ss-4) and (ss+2)
+  Value bestValue, alpha, beta, delta;
+  Move easyMove;
+  size_t multiPV;
+  bool sharedMultiPV; // "MultiPV Mode" is shared, see Thread::search_iteration()
+  size_t pvLast;      // Last of the lines the current root search looks for
+  /* </REFACTORED FOR EMSCRIPTEN> */
 };
 
 
@@ -92,15 +118,19 @@ struct MainThread : public Thread {
 
   void search() override;
   void check_time();
+  void perft();
+  void mate_search();
 
 /* <REFACTORED FOR EMSCRIPTEN> */
   void after_search();
 /* </REFACTORED FOR EMSCRIPTEN> */
 
+  Thread* bestThread; // Thread of the reported best move, set by after_search()
   bool easyMovePlayed, failedLow;
   double bestMoveChanges;
   Value previousScore;
   int callsCnt;
+  TimePoint lastInfoTime = now(), lastYieldTime = now(); // Used by check_time()
 };
 
 
@@ -114,12 +144,18 @@ struct ThreadPool : public std::vector<Thread*> {
   void exit();       // be initialized and valid during the whole thread lifetime.
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
   void set(size_t);
+  void resize_tables();
+  void set_variant();
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
+  StateListPtr& setup_states()    { return setupStates; } // Of the last 'go'
 
-  std::atomic_bool stop, ponder, stopOnPonderhit;
+  std::atomic_bool stop{false}, ponder{false}, stopOnPonderhit{false};
+#ifdef NO_THREADS
+  void (*searchFinished)() = nullptr; // If set, called at the end of after_search()
+#endif
 
 private:
   StateListPtr setupStates;
@@ -133,6 +169,4 @@ private:
   }
 };
 
-extern ThreadPool Threads;
-
 #endif // #ifndef THREAD_H_INCLUDED
@@ -20,12 +20,11 @@
 
 #include <algorithm>
 
+#include "engine.h"
 #include "search.h"
 #include "timeman.h"
 #include "uci.h"
 
-TimeManagement Time; // Our global time management object
-
 namespace {
 
   enum TimeType { OptimumTime, MaxTime };
@@ -72,6 +71,76 @@ namespace {
 } // namespace
 
 
+/// measure_overhead() compares the clock of a search with the one of our
+/// previous move: the time it was charged, less the time we searched, is the
+/// overhead of the GUI and the transport of the commands. It is only measured
+/// for consecutive moves of a timed game, not after pondering or the end of a
+/// period of a "movestogo" time control, where the clock is not charged that way.
+
+void TimeManagement::measure_overhead(const Search::LimitsType& limits, Color us, int ply) {
+
+  if (!limits.use_time_management() || Options["nodestime"])
+  {
+      last.timed = false; // Skipped, e.g. analysis by the GUI between moves
+      return;
+  }
+
+  if (   last.measurable
+      && last.us == us
+      && last.ply + 2 == ply
+      && last.movesToGo != 1)
+  {
+      int charged = last.time + last.inc - limits.time[us];
+      samples[sampleCount++ % SampleNb] = std::min(std::max(charged - last.elapsed, 0), 5000);
+  }
+
+  last.time = limits.time[us];
+  last.inc = limits.inc[us];
+  last.movesToGo = limits.movestogo;
+  last.ply = ply;
+  last.us = us;
+  last.timed = !Threads.ponder;
+  last.measurable = false;
+}
+
+
+/// played() is called when the best move is sent, the end of the time we are
+/// charged for a move without the overhead.
+
+void TimeManagement::played() {
+
+  if (last.timed)
+      last.elapsed = int(now() - startTime), last.measurable = true;
+}
+
+
+/// overhead() returns the time to keep back for the overhead of each move. With
+/// "Adaptive Overhead" it is the 90th percentile of the last 32 measurements,
+/// once there are 4 of them, else the "Move Overhead" option.
+
+int TimeManagement::overhead() const {
+
+  const int MinSamples = 4;
+  int n = std::min(sampleCount, int(SampleNb));
+
+  if (!Options["Adaptive Overhead"] || n < MinSamples)
+      return Options["Move Overhead"];
+
+  int sorted[SampleNb];
+  std::copy(samples, samples + n, sorted);
+  std::nth_element(sorted, sorted + n * 9 / 10, sorted + n);
+
+  return sorted[n * 9 / 10];
+}
+
+
+/// elapsed() returns the time used so far, in nodes in 'nodes as time' mode
+
+int TimeManagement::elapsed() const {
+  return int(Limits.npmsec ? Threads.nodes_searched() : now() - startTime);
+}
+
+
 /// init() is called at the beginning of the search and calculates the allowed
 /// thinking time out of the time control and current game ply. We support four
 /// different kinds of time controls, passed in 'limits':
@@ -83,10 +152,12 @@ namespace {
 
 void TimeManagement::init(Search::LimitsType& limits, Color us, int ply)
 {
-  int moveOverhead = Options["Move Overhead"];
   int npmsec       = Options["nodestime"];
   bool ponder      = Options["Ponder"];
 
+  measure_overhead(limits, us, ply); // Before the clock is converted to nodes
+  int moveOverhead = overhead();
+
   // If we have to play in 'nodes as time' mode, then convert from time
   // to nodes, and use resulting values in time management formulas.
   // WARNING: Given npms (nodes per millisecond) must be much lower then
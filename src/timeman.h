@@ -31,18 +31,31 @@
 class TimeManagement {
 public:
   void init(Search::LimitsType& limits, Color us, int ply);
+  void played();
   int optimum() const { return optimumTime; }
   int maximum() const { return maximumTime; }
-  int elapsed() const { return int(Search::Limits.npmsec ? Threads.nodes_searched() : now() - startTime); }
+  int elapsed() const;
+  int overhead() const;
 
   int64_t availableNodes; // When in 'nodes as time' mode
 
 private:
+  void measure_overhead(const Search::LimitsType& limits, Color us, int ply);
+
   TimePoint startTime;
   int optimumTime;
   int maximumTime;
-};
 
-extern TimeManagement Time;
+  // The clock at the last search, to measure the overhead from the next one
+  struct LastMove {
+    int time, inc, movesToGo, ply, elapsed;
+    Color us;
+    bool timed, measurable;
+  } last = {};
+
+  static const int SampleNb = 32;
+  int samples[SampleNb];
+  int sampleCount = 0;
+};
 
 #endif // #ifndef TIMEMAN_H_INCLUDED
@@ -22,10 +22,10 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "engine.h"
+#include "misc.h"
 #include "tt.h"
 
-TranspositionTable TT; // Our global transposition table
-
 
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
@@ -38,10 +38,20 @@ void TranspositionTable::resize(size_t mbSize) {
   if (newClusterCount == clusterCount)
       return;
 
-  clusterCount = newClusterCount;
-
   free(mem);
-  mem = calloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1, 1);
+  mem = calloc(newClusterCount * sizeof(Cluster) + CacheLineSize - 1, 1);
+
+  // With a limited heap (e.g. in a browser) a big table can fail to allocate.
+  // If so, report it to the GUI and keep going with a table of the old size.
+  if (!mem && clusterCount)
+  {
+      sync_cout << "info string Failed to allocate " << mbSize
+                << "MB for transposition table, keeping "
+                << (clusterCount * sizeof(Cluster) >> 20) << "MB" << sync_endl;
+
+      newClusterCount = clusterCount;
+      mem = calloc(newClusterCount * sizeof(Cluster) + CacheLineSize - 1, 1);
+  }
 
   if (!mem)
   {
@@ -50,17 +60,21 @@ void TranspositionTable::resize(size_t mbSize) {
       exit(EXIT_FAILURE);
   }
 
+  clusterCount = newClusterCount;
   table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~(CacheLineSize - 1));
 }
 
 
-/// TranspositionTable::clear() overwrites the entire transposition table
-/// with zeros. It is called whenever the table is resized, or when the
-/// user asks the program to clear the table (from the UCI interface).
+/// TranspositionTable::clear() makes all the clusters stale by starting a new
+/// epoch, so that they are zeroed one by one as they are probed. It is called
+/// at every "ucinewgame", and in a single threaded build a big table would take
+/// a noticeable time to overwrite. Only when the epoch counter wraps around,
+/// and old clusters could look current again, is the table really zeroed.
 
 void TranspositionTable::clear() {
 
-  std::memset(table, 0, clusterCount * sizeof(Cluster));
+  if (++epoch16 == 0)
+      std::memset(table, 0, clusterCount * sizeof(Cluster));
 }
 
 
@@ -73,16 +87,20 @@ void TranspositionTable::clear() {
 
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 
-  TTEntry* const tte = first_entry(key);
-  const uint16_t key16 = key >> 48;  // Use the high 16 bits as key inside the cluster
+  Cluster& cluster = table[(size_t)key & (clusterCount - 1)];
+  TTEntry* const tte = &cluster.entry[0];
+  const TTEntry::KeyBits keyBits = TTEntry::key_bits(key); // Used as key inside the cluster
+
+  if (refresh(cluster))
+      return found = false, tte;
 
   for (int i = 0; i < ClusterSize; ++i)
-      if (!tte[i].key16 || tte[i].key16 == key16)
+      if (!tte[i].keyBits || tte[i].keyBits == keyBits)
       {
-          if ((tte[i].genBound8 & 0xFC) != generation8 && tte[i].key16)
+          if ((tte[i].genBound8 & 0xFC) != generation8 && tte[i].keyBits)
               tte[i].genBound8 = uint8_t(generation8 | tte[i].bound()); // Refresh
 
-          return found = (bool)tte[i].key16, &tte[i];
+          return found = (bool)tte[i].keyBits, &tte[i];
       }
 
   // Find an entry to be replaced according to the replacement strategy
@@ -108,6 +126,9 @@ int TranspositionTable::hashfull() const {
   int cnt = 0;
   for (int i = 0; i < 1000 / ClusterSize; i++)
   {
+      if (table[i].epoch16 != epoch16)
+          continue;
+
       const TTEntry* tte = &table[i].entry[0];
       for (int j = 0; j < ClusterSize; j++)
           if ((tte[j].genBound8 & 0xFC) == generation8)
@@ -115,3 +136,179 @@ int TranspositionTable::hashfull() const {
   }
   return cnt;
 }
+
+
+namespace {
+
+  const char TTMagic[] = "SFTT";
+  const uint8_t TTVersion = sizeof(TTEntry::KeyBits) == 2 ? 1 : 2; // Version 2 has 32-bit keys
+  const size_t RecordSize = sizeof(TTEntry::KeyBits) + 8;
+
+  void put_varint(std::string& s, uint64_t v) {
+    for ( ; v >= 0x80; v >>= 7)
+        s += char(v | 0x80);
+    s += char(v);
+  }
+
+  bool get_varint(const std::string& s, size_t& pos, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; pos < s.size() && shift < 64; shift += 7)
+    {
+        uint8_t b = s[pos++];
+        v |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+  }
+
+  void put16(std::string& s, uint16_t v) { s += char(v & 0xFF); s += char(v >> 8); }
+  uint16_t get16(const std::string& s, size_t pos) { return uint8_t(s[pos]) | uint8_t(s[pos + 1]) << 8; }
+
+  void put_key(std::string& s, uint32_t v) {
+    put16(s, uint16_t(v));
+    if (sizeof(TTEntry::KeyBits) > 2)
+        put16(s, uint16_t(v >> 16));
+  }
+
+  uint32_t get_key(const std::string& s, size_t pos) {
+    return sizeof(TTEntry::KeyBits) > 2 ? get16(s, pos) | uint32_t(get16(s, pos + 2)) << 16
+                                        : get16(s, pos);
+  }
+
+} // namespace
+
+
+/// TranspositionTable::save() serializes the non-empty entries of at least
+/// the given depth (in plies), in a format independent of the table size and
+/// cluster layout, but not of the key size, which is given by the version:
+///
+/// "SFTT", version byte, log2 of the cluster count, then for each cluster with
+/// saved entries the cluster index delta as a varint, the number of entries, and
+/// the entries. These are stored as in memory, but little endian and with the
+/// generation relative to the current one, so that load() can rebase it.
+
+std::string TranspositionTable::save(int minDepth, size_t* count) const {
+
+  std::string blob(TTMagic, 4);
+  blob += char(TTVersion);
+  blob += char(msb(clusterCount));
+  *count = 0;
+
+  for (size_t i = 0, last = 0; i < clusterCount; ++i)
+  {
+      const TTEntry* saved[ClusterSize];
+      int n = 0;
+
+      if (table[i].epoch16 != epoch16)
+          continue;
+
+      for (const TTEntry& e : table[i].entry)
+          if (e.keyBits && e.depth8 >= minDepth)
+              saved[n++] = &e;
+
+      if (!n)
+          continue;
+
+      put_varint(blob, i - last);
+      blob += char(n);
+      last = i;
+
+      for (int j = 0; j < n; ++j)
+      {
+          const TTEntry& e = *saved[j];
+          put_key(blob, e.keyBits);
+          put16(blob, e.move16);
+          put16(blob, uint16_t(e.value16));
+          put16(blob, uint16_t(e.eval16));
+          blob += char(((generation8 - (e.genBound8 & 0xFC)) & 0xFC) | e.bound());
+          blob += char(e.depth8);
+      }
+
+      *count += n;
+  }
+
+  return blob;
+}
+
+
+/// TranspositionTable::load() adds the entries of a blob written by save() to
+/// the table, and returns the number of entries read. The cluster index of an
+/// entry holds the low bits of its key, so if the table is smaller than the one
+/// saved the index is masked, and if it is bigger the entry is added to all the
+/// clusters that match the known bits.
+
+size_t TranspositionTable::load(const std::string& blob) {
+
+  if (   blob.size() < 6
+      || blob.compare(0, 4, TTMagic) != 0
+      || uint8_t(blob[4]) != TTVersion
+      || uint8_t(blob[5]) >= 64)
+      return 0;
+
+  const size_t savedCount = size_t(1) << uint8_t(blob[5]);
+  const size_t copies = clusterCount > savedCount ? clusterCount / savedCount : 1;
+  size_t pos = 6, index = 0, count = 0;
+  uint64_t delta;
+
+  while (pos < blob.size() && get_varint(blob, pos, delta) && pos < blob.size())
+  {
+      int n = uint8_t(blob[pos++]);
+
+      index += delta;
+
+      if (pos + n * RecordSize > blob.size())
+          break;
+
+      for (int j = 0; j < n; ++j, pos += RecordSize, ++count)
+      {
+          const size_t p = pos + sizeof(TTEntry::KeyBits);
+          TTEntry e;
+          e.keyBits   = TTEntry::KeyBits(get_key(blob, pos));
+          e.move16    = get16(blob, p);
+          e.value16   = int16_t(get16(blob, p + 2));
+          e.eval16    = int16_t(get16(blob, p + 4));
+          e.genBound8 = uint8_t(((generation8 - (blob[p + 6] & 0xFC)) & 0xFC) | (blob[p + 6] & 0x3));
+          e.depth8    = int8_t(blob[p + 7]);
+
+          for (size_t c = 0; c < copies; ++c)
+              merge((index + c * savedCount) & (clusterCount - 1), e);
+      }
+  }
+
+  return count;
+}
+
+
+/// TranspositionTable::merge() stores an entry in the given cluster. It takes
+/// an empty slot or the one of the same position, otherwise it replaces the
+/// least valuable entry if it is more valuable itself, see probe().
+
+void TranspositionTable::merge(size_t index, const TTEntry& e) {
+
+  TTEntry* const tte = &table[index].entry[0];
+
+  refresh(table[index]);
+
+  auto worth = [&](const TTEntry& t) {
+      return t.depth8 - ((259 + generation8 - t.genBound8) & 0xFC) * 2;
+  };
+
+  TTEntry* replace = tte;
+  for (int i = 0; i < ClusterSize; ++i)
+  {
+      if (tte[i].keyBits == e.keyBits || !tte[i].keyBits)
+      {
+          replace = &tte[i];
+          break;
+      }
+
+      if (worth(tte[i]) < worth(*replace))
+          replace = &tte[i];
+  }
+
+  if (   !replace->keyBits
+      ||  worth(e) > worth(*replace)
+      || (replace->keyBits == e.keyBits && e.depth8 >= replace->depth8))
+      *replace = e;
+}
@@ -21,12 +21,15 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <cstring>   // For std::memset
+#include <string>
+
 #include "misc.h"
 #include "types.h"
 
 /// TTEntry struct is the 10 bytes transposition table entry, defined as below:
 ///
-/// key        16 bit
+/// key        16 bit (32 bit with TT_KEY32, making the entry 12 bytes)
 /// move       16 bit
 /// value      16 bit
 /// eval value 16 bit
@@ -36,27 +39,39 @@
 
 struct TTEntry {
 
+#ifdef TT_KEY32
+  typedef uint32_t KeyBits;
+#else
+  typedef uint16_t KeyBits;
+#endif
+
+  // The high bits of the position key, which are verified within the cluster
+  static KeyBits key_bits(Key k) { return KeyBits(k >> (64 - 8 * sizeof(KeyBits))); }
+
   Move  move()  const { return (Move )move16; }
   Value value() const { return (Value)value16; }
   Value eval()  const { return (Value)eval16; }
   Depth depth() const { return (Depth)(depth8 * int(ONE_PLY)); }
   Bound bound() const { return (Bound)(genBound8 & 0x3); }
+  bool empty()  const { return !keyBits; }
 
   void save(Key k, Value v, Bound b, Depth d, Move m, Value ev, uint8_t g) {
 
     assert(d / ONE_PLY * ONE_PLY == d);
 
     // Preserve any existing move for the same position
-    if (m || (k >> 48) != key16)
+    if (m || key_bits(k) != keyBits)
         move16 = (uint16_t)m;
 
-    // Don't overwrite more valuable entries
-    if (  (k >> 48) != key16
+    // Don't overwrite more valuable entries. The entries are aged by probe(),
+    // which refreshes those it finds: aging them here instead, on the first
+    // save of a search, was no stronger with 64-byte clusters.
+    if (   key_bits(k) != keyBits
         || d / ONE_PLY > depth8 - 4
      /* || g != (genBound8 & 0xFC) // Matching non-zero keys are already refreshed by probe() */
         || b == BOUND_EXACT)
     {
-        key16     = (uint16_t)(k >> 48);
+        keyBits   = key_bits(k);
         value16   = (int16_t)v;
         eval16    = (int16_t)ev;
         genBound8 = (uint8_t)(g | b);
@@ -67,7 +82,7 @@ struct TTEntry {
 private:
   friend class TranspositionTable;
 
-  uint16_t key16;
+  KeyBits  keyBits;
   uint16_t move16;
   int16_t  value16;
   int16_t  eval16;
@@ -77,32 +92,49 @@ private:
 
 
 /// A TranspositionTable consists of a power of 2 number of clusters and each
-/// cluster consists of ClusterSize number of TTEntry. Each non-empty entry
+/// cluster consists of ClusterSize number of TTEntry. The clusters are 32 bytes,
+/// or a whole cache line of 64 bytes with TT_CLUSTER64, holding as many entries
+/// as fit. Each non-empty entry
 /// contains information of exactly one position. The size of a cluster should
 /// divide the size of a cache line size, to ensure that clusters never cross
 /// cache lines. This ensures best cache performance, as the cacheline is
 /// prefetched, as soon as possible.
+///
+/// Clearing the table only increments the epoch of the table. A cluster whose
+/// epoch is different is stale and is zeroed when it is next probed, so that
+/// the table is cleared lazily while being used rather than all at once.
 
 class TranspositionTable {
 
   static const int CacheLineSize = 64;
-  static const int ClusterSize = 3;
-
-  struct Cluster {
+#ifdef TT_CLUSTER64
+  static const int ClusterBytes = 64;
+#else
+  static const int ClusterBytes = 32;
+#endif
+  static const int ClusterSize = (ClusterBytes - 2) / sizeof(TTEntry);
+
+  struct alignas(ClusterBytes) Cluster { // Pad to a divisor of the cache line size
     TTEntry entry[ClusterSize];
-    char padding[2]; // Align to a divisor of the cache line size
+    uint16_t epoch16;
   };
 
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
+  static_assert(ClusterSize >= 3, "Fewer entries per cluster than the default layout");
 
 public:
  ~TranspositionTable() { free(mem); }
   void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
+  static int cluster_size() { return ClusterSize; }
+  static int cluster_bytes() { return ClusterBytes; }
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
+  size_t bytes() const { return clusterCount * sizeof(Cluster); }
   void resize(size_t mbSize);
   void clear();
+  std::string save(int minDepth, size_t* count) const;
+  size_t load(const std::string& blob);
 
   // The lowest order bits of the key are used to get the index of the cluster
   TTEntry* first_entry(const Key key) const {
@@ -110,12 +142,22 @@ public:
   }
 
 private:
-  size_t clusterCount;
-  Cluster* table;
-  void* mem;
-  uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
-};
+  void merge(size_t index, const TTEntry& e);
+
+  // Zeroes a stale cluster. Returns false if it is current and may have entries.
+  bool refresh(Cluster& c) const {
+    if (c.epoch16 == epoch16)
+        return false;
+    std::memset(c.entry, 0, sizeof(c.entry));
+    c.epoch16 = epoch16;
+    return true;
+  }
 
-extern TranspositionTable TT;
+  size_t clusterCount = 0;
+  Cluster* table = nullptr;
+  void* mem = nullptr;
+  uint8_t generation8 = 0; // Size must be not bigger than TTEntry::genBound8
+  uint16_t epoch16 = 0;     // Same as Cluster::epoch16 of the current clusters
+};
 
 #endif // #ifndef TT_H_INCLUDED
@@ -37,6 +37,12 @@
 ///
 /// -DUSE_PEXT    | Add runtime support for use of pext asm-instruction. Works
 ///               | only in 64-bit mode and requires hardware with pext support.
+///
+/// -DNO_THREADS  | Run the search without any native thread. Set automatically
+///               | for Emscripten builds without pthreads support.
+///
+/// -DNO_SYZYGY   | Build without tablebases. Set automatically for Emscripten
+///               | builds with pthreads, which fetch tables on the event loop.
 
 #include <cassert>
 #include <cctype>
@@ -44,6 +50,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <utility>
 #include <vector>
 
 #if defined(_MSC_VER)
@@ -60,12 +67,25 @@
 /// _MSC_VER           Compiler is MSVC or Intel on Windows
 /// _WIN32             Building on Windows (any)
 /// _WIN64             Building on Windows 64 bit
+/// __EMSCRIPTEN__     Compiler is Emscripten (asm.js or WebAssembly)
+/// __EMSCRIPTEN_PTHREADS__  Emscripten with SharedArrayBuffer based pthreads
 
 #if defined(_WIN64) && defined(_MSC_VER) // No Makefile used
 #  include <intrin.h> // Microsoft header for _BitScanForward64()
 #  define IS_64BIT
 #endif
 
+// Web workers without SharedArrayBuffer cannot block, so the search is split
+// in steps that are scheduled on the event loop of the worker.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__) && !defined(NO_THREADS)
+#  define NO_THREADS
+#endif
+
+// Remote tables arrive on the event loop, which search threads never return to
+#if defined(__EMSCRIPTEN_PTHREADS__) && !defined(NO_SYZYGY)
+#  define NO_SYZYGY
+#endif
+
 #if defined(USE_POPCNT) && (defined(__INTEL_COMPILER) || defined(_MSC_VER))
 #  include <nmmintrin.h> // Intel and Microsoft header for _mm_popcnt_u64()
 #endif
@@ -606,8 +626,8 @@ inline Square to_sq(Move m) {
 
 inline int from_to(Move m) {
 #ifdef CRAZYHOUSE
-  if (type_of(m) == DROP)
-      return (m & 0xFFF) + 0x1000;
+  if (type_of(m) == DROP) // Dropped piece type in place of the from square
+      return (SQUARE_NB + ((m >> 6) & 7)) * SQUARE_NB + (m & 0x3F);
 #endif
  return m & 0xFFF;
 }
@@ -687,4 +707,52 @@ inline Variant main_variant(Variant v) {
   }
 }
 
+/// dispatch() calls F<V>::call(args...) for the main variant v known only at
+/// runtime, V being v as a template argument. It is the way into the code that
+/// is instantiated per variant, like the search and the evaluation.
+template<template<Variant> class F, typename... Args>
+inline auto dispatch(Variant v, Args&&... args) -> decltype(F<CHESS_VARIANT>::call(std::forward<Args>(args)...)) {
+  switch (v)
+  {
+#ifdef ANTI
+  case ANTI_VARIANT:
+      return F<ANTI_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef ATOMIC
+  case ATOMIC_VARIANT:
+      return F<ATOMIC_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef CRAZYHOUSE
+  case CRAZYHOUSE_VARIANT:
+      return F<CRAZYHOUSE_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef HORDE
+  case HORDE_VARIANT:
+      return F<HORDE_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef KOTH
+  case KOTH_VARIANT:
+      return F<KOTH_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef LOSERS
+  case LOSERS_VARIANT:
+      return F<LOSERS_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef RACE
+  case RACE_VARIANT:
+      return F<RACE_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef RELAY
+  case RELAY_VARIANT:
+      return F<RELAY_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+#ifdef THREECHECK
+  case THREECHECK_VARIANT:
+      return F<THREECHECK_VARIANT>::call(std::forward<Args>(args)...);
+#endif
+  default:
+      return F<CHESS_VARIANT>::call(std::forward<Args>(args)...);
+  }
+}
+
 #endif // #ifndef TYPES_H_INCLUDED
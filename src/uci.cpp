@@ -18,11 +18,20 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <sstream>
 #include <string>
+#include <thread>
 
+#include "book.h"
+#include "engine.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
@@ -31,15 +40,18 @@
 #include "tt.h"
 #include "timeman.h"
 #include "uci.h"
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
 #include "syzygy/tbprobe.h"
 #endif
 
 using namespace std;
 
-#ifndef __EMSCRIPTEN__
+namespace PSQT {
+  void init(Variant var);
+}
+
 extern vector<string> setup_bench(const Position&, istream&);
-#endif
+extern string microbench(Variant v, int runs, int ms);
 
 namespace {
 
@@ -85,6 +97,69 @@ namespace {
   };
 
 
+  // The last position set up by position(). GUIs send the whole game again
+  // after each ply, so a command which only adds moves to it keeps the list of
+  // states and plays just the new moves.
+
+  struct PositionSetup {
+    string fen;
+    Variant variant;
+    bool chess960;
+    vector<string> moves;
+  };
+
+  struct Batch;
+  struct BatchFile;
+  struct Bench;
+
+} // namespace
+
+
+/// UCI::Session holds the position set up by the GUI of an engine, with the
+/// related state of the commands. It is created on first use, when the engine
+/// is fully initialized. It is deleted with the engine, after the end of a
+/// running "batch" command.
+
+struct UCI::Session {
+
+  Session() : states(new std::deque<StateInfo>(1)), thread(std::make_shared<Thread>(0)) {
+    pos.set(StartFENs[CHESS_VARIANT], false, CHESS_VARIANT, &states->back(), thread.get());
+  }
+
+#ifndef __EMSCRIPTEN__
+ ~Session() {
+    if (batchThread.joinable())
+        batchThread.join();
+  }
+#endif
+
+  Position pos;
+  StateListPtr states;
+  std::shared_ptr<Thread> thread;
+  PositionSetup lastSetup;
+  Batch* batch = nullptr; // Running uci_batch(), if any
+  Bench* bench = nullptr; // Running bench, if any
+#ifdef __EMSCRIPTEN__
+  string savedTT;         // Kept for tt_data()
+#else
+  std::shared_ptr<BatchFile> batchFile; // Of the last "batch" command
+  std::thread batchThread;              // Running its workers
+#endif
+};
+
+void UCI::delete_session(Session* session) { delete session; }
+
+namespace {
+
+  UCI::Session& ui() {
+
+    if (!CurrentEngine->session)
+        CurrentEngine->session = new UCI::Session;
+
+    return *CurrentEngine->session;
+  }
+
+
   // position() is called when engine receives the "position" UCI command.
   // The function sets up the position described in the given FEN string ("fen")
   // or the starting position ("startpos") and then makes the moves given in the
@@ -94,8 +169,10 @@ namespace {
 
     Move m;
     string token, fen;
+    vector<string> moves;
 
     Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+    bool chess960 = Options["UCI_Chess960"];
 
     is >> token;
     if (token == "startpos")
@@ -109,14 +186,37 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], variant, &states->back(), Threads.main());
+    while (is >> token)
+        moves.push_back(token);
+
+    // After 'go' the states are owned by the threads, see start_thinking()
+    StateListPtr& setup = states.get() ? states : Threads.setup_states();
+    PositionSetup& last = ui().lastSetup;
+    size_t reused = last.moves.size();
+
+    if (   !setup.get()
+        || fen != last.fen
+        || variant != last.variant
+        || chess960 != last.chess960
+        || moves.size() < reused
+        || !std::equal(last.moves.begin(), last.moves.end(), moves.begin()))
+    {
+        states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
+        pos.set(fen, chess960, variant, &states->back(), Threads.main());
+        last = { fen, variant, chess960, {} };
+        reused = 0;
+    }
+    else if (reused)
+        sync_cout << "info string Reused " << reused << " moves" << sync_endl;
+
+    StateListPtr& list = states.get() ? states : Threads.setup_states();
 
     // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+    for (size_t i = reused; i < moves.size() && (m = UCI::to_move(pos, moves[i])) != MOVE_NONE; ++i)
     {
-        states->emplace_back();
-        pos.do_move(m, states->back());
+        list->emplace_back();
+        pos.do_move(m, list->back());
+        last.moves.push_back(moves[i]);
     }
   }
 
@@ -143,7 +243,10 @@ namespace {
         if (name == "UCI_Variant") {
             Variant variant = UCI::variant_from_name(value);
             sync_cout << "info string variant " << (string)Options["UCI_Variant"] << " startpos " << StartFENs[variant] << sync_endl;
-#ifndef __EMSCRIPTEN__
+            PSQT::init(main_variant(variant));
+            Threads.set_variant();
+            Threads.resize_tables();
+#ifndef NO_SYZYGY
             Tablebases::init(Options["SyzygyPath"], variant);
 #endif
         }
@@ -153,17 +256,68 @@ namespace {
   }
 
 
+  // stats() is called when engine receives the "stats" command. It prints the
+  // counters of the searches since the last "ucinewgame", see Search::Stats.
+
+  void stats() {
+
+#ifdef USE_STATS
+    stringstream ss;
+    Search::print_stats(ss);
+    sync_cout << ss.str() << sync_endl;
+#else
+    sync_cout << "info string Statistics are only counted with stats=yes" << sync_endl;
+#endif
+  }
+
+
+  // memory() is called when engine receives the "memory" command. It prints a
+  // JSON line with the bytes held by each part of the engine.
+
+  void memory() {
+
+    stringstream ss;
+#ifndef NO_THREADS
+    Threads.main()->wait_for_search_finished();
+#endif
+    Search::print_memory(ss);
+    sync_cout << "memory " << ss.str() << sync_endl;
+  }
+
+
+#ifndef __EMSCRIPTEN__
+  // store() is called when engine receives the "store" command. It prints a
+  // JSON line with the use of the result store and the hits of this engine.
+
+  void store() {
+
+    const ResultStore& s = CurrentEngine->store;
+#ifndef NO_THREADS
+    Threads.main()->wait_for_search_finished();
+#endif
+
+    sync_cout << "store {\"records\":" << s.records()
+              << ",\"capacity\":" << s.capacity()
+              << ",\"hits\":" << s.hits
+              << ",\"misses\":" << s.misses
+              << ",\"writes\":" << s.writes
+              << ",\"evictions\":" << s.evictions << "}" << sync_endl;
+  }
+#endif
+
+
   // go() is called when engine receives the "go" UCI command. The function sets
   // the thinking time and other parameters from the input string, then starts
   // the search.
 
-  void go(Position& pos, istringstream& is, StateListPtr& states) {
+  void go(Position& pos, istringstream& is, StateListPtr& states, bool silent = false) {
 
     Search::LimitsType limits;
     string token;
     bool ponderMode = false;
 
     limits.startTime = now(); // As early as possible!
+    limits.silent = silent;
 
     while (is >> token)
         if (token == "searchmoves")
@@ -183,43 +337,450 @@ namespace {
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
+#ifndef NO_THREADS
+    // The answers below must come after the "bestmove" of a search still
+    // stopping, and the result store must have its result.
+    Threads.main()->wait_for_search_finished();
+#endif
+
+    // Play a book move at once, unless the GUI waits for "stop" or a mate
+    if (!silent && !ponderMode && !limits.infinite && !limits.perft && !limits.mate)
+    {
+        string selection = Options["Book Selection"];
+        Move m = CurrentEngine->book.probe(pos, selection == "best"     ? Book::BEST
+                                              : selection == "weighted" ? Book::WEIGHTED
+                                                                        : Book::NONE, limits.searchmoves);
+        if (m)
+        {
+            sync_cout << "bestmove " << UCI::move(m, pos.is_chess960()) << sync_endl;
+            return;
+        }
+    }
+
+#ifndef __EMSCRIPTEN__
+    // Answer at once a search to a depth the result store has reached already
+    UCI::PVLine line;
+
+    if (   !silent && !ponderMode && !limits.infinite && limits.depth
+        && ResultStore::applies(limits)
+        && CurrentEngine->store.probe(pos, limits.depth, line))
+    {
+        sync_cout << UCI::pv({ line }, pos.is_chess960())
+                  << "\nbestmove " << UCI::move(line.pv[0], pos.is_chess960());
+
+        if (line.pv.size() > 1)
+            engine_out() << " ponder " << UCI::move(line.pv[1], pos.is_chess960());
+
+        engine_out() << sync_endl;
+        return;
+    }
+#endif
+
     Threads.start_thinking(pos, states, limits, ponderMode);
   }
 
 
-  // bench() is called when engine receives the "bench" command. Firstly
-  // a list of UCI commands is setup according to bench parameters, then
-  // it is run one by one printing a summary at the end.
-
 #ifndef __EMSCRIPTEN__
-  void bench(Position& pos, istream& args, StateListPtr& states) {
+  // savehash() writes the transposition table to a file, optionally only the
+  // entries of at least the given depth: "savehash <file> [<depth>]". Entries
+  // are added back to the table with "loadhash <file>".
 
-    string token;
-    uint64_t num, nodes = 0, cnt = 1;
+  void savehash(istringstream& is) {
 
-    vector<string> list = setup_bench(pos, args);
-    num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0; });
+    string file;
+    int minDepth = DEPTH_NONE / ONE_PLY;
+    size_t count;
 
-    TimePoint elapsed = now();
+    is >> file >> minDepth;
+    ofstream os(file, ios::binary);
+    string blob = TT.save(minDepth, &count);
+
+    if (os.write(blob.data(), blob.size()))
+        sync_cout << "info string Saved " << count << " hash entries to " << file << sync_endl;
+    else
+        sync_cout << "info string Could not write " << file << sync_endl;
+  }
+
+  void loadhash(istringstream& is) {
+
+    string file;
+    is >> file;
+    ifstream in(file, ios::binary);
+    string blob((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    if (in)
+        sync_cout << "info string Loaded " << TT.load(blob) << " hash entries from " << file << sync_endl;
+    else
+        sync_cout << "info string Could not read " << file << sync_endl;
+  }
 
-    for (const auto& cmd : list)
+  // makebook() writes a book for "Book File" from a file of games, one per line
+  // like the arguments of "position": "makebook <games> <book> [plies <n>]".
+  // The weight of a move is the number of times it was played in a position,
+  // within the first 'plies' (20 by default) of the games. The games start
+  // from the position of the current UCI_Variant.
+
+  void makebook(istringstream& is) {
+
+    string gamesFile, bookFile, token;
+    int plies = 20;
+
+    is >> gamesFile >> bookFile;
+    while (is >> token)
+        if (token == "plies")
+            is >> plies;
+
+    ifstream in(gamesFile);
+    if (!in)
     {
-        istringstream is(cmd);
-        is >> skipws >> token;
+        sync_cout << "info string Could not read " << gamesFile << sync_endl;
+        return;
+    }
 
-        if (token == "go")
+    Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+    bool chess960 = Options["UCI_Chess960"];
+    std::map<std::pair<Key, uint16_t>, int> counts;
+    string line;
+    size_t games = 0;
+
+    while (getline(in, line))
+    {
+        istringstream ls(line);
+        string fen;
+        Position pos;
+        StateListPtr states(new std::deque<StateInfo>(1));
+        Move m;
+
+        if (!(ls >> token))
+            continue;
+
+        if (token == "startpos")
+            fen = StartFENs[variant], ls >> token; // Consume "moves"
+        else if (token == "fen")
+            while (ls >> token && token != "moves")
+                fen += token + " ";
+        else
+            continue;
+
+        pos.set(fen, chess960, variant, &states->back(), Threads.main());
+        ++games;
+
+        for (int ply = 0; ply < plies && ls >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE; ++ply)
         {
-            cerr << "\nPosition: " << cnt++ << '/' << num << endl;
-            go(pos, is, states);
-            Threads.main()->wait_for_search_finished();
-            nodes += Threads.nodes_searched();
+            if (Book::encode(m))
+                ++counts[{ pos.key(), Book::encode(m) }];
+
+            states->emplace_back();
+            pos.do_move(m, states->back());
         }
-        else if (token == "setoption")  setoption(is);
-        else if (token == "position")   position(pos, is, states);
-        else if (token == "ucinewgame") Search::clear();
     }
 
-    elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
+    vector<Book::Entry> entries;
+    for (const auto& c : counts)
+        entries.push_back({ c.first.first, c.first.second, uint16_t(std::min(c.second, 0xFFFF)) });
+
+    string blob = Book::serialize(entries);
+    ofstream os(bookFile, ios::binary);
+
+    if (os.write(blob.data(), blob.size()))
+        sync_cout << "info string Wrote " << entries.size() << " entries from "
+                  << games << " games to " << bookFile << sync_endl;
+    else
+        sync_cout << "info string Could not write " << bookFile << sync_endl;
+  }
+
+  // tables() writes the tables of Bitboards::print_tables() and
+  // Bitbases::print_tables() to bitboard_tables.h and bitbase_tables.h in the
+  // current directory, for a build with baked=yes.
+
+  void tables() {
+
+    ofstream bitboards("bitboard_tables.h"), bitbases("bitbase_tables.h");
+
+    Bitboards::print_tables(bitboards);
+    Bitbases::print_tables(bitbases);
+
+    if (bitboards && bitbases)
+        sync_cout << "info string Wrote bitboard_tables.h and bitbase_tables.h" << sync_endl;
+    else
+        sync_cout << "info string Could not write the tables" << sync_endl;
+  }
+#endif
+
+
+  // Batch runs the positions given to uci_batch() one after the other with the
+  // same limits and without clearing the TT in between. Results are collected
+  // as a JSON array that is printed as a single "batch" line at the end.
+
+  struct Batch {
+
+    vector<string> positions;
+    string limits;
+    size_t next = 0;
+    stringstream results;
+  };
+
+  // write_result() writes the fields of the result of the last search as JSON,
+  // without the braces around them.
+
+  void write_result(ostream& os, const Position& pos) {
+
+    const Thread* th = Threads.main()->bestThread;
+    const Search::RootMove& rm = th->rootMoves[0];
+    Value v = rm.score;
+    bool chess960 = pos.is_chess960();
+
+    os << "\"bestmove\":\"" << UCI::move(rm.pv[0], chess960) << "\"";
+
+    if (v != -VALUE_INFINITE)
+    {
+        stringstream score(UCI::value(v));
+        string unit, value;
+        score >> unit >> value;
+        os << ",\"score\":{\"" << unit << "\":" << value << "}"
+           << ",\"bound\":\"" << (  rm.pv[0] == MOVE_NONE ? "exact"
+                                    : v >= th->beta  ? "lower"
+                                    : v <= th->alpha ? "upper" : "exact") << "\"";
+    }
+
+    os << ",\"depth\":" << th->completedDepth / ONE_PLY
+       << ",\"seldepth\":" << rm.selDepth
+       << ",\"nodes\":" << Threads.nodes_searched()
+       << ",\"pv\":[";
+
+    for (size_t i = 0; i < rm.pv.size() && rm.pv[i] != MOVE_NONE; ++i)
+        os << (i ? ",\"" : "\"") << UCI::move(rm.pv[i], chess960) << "\"";
+
+    os << "]";
+  }
+
+  void add_result(Batch& batch, const Position& pos) {
+
+    batch.results << (batch.next > 1 ? ",{" : "{");
+    write_result(batch.results, pos);
+    batch.results << "}";
+  }
+
+  // The error given for a batch record without the kings of the variant
+  const char* const NoKingsError = "missing or extra kings";
+
+  // has_kings() tells whether the piece placement of a FEN has the kings which
+  // the position and the search of the variant take for granted: one of each
+  // color, but none of the horde and any number in antichess. In atomic one of
+  // them may have been blown up.
+
+  bool has_kings(const string& placement, Variant v) {
+
+    // The 8 ranks only, not the pieces in hand of crazyhouse
+    size_t end = 0;
+    for (int ranks = 1; end < placement.size() && placement[end] != '['; ++end)
+        if (placement[end] == '/' && ++ranks > 8)
+            break;
+
+    auto white = std::count(placement.begin(), placement.begin() + end, 'K');
+    auto black = std::count(placement.begin(), placement.begin() + end, 'k');
+
+#ifdef ANTI
+    if (main_variant(v) == ANTI_VARIANT)
+        return true;
+#endif
+#ifdef HORDE
+    if (main_variant(v) == HORDE_VARIANT)
+        return white + black == 1;
+#endif
+#ifdef ATOMIC
+    if (main_variant(v) == ATOMIC_VARIANT)
+        return white <= 1 && black <= 1 && white + black >= 1;
+#endif
+    (void)v;
+    return white == 1 && black == 1;
+  }
+
+  // search_record() starts the search of a position given like the arguments
+  // of the "position" command or as a plain FEN, with the limits given like
+  // for "go". It returns false, without setting up the position, if it lacks
+  // the kings of the variant.
+
+  bool search_record(const string& record, const string& limits) {
+
+    UCI::Session& state = ui();
+    istringstream is(record);
+    string token, placement;
+    is >> token;
+
+    if (token == "fen")
+        is >> placement;
+
+    else if (token != "startpos") // Allow plain FEN strings
+        placement = token, is.str("fen " + record);
+
+    if (   token != "startpos"
+        && !has_kings(placement, UCI::variant_from_name(Options["UCI_Variant"])))
+        return false;
+
+    is.clear(), is.seekg(0);
+    position(state.pos, is, state.states);
+
+    istringstream ls(limits);
+    go(state.pos, ls, state.states, true);
+    return true;
+  }
+
+  // run_batch() starts the search of the next position. Without threads the
+  // search returns immediately and the batch goes on from the searchFinished
+  // callback, otherwise we wait here for the search to finish.
+
+  void run_batch() {
+
+    UCI::Session& state = ui();
+    Batch& batch = *state.batch;
+
+    while (batch.next < batch.positions.size())
+    {
+        if (!search_record(batch.positions[batch.next++], batch.limits))
+        {
+            batch.results << (batch.next > 1 ? "," : "") << "{\"error\":\"" << NoKingsError << "\"}";
+            continue;
+        }
+
+#ifdef NO_THREADS
+        return;
+#else
+        Threads.main()->wait_for_search_finished();
+        add_result(batch, state.pos);
+#endif
+    }
+
+    sync_cout << "batch [" << batch.results.str() << "]" << sync_endl;
+
+#ifdef NO_THREADS
+    Threads.searchFinished = nullptr;
+#endif
+    delete state.batch;
+    state.batch = nullptr;
+  }
+
+#ifdef NO_THREADS
+  void batch_search_finished() {
+
+    add_result(*ui().batch, ui().pos);
+    run_batch();
+  }
+#endif
+
+
+  // Bench runs the UCI commands of setup_bench() one after the other, as many
+  // times as requested, and keeps the nodes, time and hashfull of each search.
+  // Like a batch, without threads it goes on from the searchFinished callback.
+
+  struct BenchSample {
+    uint64_t nodes;
+    TimePoint time;
+    int hashfull;
+  };
+
+  struct Bench {
+
+    vector<string> list;
+    size_t next = 0, searches = 0, search = 0; // Searches per run, index in the run
+    int runs = 1, run = 0;
+    bool json = false;
+    vector<string> variants, fens;             // Of each search of a run
+    vector<vector<BenchSample>> samples;       // Of each search, one per run
+    TimePoint start, searchStart;
+  };
+
+  void add_sample(Bench& bench, const Position& pos) {
+
+    if (!bench.run)
+    {
+        bench.variants.push_back(Options["UCI_Variant"]);
+        bench.fens.push_back(pos.fen());
+        bench.samples.emplace_back();
+    }
+
+    bench.samples[bench.search++].push_back({ Threads.nodes_searched(),
+                                              now() - bench.searchStart, TT.hashfull() });
+  }
+
+  // write_stats() writes the mean and standard deviation of the values as JSON
+
+  void write_stats(ostream& os, const string& name, const vector<double>& values) {
+
+    double mean = 0, var = 0;
+
+    for (double v : values)
+        mean += v / values.size();
+
+    for (double v : values)
+        var += (v - mean) * (v - mean) / std::max(values.size() - 1, size_t(1));
+
+    os << "\"" << name << "\":{\"mean\":" << mean << ",\"stddev\":" << std::sqrt(var) << "}";
+  }
+
+  // bench_report() prints the JSON line of a bench: the nodes, time, nps and
+  // hashfull of each search and the total nodes, time and nps of each run,
+  // averaged over the runs.
+
+  void bench_report(const Bench& bench) {
+
+    stringstream ss;
+    vector<double> nodes, time, nps, hashfull;
+    vector<BenchSample> totals(bench.runs, BenchSample());
+
+    ss << std::fixed << std::setprecision(1) << "bench {\"runs\":" << bench.runs << ",\"positions\":[";
+
+    for (size_t i = 0; i < bench.samples.size(); ++i)
+    {
+        nodes.clear(), time.clear(), nps.clear(), hashfull.clear();
+
+        for (size_t r = 0; r < bench.samples[i].size(); ++r)
+        {
+            const BenchSample& s = bench.samples[i][r];
+            nodes.push_back(s.nodes);
+            time.push_back(s.time);
+            nps.push_back(1000.0 * s.nodes / std::max(s.time, TimePoint(1)));
+            hashfull.push_back(s.hashfull);
+            totals[r].nodes += s.nodes;
+            totals[r].time += s.time;
+        }
+
+        ss << (i ? ",{" : "{") << "\"variant\":\"" << bench.variants[i]
+           << "\",\"fen\":\"" << bench.fens[i] << "\",";
+        write_stats(ss, "nodes", nodes), ss << ",";
+        write_stats(ss, "time", time), ss << ",";
+        write_stats(ss, "nps", nps), ss << ",";
+        write_stats(ss, "hashfull", hashfull), ss << "}";
+    }
+
+    nodes.clear(), time.clear(), nps.clear();
+
+    for (const BenchSample& t : totals)
+    {
+        nodes.push_back(t.nodes);
+        time.push_back(t.time);
+        nps.push_back(1000.0 * t.nodes / std::max(t.time, TimePoint(1)));
+    }
+
+    ss << "],\"total\":{";
+    write_stats(ss, "nodes", nodes), ss << ",";
+    write_stats(ss, "time", time), ss << ",";
+    write_stats(ss, "nps", nps), ss << "}}";
+
+    sync_cout << ss.str() << sync_endl;
+  }
+
+  // bench_summary() prints the totals of a bench and the hit rates of the
+  // pawn and material hash tables to stderr.
+
+  void bench_summary(const Bench& bench) {
+
+    TimePoint elapsed = now() - bench.start + 1; // Ensure positivity to avoid a 'divide by zero'
+    uint64_t nodes = 0;
+
+    for (const auto& samples : bench.samples)
+        for (const BenchSample& s : samples)
+            nodes += s.nodes;
 
     dbg_print(); // Just before exiting
 
@@ -227,90 +788,503 @@ namespace {
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+#ifdef USE_STATS
+    uint64_t hits[2] = {}, probes[2] = {};
+
+    for (Thread* th : Threads)
+    {
+        hits[0] += th->pawnsTable.hits;
+        hits[1] += th->materialTable.hits;
+        probes[0] += th->pawnsTable.hits + th->pawnsTable.misses;
+        probes[1] += th->materialTable.hits + th->materialTable.misses;
+    }
+
+    cerr << "Pawn hash hits  : " << 100 * hits[0] / max(probes[0], uint64_t(1)) << "% of " << probes[0]
+         << " (" << Threads.main()->pawnsTable.size() << " entries)"
+         << "\nMat. hash hits  : " << 100 * hits[1] / max(probes[1], uint64_t(1)) << "% of " << probes[1]
+         << " (" << Threads.main()->materialTable.size() << " entries)" << endl;
+#endif
+  }
+
+  // run_bench() runs the commands of the bench up to the next search. Without
+  // threads the search returns immediately, and the bench goes on from the
+  // searchFinished callback, otherwise we wait here for the search to finish.
+
+  void run_bench() {
+
+    UCI::Session& state = ui();
+    Bench& bench = *state.bench;
+
+    while (true)
+    {
+        if (bench.next == bench.list.size())
+        {
+            if (++bench.run == bench.runs)
+                break;
+
+            bench.next = bench.search = 0;
+        }
+
+        istringstream is(bench.list[bench.next++]);
+        string token;
+        is >> skipws >> token;
+
+        if (token == "go")
+        {
+            if (!bench.json)
+                cerr << "\nPosition: " << bench.search + 1 << '/' << bench.searches << endl;
+
+            bench.searchStart = now();
+            go(state.pos, is, state.states, bench.json);
+
+#ifdef NO_THREADS
+            if (!Limits.perft) // Perft is done without scheduling
+                return;
+#else
+            Threads.main()->wait_for_search_finished();
+#endif
+            add_sample(bench, state.pos);
+        }
+        else if (token == "setoption")  setoption(is);
+        else if (token == "position")   position(state.pos, is, state.states);
+        else if (token == "ucinewgame") Search::clear();
+    }
+
+    if (bench.json)
+        bench_report(bench);
+    else
+        bench_summary(bench);
+
+#ifdef NO_THREADS
+    Threads.searchFinished = nullptr;
+#endif
+    delete state.bench;
+    state.bench = nullptr;
+  }
+
+#ifdef NO_THREADS
+  void bench_search_finished() {
+
+    add_sample(*ui().bench, ui().pos);
+    run_bench();
   }
 #endif
 
-} // namespace
+  // bench() is called when engine receives the "bench" command. Firstly a list
+  // of UCI commands is setup according to bench parameters, see setup_bench(),
+  // then it is run one by one printing a summary at the end. The parameters
+  // may be followed by "runs <n>" to repeat the list, and by "json" to print
+  // the results as a JSON line instead, which is the default in the web build.
 
+  void bench(istream& args) {
+
+    UCI::Session& state = ui();
+
+    if (state.bench) // Already running
+        return;
 
-/// UCI::loop() waits for a command from stdin, parses it and calls the appropriate
-/// function. Also intercepts EOF from stdin to ensure gracefully exiting if the
-/// GUI dies unexpectedly. When called with some command line arguments, e.g. to
-/// run 'bench', once the command is executed the function returns immediately.
-/// In addition to the UCI ones, also some additional debug commands are supported.
+    Bench* bench = new Bench;
+    string token, params;
+
+    while (args >> token)
+        if (token == "runs")      args >> bench->runs;
+        else if (token == "json") bench->json = true;
+        else                      params += token + " ";
+
+#ifdef __EMSCRIPTEN__
+    bench->json = true; // Nothing reads stderr in a web worker
+#endif
+
+    istringstream is(params);
+    bench->list = setup_bench(state.pos, is);
+    bench->runs = std::max(bench->runs, 1);
+    bench->searches = count_if(bench->list.begin(), bench->list.end(),
+                               [](const string& s) { return s.find("go ") == 0; });
+    bench->start = now();
+    state.bench = bench;
+
+#ifdef NO_THREADS
+    Threads.searchFinished = bench_search_finished;
+#endif
+    run_bench();
+  }
+
+  // microbench() is called when engine receives the "microbench" command, with
+  // optional variant names (or "all"), "runs <n>" and "time <ms>" per run. It
+  // prints a JSON line with the ns per operation of the engine primitives for
+  // each variant, see microbench() in benchmark.cpp, to compare builds.
+
+  void microbench(istream& args) {
+
+    string token, current = Options["UCI_Variant"];
+    vector<string> names;
+    int runs = 5, ms = 100;
+
+    while (args >> token)
+        if (token == "runs")      args >> runs;
+        else if (token == "time") args >> ms;
+        else if (token == "all")
+        {
+            for (Variant v = CHESS_VARIANT; v < VARIANT_NB; ++v)
+                names.push_back(variants[v]);
+        }
+        else if (std::find(variants.begin(), variants.end(), token) != variants.end())
+            names.push_back(token);
+
+    if (names.empty())
+        names.push_back(current);
+
+#ifndef NO_THREADS
+    Threads.main()->wait_for_search_finished();
+#endif
+
+    Endgames& endgames = Threads.main()->endgames;
+    stringstream ss;
+    ss << "microbench {\"runs\":" << std::max(runs, 1) << ",\"time\":" << ms << ",\"variants\":[";
+
+    // The tables of the variants are set up directly rather than selecting them
+    // as "UCI_Variant", and the endgames added are dropped again afterwards.
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        Variant v = UCI::variant_from_name(names[i]);
+        bool loaded = !endgames.empty(main_variant(v));
+
+        PSQT::init(main_variant(v));
+        endgames.init(main_variant(v));
+        ss << (i ? "," : "") << ::microbench(v, std::max(runs, 1), ms);
+
+        if (!loaded)
+            endgames.clear(main_variant(v));
+    }
+
+    ss << "]}";
+
+    sync_cout << ss.str() << sync_endl;
+  }
 
 #ifndef __EMSCRIPTEN__
-void UCI::loop(int argc, char* argv[]) {
+  // BatchFile is the input of the "batch" command, read line by line by the
+  // workers as they become idle, so that the load is balanced between them.
+  // Once stopped, the workers stop their searches and read no more lines.
+
+  struct BatchFile {
+
+    ifstream in;
+    size_t lineNo = 0, records = 0;
+    string limits; // Default limits, for the records without their own
+    vector<Engine*> engines; // One per worker
+    bool stopped = false, finished = false;
+    Mutex mutex;
+
+    bool next(size_t& n, string& record, string& recordLimits) {
+
+      std::lock_guard<Mutex> lock(mutex);
+      string line;
+
+      while (!stopped && getline(in, line))
+      {
+          ++lineNo;
+          size_t sep = line.find(';');
+          record = line.substr(0, sep);
+
+          if (record.find_first_not_of(" \t\r") == string::npos)
+              continue;
+
+          recordLimits = sep == string::npos ? limits : line.substr(sep + 1);
+          n = lineNo;
+          ++records;
+          return true;
+      }
+      return false;
+    }
 
-  Position pos;
-  string token, cmd;
-  StateListPtr states(new std::deque<StateInfo>(1));
-  auto uiThread = std::make_shared<Thread>(0);
+    void stop() {
 
-  pos.set(StartFENs[CHESS_VARIANT], false, CHESS_VARIANT, &states->back(), uiThread.get());
+      std::lock_guard<Mutex> lock(mutex);
+      stopped = true;
 
-  for (int i = 1; i < argc; ++i)
-      cmd += std::string(argv[i]) + " ";
+      for (Engine* e : engines)
+          e->threads.stop = true;
+    }
 
-  do {
-      if (argc == 1 && !getline(cin, cmd)) // Block here waiting for input or EOF
-          cmd = "quit";
-#else
-extern "C" void uci_command(const char *c_cmd) {
-  static bool initialized = false;
-  static Position pos;
-  static StateListPtr states(new std::deque<StateInfo>(1));
-  static auto uiThread = std::make_shared<Thread>(0);
-  if (!initialized) {
-    pos.set(StartFENs[CHESS_VARIANT], false, CHESS_VARIANT, &states->back(), uiThread.get());
-    initialized = true;
+    bool running() {
+
+      std::lock_guard<Mutex> lock(mutex);
+      return !finished;
+    }
+  };
+
+  void batch_worker(BatchFile& file, Engine* engine) {
+
+    CurrentEngine = engine;
+    size_t n;
+    string record, limits;
+
+    while (file.next(n, record, limits))
+    {
+        stringstream ss;
+        ss << "{\"line\":" << n << ",";
+
+        if (search_record(record, limits))
+        {
+            // A stop may have come before the search started, which clears it
+            {
+                std::lock_guard<Mutex> lock(file.mutex);
+                if (file.stopped)
+                    Threads.stop = true;
+            }
+
+            Threads.main()->wait_for_search_finished();
+            write_result(ss, ui().pos);
+        }
+        else
+            ss << "\"error\":\"" << NoKingsError << "\"";
+
+        sync_cout << ss.str() << "}" << sync_endl;
+    }
   }
 
-  std::string token, cmd(c_cmd);
-#endif  // __EMSCRIPTEN__
+  // run_batch_file() runs the workers of a "batch" command until the file is
+  // done or the batch is stopped, then deletes their engines and prints the
+  // time taken. It runs on a thread of its own, so that the engine goes on
+  // reading commands meanwhile.
+
+  void run_batch_file(std::shared_ptr<BatchFile> file, Engine* parent) {
+
+    CurrentEngine = parent; // For the output
+    vector<std::thread> threads;
+    TimePoint elapsed = now();
+
+    for (Engine* e : file->engines)
+        threads.emplace_back(batch_worker, std::ref(*file), e);
+
+    for (std::thread& th : threads)
+        th.join();
 
-      istringstream is(cmd);
+    std::lock_guard<Mutex> lock(file->mutex);
 
-      token.clear(); // Avoid a stale if getline() returns empty or blank line
-      is >> skipws >> token;
+    for (Engine* e : file->engines)
+        delete e;
 
-      // The GUI sends 'ponderhit' to tell us the user has played the expected move.
-      // So 'ponderhit' will be sent if we were told to ponder on the same move the
-      // user has played. We should continue searching but switch from pondering to
-      // normal search. In case Threads.stopOnPonderhit is set we are waiting for
-      // 'ponderhit' to stop the search, for instance if max search depth is reached.
-      if (    token == "quit"
-          ||  token == "stop"
-          || (token == "ponderhit" && Threads.stopOnPonderhit))
-          Threads.stop = true;
+    file->engines.clear();
+    file->finished = true;
 
-      else if (token == "ponderhit")
-          Threads.ponder = false; // Switch to normal search
+    elapsed = now() - elapsed;
+    sync_cout << "info string Searched " << file->records << " positions in " << elapsed << " ms"
+              << (file->stopped ? ", stopped" : "") << sync_endl;
+  }
+
+  // batch() is called when engine receives the "batch" command, e.g. "batch
+  // games.txt workers 8 sharehash depth 16". Each line of the file is a position
+  // like for uci_batch(), optionally followed by ';' and its own limits. The
+  // positions are searched by single threaded copies of the engine, one per
+  // worker, each printing a JSON line per result as soon as it is done. The
+  // workers split the Hash between them, unless "sharehash" is given. The batch
+  // goes on in the background until done or until "stop" or "quit".
+
+  void batch(istringstream& is) {
+
+    UCI::Session& state = ui();
+    auto file = std::make_shared<BatchFile>();
+    string token, name;
+    size_t workers = std::thread::hardware_concurrency();
+    bool shareTT = false;
+
+    if (state.batchFile && state.batchFile->running())
+    {
+        sync_cout << "info string A batch is running" << sync_endl;
+        return;
+    }
+
+    is >> name;
+    file->in.open(name);
+
+    if (!file->in)
+    {
+        sync_cout << "info string Could not read " << name << sync_endl;
+        return;
+    }
+
+    while (is >> token)
+        if (token == "workers")        is >> workers;
+        else if (token == "sharehash") shareTT = true;
+        else                           file->limits += token + " ";
+
+    workers = std::max(workers, size_t(1));
+    size_t hashMB = shareTT ? 0 : std::max(size_t(Options["Hash"]) / workers, size_t(1));
+
+    for (size_t i = 0; i < workers; ++i)
+        file->engines.push_back(new Engine(*CurrentEngine, hashMB));
+
+    if (state.batchThread.joinable())
+        state.batchThread.join();
+
+    state.batchFile = file;
+    state.batchThread = std::thread(run_batch_file, file, CurrentEngine);
+  }
+
+  // stop_batch() stops the running "batch" command, if any
+
+  void stop_batch() {
+
+    if (ui().batchFile)
+        ui().batchFile->stop();
+  }
+#endif
+
+} // namespace
+
+
+/// uci_batch() searches a list of positions, one per line in the same format
+/// as the arguments of the "position" command or as a plain FEN, with limits
+/// given like for "go", e.g. "depth 12". When all are done one line is printed:
+///
+///   batch [{"bestmove":"e2e4","score":{"cp":30},"bound":"exact","depth":12,
+///           "seldepth":16,"nodes":123456,"pv":["e2e4","e7e5"]}, ...]
 
-      else if (token == "uci")
-          sync_cout << "id name " << engine_info(true)
-                    << "\n"       << Options
-                    << "\nuciok"  << sync_endl;
+extern "C" void uci_batch(const char* positions, const char* limits) {
 
-      else if (token == "setoption")  setoption(is);
-      else if (token == "go")         go(pos, is, states);
-      else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") Search::clear();
-      else if (token == "isready")    sync_cout << "readyok" << sync_endl;
+  UCI::Session& state = ui();
 
-      // Additional custom non-UCI commands, mainly for debugging
+  if (state.batch) // Already running
+      return;
+
+  state.batch = new Batch;
+  state.batch->limits = limits;
+
+  istringstream is(positions);
+  string line;
+  while (getline(is, line))
+      if (line.find_first_not_of(" \t\r") != string::npos)
+          state.batch->positions.push_back(line);
+
+#ifdef NO_THREADS
+  Threads.searchFinished = batch_search_finished;
+#endif
+  run_batch();
+}
+
+
+#ifdef __EMSCRIPTEN__
+/// tt_save() serializes the transposition table like "savehash", keeping the
+/// blob until the next call, and returns its size. tt_data() returns its
+/// address. tt_load() adds the entries of a blob to the table and returns the
+/// number of them.
+
+extern "C" int tt_save(int minDepth) {
+
+  size_t count;
+  ui().savedTT = TT.save(minDepth, &count);
+  return int(ui().savedTT.size());
+}
+
+extern "C" const char* tt_data() { return ui().savedTT.data(); }
+
+extern "C" int tt_load(const char* data, int size) {
+
+  return int(TT.load(string(data, size)));
+}
+
+/// book_load() sets the content of a book file as the book, see "makebook",
+/// and returns the number of its entries.
+
+extern "C" int book_load(const char* data, int size) {
+
+  CurrentEngine->book.assign(data, size);
+  return int(CurrentEngine->book.size());
+}
+#endif
+
+
+/// UCI::command() parses a command and calls the appropriate function for the
+/// engine of the calling thread. It returns false on "quit". In addition to the
+/// UCI ones, also some additional debug commands are supported.
+
+bool UCI::command(const string& cmd) {
+
+  Position& pos = ui().pos;
+  StateListPtr& states = ui().states;
+  string token;
+  istringstream is(cmd);
+
+  is >> skipws >> token;
+
+  // The GUI sends 'ponderhit' to tell us the user has played the expected move.
+  // So 'ponderhit' will be sent if we were told to ponder on the same move the
+  // user has played. We should continue searching but switch from pondering to
+  // normal search. In case Threads.stopOnPonderhit is set we are waiting for
+  // 'ponderhit' to stop the search, for instance if max search depth is reached.
+  if (    token == "quit"
+      ||  token == "stop"
+      || (token == "ponderhit" && Threads.stopOnPonderhit))
+  {
+      Threads.stop = true;
+#ifndef __EMSCRIPTEN__
+      if (token != "ponderhit")
+          stop_batch();
+#endif
+  }
+
+  else if (token == "ponderhit")
+      Threads.ponder = false; // Switch to normal search
+
+  else if (token == "uci")
+      sync_cout << "id name " << engine_info(true)
+                << "\n"       << Options
+                << "\nuciok"  << sync_endl;
+
+  else if (token == "setoption")  setoption(is);
+  else if (token == "go")         go(pos, is, states);
+  else if (token == "position")   position(pos, is, states);
+  else if (token == "ucinewgame") Search::clear();
+  else if (token == "isready")    sync_cout << "readyok" << sync_endl;
+  else if (token == "bench")      bench(is);
+  else if (token == "stats")      stats();
+  else if (token == "microbench") microbench(is);
+  else if (token == "memory")     memory();
+
+  // Additional custom non-UCI commands, mainly for debugging
 #ifndef __EMSCRIPTEN__
-      else if (token == "flip")  pos.flip();
-      else if (token == "bench") bench(pos, is, states);
-      else if (token == "d")     sync_cout << pos << sync_endl;
-      else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+  else if (token == "store") store();
+  else if (token == "flip")  pos.flip(), ui().lastSetup = PositionSetup();
+  else if (token == "batch") batch(is);
+  else if (token == "d")     sync_cout << pos << sync_endl;
+  else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+  else if (token == "savehash") savehash(is);
+  else if (token == "loadhash") loadhash(is);
+  else if (token == "tables")   tables();
+  else if (token == "makebook") makebook(is);
 #endif  // __EMSCRIPTEN__
-      else
-          sync_cout << "Unknown command: " << cmd << sync_endl;
+  else
+      sync_cout << "Unknown command: " << cmd << sync_endl;
+
+  return token != "quit";
+}
+
+
+/// UCI::loop() waits for a command from stdin and executes it. Also intercepts
+/// EOF from stdin to ensure gracefully exiting if the GUI dies unexpectedly.
+/// When called with some command line arguments, e.g. to run 'bench', once the
+/// command is executed the function returns immediately.
+
 #ifndef __EMSCRIPTEN__
-  } while (token != "quit" && argc == 1); // Command line args are one-shot
-#endif
+void UCI::loop(int argc, char* argv[]) {
+
+  string cmd;
+
+  for (int i = 1; i < argc; ++i)
+      cmd += std::string(argv[i]) + " ";
+
+  do {
+      if (argc == 1 && !getline(cin, cmd)) // Block here waiting for input or EOF
+          cmd = "quit";
+
+  } while (command(cmd) && argc == 1); // Command line args are one-shot
 }
+#else
+extern "C" void uci_command(const char* cmd) { UCI::command(cmd); }
+#endif  // __EMSCRIPTEN__
 
 
 /// UCI::value() converts a Value to a string suitable for use with the UCI
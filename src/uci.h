@@ -69,17 +69,60 @@ private:
   OnChange on_change;
 };
 
+/// PVLine holds a PV line for the GUI, before it is formatted by UCI::pv() or
+/// written as an InfoRecord by UCI::pv_records().
+
+struct PVLine {
+  int depth, seldepth, multipv;
+  Value score;
+  int bound;        // 1 lower, 2 upper
+  uint64_t nodes, tbHits;
+  int time;         // Milliseconds since the start of the search, at least 1
+  std::vector<Move> pv;
+};
+
+#ifdef __EMSCRIPTEN__
+/// With "Info Output" set to binary, the PV lines of UCI::pv() are written as
+/// InfoRecords to a ring buffer in the heap instead, which JavaScript can read
+/// without any formatting or parsing. All fields are 32 bits wide, nodes and
+/// tbhits are split in low and high half. Moves use the internal encoding:
+/// bits 0-5 destination, 6-11 origin (or dropped piece), 12-15 move type.
+/// A record is consistent if its seq is even and unchanged after reading it.
+
+struct InfoRecord {
+  uint32_t seq;
+  int32_t depth, seldepth, multipv;
+  int32_t mate, score, bound;  // Score in cp (or in moves if mate), bound 1 lower, 2 upper
+  uint32_t nodes[2], nps, hashfull, tbhits[2], time;
+  int32_t pvLength;
+  int32_t pv[MAX_PLY];
+};
+
+struct InfoBuffer {
+  static const uint32_t Capacity = 64;
+
+  uint32_t capacity, recordSize;
+  uint32_t written;  // Records written so far, the next goes to written % capacity
+  InfoRecord records[Capacity];
+};
+
+void pv_records(const std::vector<PVLine>& lines);
+#endif
+
+struct Session; // Position set up by the GUI of an engine, see uci.cpp
+
 void init(OptionsMap&);
 void loop(int argc, char* argv[]);
+bool command(const std::string& cmd);
+void delete_session(Session* session);
 std::string value(Value v);
 std::string square(Square s);
 std::string move(Move m, bool chess960);
-std::string pv(const Position& pos, Depth depth, Value alpha, Value beta);
+std::vector<PVLine> pv_lines(const Position& pos, Depth depth, Value alpha, Value beta);
+std::string pv(const std::vector<PVLine>& lines, bool chess960);
 Move to_move(const Position& pos, std::string& str);
 Variant variant_from_name(const std::string& str);
 
 } // namespace UCI
 
-extern UCI::OptionsMap Options;
-
 #endif // #ifndef UCI_H_INCLUDED
@@ -19,32 +19,47 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <ostream>
 
+#include "engine.h"
 #include "misc.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
-#ifndef __EMSCRIPTEN__
+#ifndef NO_SYZYGY
 #include "syzygy/tbprobe.h"
 #endif
 
 using std::string;
 
-UCI::OptionsMap Options; // Global object
-
 namespace UCI {
 
 /// 'On change' actions, triggered by an option's value change
 void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { TT.resize(o); }
+void on_hash_size(const Option& o) { TT.resize(o); Threads.resize_tables(); }
 void on_logger(const Option& o) { start_logger(o); }
-void on_threads(const Option& o) { Threads.set(o); }
-#ifndef  __EMSCRIPTEN__
+void on_threads(const Option& o) { Threads.set(o); Threads.resize_tables(); }
+void on_eval_tables(const Option&) { Threads.resize_tables(); }
+void on_result_store(const Option&) {
+  string file = Options["Result Store"];
+  if (!CurrentEngine->store.open(file, size_t(Options["Result Store Size"])))
+      sync_cout << "info string Could not open " << file << " as a result store" << sync_endl;
+}
+void on_book_file(const Option& o) {
+  if (CurrentEngine->book.open(o))
+      sync_cout << "info string Book has " << CurrentEngine->book.size() << " entries" << sync_endl;
+  else
+      sync_cout << "info string Could not open " << string(o) << sync_endl;
+}
+#ifndef NO_SYZYGY
 void on_tb_path(const Option& o) { Tablebases::init(o, UCI::variant_from_name(Options["UCI_Variant"])); }
-#endif  // ifndef __EMSCRIPTEN__
+#ifdef __EMSCRIPTEN__
+void on_tb_cache(const Option& o) { Tablebases::resize_cache(o); }
+#endif
+#endif  // ifndef NO_SYZYGY
 
 
 /// Our case insensitive less() function as required by UCI protocol
@@ -59,33 +74,81 @@ bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const
 
 void init(OptionsMap& o) {
 
+#ifdef __EMSCRIPTEN__
+  static const std::vector<std::string> InfoOutputs = { "text", "binary" };
+#endif
+  static const std::vector<std::string> MultiPVModes = { "sequential", "shared" };
+  static const std::vector<std::string> BookSelections = { "none", "best", "weighted" };
+  static const std::vector<std::string> MateSearches = { "alpha-beta", "proof-number" };
+
+#if !defined(__EMSCRIPTEN__)
   const int MaxHashMB = Is64Bit ? 1024 * 1024 : 2048;
+#elif defined(__EMSCRIPTEN_PTHREADS__)
+  const int MaxHashMB = 128; // Shared memory is fixed in size, see Makefile
+#elif defined(MEMORY_GROWTH)
+  const int MaxHashMB = 1024;
+#else
+  const int MaxHashMB = 16;
+#endif
 
   o["Debug Log File"]        << Option("", on_logger);
   o["Contempt"]              << Option(0, -100, 100);
-#ifndef __EMSCRIPTEN__
-  o["Threads"]               << Option(1, 1, 512, on_threads);
-  o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
-#else
+#if defined(NO_THREADS)
   o["Threads"]               << Option(1, 1, 1, on_threads);
-  o["Hash"]                  << Option(16, 16, 16, on_hash_size);
+#elif defined(__EMSCRIPTEN__)
+  o["Threads"]               << Option(1, 1, 16, on_threads); // See PTHREAD_POOL_SIZE
+#else
+  o["Threads"]               << Option(1, 1, 512, on_threads);
 #endif
+  o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["Perft Hash"]            << Option(0, 0, MaxHashMB);                 // MB, 0 for none
+  o["Mate Hash"]             << Option(16, 1, MaxHashMB);                // MB
+  o["Pawn Hash"]             << Option(0, 0, 65536, on_eval_tables);     // KB, 0 for automatic
+  o["Material Hash"]         << Option(0, 0, 65536, on_eval_tables);
+  o["Eval Hash"]             << Option(0, 0, 65536, on_eval_tables);     // KB, 0 for none
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
+  o["MultiPV Mode"]          << Option("sequential", MultiPVModes);
+  o["Mate Search"]           << Option("alpha-beta", MateSearches);
+#ifndef __EMSCRIPTEN__
+  o["Book File"]             << Option("<empty>", on_book_file);
+  o["Result Store Size"]     << Option(64, 1, MaxHashMB, on_result_store); // MB, for a new store
+  o["Result Store"]          << Option("<empty>", on_result_store);
+#endif
+  o["Book Selection"]        << Option("weighted", BookSelections);
 #ifdef SKILL
   o["Skill Level"]           << Option(20, 0, 20);
 #endif
   o["Move Overhead"]         << Option(100, 0, 5000);
+  o["Adaptive Overhead"]     << Option(false);
   o["nodestime"]             << Option(0, 0, 10000);
+#ifdef __EMSCRIPTEN__
+  o["Info Output"]           << Option("text", InfoOutputs);
+#endif
+  o["Info Interval"]         << Option(0, 0, 10000);
+  o["Info Delta"]            << Option(false);
+  o["Info Coalesce"]         << Option(false);
+#ifdef USE_ASYNCIFY
+  o["Yield Interval"]        << Option(20, 0, 1000);
+#endif
   o["UCI_Chess960"]          << Option(false);
   o["UCI_Variant"]           << Option(variants.front().c_str(), variants);
-#ifndef __EMSCRIPTEN__
+#ifdef LOW_MEMORY
+  o["Keep Variant Data"]     << Option(false);
+#else
+  o["Keep Variant Data"]     << Option(true);
+#endif
+#ifndef NO_SYZYGY
   o["SyzygyPath"]            << Option("<empty>", on_tb_path);
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(6, 0, 6);
-#endif  // #ifndef __EMSCRIPTEN__
+  o["SyzygyProbeCache"]      << Option(0, 0, 65536, on_eval_tables);     // KB, 0 for automatic
+#ifdef __EMSCRIPTEN__
+  o["SyzygyCache"]           << Option(16, 1, 1024, on_tb_cache);
+#endif
+#endif  // #ifndef NO_SYZYGY
 }
 
 
@@ -94,25 +157,30 @@ void init(OptionsMap& o) {
 
 std::ostream& operator<<(std::ostream& os, const OptionsMap& om) {
 
-  for (size_t idx = 0; idx < om.size(); ++idx)
-      for (const auto& it : om)
-          if (it.second.idx == idx)
-          {
-              const Option& o = it.second;
-              os << "\noption name " << it.first << " type " << o.type;
+  // Indices keep growing with each engine of the process, so sort instead
+  std::vector<OptionsMap::const_pointer> sorted;
+  for (const auto& it : om)
+      sorted.push_back(&it);
+
+  std::sort(sorted.begin(), sorted.end(), [](OptionsMap::const_pointer a, OptionsMap::const_pointer b) {
+      return a->second.idx < b->second.idx;
+  });
 
-              if (o.type != "button")
-                  os << " default " << o.defaultValue;
+  for (auto it : sorted)
+  {
+      const Option& o = it->second;
+      os << "\noption name " << it->first << " type " << o.type;
 
-              if (o.type == "combo")
-                  for (string value : o.comboValues)
-                      os << " var " << value;
+      if (o.type != "button")
+          os << " default " << o.defaultValue;
 
-              if (o.type == "spin")
-                  os << " min " << o.min << " max " << o.max;
+      if (o.type == "combo")
+          for (string value : o.comboValues)
+              os << " var " << value;
 
-              break;
-          }
+      if (o.type == "spin")
+          os << " min " << o.min << " max " << o.max;
+  }
 
   return os;
 }
@@ -155,7 +223,7 @@ int Option::compare(const char* str) const {
 
 void Option::operator<<(const Option& o) {
 
-  static size_t insert_order = 0;
+  static std::atomic<size_t> insert_order(0); // Engines may be created at once
 
   *this = o;
   idx = insert_order++;